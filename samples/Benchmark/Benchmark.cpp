@@ -0,0 +1,620 @@
+// Benchmark of the expression engine. Every case runs the same
+// computation through the raw matrix and vector operators and through
+// dynamic, compiled and static expressions. Variables are marked as
+// changed before every evaluation, so cached results are never reused.
+//
+// The hogwild_epoch case compares one epoch of single-threaded train()
+// of a neural network with asynchronous training on 1 to 8 threads,
+// and reports the training error of every variant after a fixed number
+// of epochs.
+//
+// Results are written to the standard output as JSON:
+//		{ "benchmarks": [ { "name": ..., "variant": ..., "ns_per_eval": ...,
+//		  "allocs_per_eval": ..., "overhead": ... }, ... ],
+//		  "convergence": [ { "name": ..., "variant": ..., "epochs": ...,
+//		  "error": ... }, ... ] }
+// where overhead is the time of the variant relative to the first
+// variant of the case. A summary table is written to the standard error.
+
+#include "stdafx.h"
+#include <matrix.h>
+#include <neuralnet.h>
+#include <static_expression.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+struct D3 : public algebra::dimension<3> {};
+struct D7 : public algebra::dimension<7> {};
+struct D8 : public algebra::dimension<8> {};
+struct D64 : public algebra::dimension<64> {};
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	++allocations;
+
+	void* result = std::malloc(0 < size ? size : 1);
+	if (nullptr == result)
+		throw std::bad_alloc();
+
+	return result;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) throw()
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) throw()
+{
+	std::free(p);
+}
+
+// Keeps results alive, so evaluations are not optimized away.
+static volatile double sink = 0;
+
+void consume(const double value)
+{
+	sink = sink + value;
+}
+
+template <class D>
+void consume(const algebra::vector<D>& value)
+{
+	consume(value(0));
+}
+
+template <class M, class N>
+void consume(const algebra::matrix<M, N>& value)
+{
+	consume(value(0, 0));
+}
+
+struct measurement
+{
+	std::string name;
+	std::string variant;
+	double ns_per_eval;
+	double allocs_per_eval;
+	double overhead;
+};
+
+struct convergence
+{
+	std::string name;
+	std::string variant;
+	int epochs;
+	double error;
+};
+
+// Runs func in batches of growing size until a batch takes at least
+// the given time, and reports the time and allocations per call of
+// the last batch.
+template <class _Func>
+measurement measure(
+	const std::string& name,
+	const std::string& variant,
+	_Func func,
+	const std::chrono::milliseconds duration = std::chrono::milliseconds(200))
+{
+	typedef std::chrono::steady_clock clock;
+
+	func();
+
+	for (size_t iterations = 1;; iterations *= 2)
+	{
+		const size_t before = allocations.load();
+		const clock::time_point start = clock::now();
+
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			func();
+		}
+
+		const clock::duration elapsed = clock::now() - start;
+		const size_t allocated = allocations.load() - before;
+
+		if (elapsed >= duration)
+		{
+			measurement result;
+			result.name = name;
+			result.variant = variant;
+			result.ns_per_eval = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+			result.allocs_per_eval = static_cast<double>(allocated) / iterations;
+			result.overhead = 1.0;
+
+			return result;
+		}
+	}
+}
+
+// Collects measurements of the variants of one case. The first
+// variant is the raw baseline the others are compared with.
+class suite
+{
+public:
+	template <class _Func>
+	void run(
+		const std::string& name,
+		const std::string& variant,
+		_Func func)
+	{
+		measurement result = measure(name, variant, func);
+
+		if (m_results.empty() || m_results.back().name != name)
+		{
+			m_baseline = result.ns_per_eval;
+		}
+
+		result.overhead = result.ns_per_eval / m_baseline;
+		m_results.push_back(result);
+	}
+
+	void record(
+		const std::string& name,
+		const std::string& variant,
+		const int epochs,
+		const double error)
+	{
+		convergence result;
+		result.name = name;
+		result.variant = variant;
+		result.epochs = epochs;
+		result.error = error;
+
+		m_convergence.push_back(result);
+	}
+
+	void print_json(std::ostream& out) const
+	{
+		out << "{\n  \"benchmarks\": [\n";
+
+		for (size_t i = 0; i < m_results.size(); ++i)
+		{
+			const measurement& m = m_results[i];
+
+			out << "    { \"name\": \"" << m.name
+				<< "\", \"variant\": \"" << m.variant
+				<< "\", \"ns_per_eval\": " << m.ns_per_eval
+				<< ", \"allocs_per_eval\": " << m.allocs_per_eval
+				<< ", \"overhead\": " << m.overhead
+				<< " }" << ((i + 1 < m_results.size()) ? "," : "") << "\n";
+		}
+
+		out << "  ],\n  \"convergence\": [\n";
+
+		for (size_t i = 0; i < m_convergence.size(); ++i)
+		{
+			const convergence& c = m_convergence[i];
+
+			out << "    { \"name\": \"" << c.name
+				<< "\", \"variant\": \"" << c.variant
+				<< "\", \"epochs\": " << c.epochs
+				<< ", \"error\": " << c.error
+				<< " }" << ((i + 1 < m_convergence.size()) ? "," : "") << "\n";
+		}
+
+		out << "  ]\n}\n";
+	}
+
+	void print_table(std::ostream& out) const
+	{
+		out << std::left << std::setw(16) << "benchmark"
+			<< std::setw(12) << "variant"
+			<< std::right << std::setw(14) << "ns/eval"
+			<< std::setw(14) << "allocs/eval"
+			<< std::setw(10) << "overhead" << "\n";
+
+		for (const measurement& m : m_results)
+		{
+			out << std::left << std::setw(16) << m.name
+				<< std::setw(12) << m.variant
+				<< std::right << std::fixed << std::setprecision(1) << std::setw(14) << m.ns_per_eval
+				<< std::setprecision(2) << std::setw(14) << m.allocs_per_eval
+				<< std::setw(10) << m.overhead << "\n";
+		}
+
+		if (m_convergence.empty())
+			return;
+
+		out << "\n" << std::left << std::setw(16) << "benchmark"
+			<< std::setw(12) << "variant"
+			<< std::right << std::setw(14) << "epochs"
+			<< std::setw(14) << "error" << "\n";
+
+		for (const convergence& c : m_convergence)
+		{
+			out << std::left << std::setw(16) << c.name
+				<< std::setw(12) << c.variant
+				<< std::right << std::setw(14) << c.epochs
+				<< std::setprecision(6) << std::setw(14) << c.error << "\n";
+		}
+	}
+
+private:
+	std::vector<measurement> m_results;
+	std::vector<convergence> m_convergence;
+	double m_baseline;
+};
+
+void scalar_chain(suite& s)
+{
+	using algebra::static_expressions::ref;
+
+	auto a = algebra::expressions::declare<double>();
+	auto b = algebra::expressions::declare<double>();
+	auto c = algebra::expressions::declare<double>();
+
+	a.set(1.5);
+	b.set(2.5);
+	c.set(0.5);
+
+	const double& ca = static_cast<const algebra::expressions::variable<double>&>(a).value();
+	const double& cb = static_cast<const algebra::expressions::variable<double>&>(b).value();
+	const double& cc = static_cast<const algebra::expressions::variable<double>&>(c).value();
+
+	algebra::expressions::expression<double> ea(a);
+	algebra::expressions::expression<double> eb(b);
+	algebra::expressions::expression<double> ec(c);
+
+	auto e = ((ea + eb) * ec - ea) * 2.0 + eb;
+	auto plan = algebra::expressions::compile(e);
+	auto st = ((ref(a) + b) * c - a) * 2.0 + b;
+
+	s.run("scalar_chain", "raw", [&]()
+		{
+			consume(((ca + cb) * cc - ca) * 2.0 + cb);
+		});
+
+	s.run("scalar_chain", "dynamic", [&]()
+		{
+			a.value();
+			consume(e.evaluate());
+		});
+
+	s.run("scalar_chain", "compiled", [&]()
+		{
+			consume(plan.run());
+		});
+
+	s.run("scalar_chain", "static", [&]()
+		{
+			consume(st.evaluate());
+		});
+}
+
+// Builds, evaluates and discards a scalar graph of 16 nodes, with
+// nodes on the heap and in an arena.
+void scalar_build(suite& s)
+{
+	auto a = algebra::expressions::declare<double>();
+	auto b = algebra::expressions::declare<double>();
+
+	a.set(1.5);
+	b.set(2.5);
+
+	algebra::expressions::expression<double> ea(a);
+	algebra::expressions::expression<double> eb(b);
+
+	auto build = [&]()
+		{
+			auto e = ea * 2.0 + eb;
+			for (int i = 0; i < 4; ++i)
+			{
+				e = (e - ea) * 0.5 + eb;
+			}
+
+			consume(e.evaluate());
+		};
+
+	s.run("scalar_build", "heap", build);
+
+	s.run("scalar_build", "arena", [&]()
+		{
+			algebra::expressions::expression_arena arena(4096);
+			algebra::expressions::arena_scope scope(arena);
+
+			build();
+		});
+}
+
+void vector_dot(suite& s)
+{
+	typedef algebra::vector<D64> V;
+
+	auto u = algebra::expressions::declare<V>();
+	auto v = algebra::expressions::declare<V>();
+	auto w = algebra::expressions::declare<V>();
+
+	u.set(V::random(-1, 1));
+	v.set(V::random(-1, 1));
+	w.set(V::random(-1, 1));
+
+	const V& cu = static_cast<const algebra::expressions::variable<V>&>(u).value();
+	const V& cv = static_cast<const algebra::expressions::variable<V>&>(v).value();
+	const V& cw = static_cast<const algebra::expressions::variable<V>&>(w).value();
+
+	auto e = (u + v) * w;
+	auto plan = algebra::expressions::compile(e);
+	auto st = (algebra::static_expressions::ref(u) + v) * w;
+
+	s.run("vector_dot", "raw", [&]()
+		{
+			consume((cu + cv) * cw);
+		});
+
+	s.run("vector_dot", "dynamic", [&]()
+		{
+			u.value();
+			consume(e.evaluate());
+		});
+
+	s.run("vector_dot", "compiled", [&]()
+		{
+			consume(plan.run());
+		});
+
+	s.run("vector_dot", "static", [&]()
+		{
+			consume(st.evaluate());
+		});
+}
+
+void gemm_chain(suite& s)
+{
+	typedef algebra::matrix<D64, D64> M;
+	typedef algebra::vector<D64> V;
+
+	auto a = algebra::expressions::declare<M>();
+	auto b = algebra::expressions::declare<M>();
+	auto c = algebra::expressions::declare<M>();
+	auto x = algebra::expressions::declare<V>();
+
+	a.set(M::random(-1, 1));
+	b.set(M::random(-1, 1));
+	c.set(M::random(-1, 1));
+	x.set(V::random(-1, 1));
+
+	const M& ca = static_cast<const algebra::expressions::variable<M>&>(a).value();
+	const M& cb = static_cast<const algebra::expressions::variable<M>&>(b).value();
+	const M& cc = static_cast<const algebra::expressions::variable<M>&>(c).value();
+	const V& cx = static_cast<const algebra::expressions::variable<V>&>(x).value();
+
+	auto e = a * b * c * x;
+	auto plan = algebra::expressions::compile(e);
+	auto st = algebra::static_expressions::ref(a) * b * c * x;
+
+	V result;
+
+	s.run("gemm_chain", "raw", [&]()
+		{
+			// Matrix-vector products, the order a hand-written
+			// evaluation would use.
+			consume(ca * (cb * (cc * cx)));
+		});
+
+	s.run("gemm_chain", "dynamic", [&]()
+		{
+			a.value();
+			e.evaluate_into(result);
+			consume(result);
+		});
+
+	s.run("gemm_chain", "compiled", [&]()
+		{
+			consume(plan.run());
+		});
+
+	s.run("gemm_chain", "static", [&]()
+		{
+			consume(st.evaluate());
+		});
+}
+
+void small_graph(suite& s)
+{
+	typedef algebra::matrix<D3, D3> M;
+	typedef algebra::vector<D3> V;
+
+	auto a = algebra::expressions::declare<M>();
+	auto b = algebra::expressions::declare<M>();
+	auto x = algebra::expressions::declare<V>();
+
+	a.set(M::random(-1, 1));
+	b.set(M::random(-1, 1));
+	x.set(V::random(-1, 1));
+
+	const M& ca = static_cast<const algebra::expressions::variable<M>&>(a).value();
+	const M& cb = static_cast<const algebra::expressions::variable<M>&>(b).value();
+	const V& cx = static_cast<const algebra::expressions::variable<V>&>(x).value();
+
+	auto e = (a * b + b) * x;
+	auto plan = algebra::expressions::compile(e);
+	auto st = (algebra::static_expressions::ref(a) * b + b) * x;
+
+	V result;
+
+	s.run("small_graph_3x3", "raw", [&]()
+		{
+			consume((ca * cb + cb) * cx);
+		});
+
+	s.run("small_graph_3x3", "dynamic", [&]()
+		{
+			a.value();
+			e.evaluate_into(result);
+			consume(result);
+		});
+
+	s.run("small_graph_3x3", "compiled", [&]()
+		{
+			consume(plan.run());
+		});
+
+	s.run("small_graph_3x3", "static", [&]()
+		{
+			consume(st.evaluate());
+		});
+}
+
+// Activity data of the NeuralNetwork sample: one-hot encoded day of the
+// week and a normalized load, with a target of normal, low or high
+// activity. Only two of the eight inputs are non-zero.
+void make_activity_data(
+	std::vector<algebra::vector<D8>>& data,
+	std::vector<algebra::vector<D3>>& target)
+{
+	const double ideal[] = { 3500.0, 50000.0, 60000.0, 62000.0, 58000.0, 55000.0, 4000.0 };
+	const double max = 65000;
+
+	std::mt19937 gen(42);
+	std::uniform_real_distribution<double> distr(0, 1);
+
+	for (size_t i = 0; i < 4096; ++i)
+	{
+		const size_t day = i % 7;
+		const size_t category = (i / 7) % 3;
+
+		double load = ideal[day] * (1 + (distr(gen) - 0.5) * 0.2);
+		if (1 == category)
+		{
+			load = ideal[day] * 0.8 * distr(gen);
+		}
+		else if (2 == category)
+		{
+			load = ideal[day] * (1.2 + 10 * distr(gen));
+		}
+
+		algebra::vector<D8> input;
+		input(day) = 1.0;
+		input(7) = machine_learning::_LayerBase::activation(load / max);
+
+		algebra::vector<D3> expected;
+		expected(category) = 1.0;
+
+		data.push_back(input);
+		target.push_back(expected);
+	}
+}
+
+template <class _Network>
+double mean_squared_error(
+	const _Network& network,
+	const std::vector<algebra::vector<D8>>& data,
+	const std::vector<algebra::vector<D3>>& target)
+{
+	typename _Network::workspace context;
+	double error = 0;
+
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		const algebra::vector<D3>& out = network.process(data[i], context);
+
+		for (size_t j = 0; j < D3::rank; ++j)
+		{
+			error += (out(j) - target[i](j)) * (out(j) - target[i](j));
+		}
+	}
+
+	return error / data.size();
+}
+
+// One epoch of single-threaded train() compared with asynchronous
+// training on a growing number of threads.
+void hogwild_training(suite& s)
+{
+	typedef machine_learning::neural_network<D8, D7, D3> network;
+
+	std::vector<algebra::vector<D8>> data;
+	std::vector<algebra::vector<D3>> target;
+	make_activity_data(data, target);
+
+	const double rate = 0.6;
+	const int epochs = 20;
+	const size_t threads[] = { 1, 2, 4, 8 };
+
+	const network initial;
+
+	{
+		network n = initial;
+
+		auto epoch = [&]()
+			{
+				for (size_t i = 0; i < data.size(); ++i)
+				{
+					n.train(data[i], target[i], rate);
+				}
+			};
+
+		s.run("hogwild_epoch", "train", epoch);
+
+		n = initial;
+		for (int i = 0; i < epochs; ++i)
+		{
+			epoch();
+		}
+
+		s.record("hogwild_epoch", "train", epochs, mean_squared_error(n, data, target));
+	}
+
+	for (const size_t count : threads)
+	{
+		const std::string variant = "threads_" + std::to_string(count);
+
+		network n = initial;
+		algebra::thread_pool pool(count);
+		machine_learning::hogwild_trainer<network> trainer(n, pool);
+
+		s.run("hogwild_epoch", variant, [&]()
+			{
+				trainer.train(data, target, rate);
+			});
+
+		n = initial;
+		for (int i = 0; i < epochs; ++i)
+		{
+			trainer.train(data, target, rate);
+		}
+
+		s.record("hogwild_epoch", variant, epochs, mean_squared_error(n, data, target));
+	}
+}
+
+int _tmain(int /*argc*/, _TCHAR* /*argv*/[])
+{
+	suite s;
+
+	scalar_chain(s);
+	scalar_build(s);
+	vector_dot(s);
+	gemm_chain(s);
+	small_graph(s);
+	hogwild_training(s);
+
+	s.print_json(std::cout);
+	s.print_table(std::cerr);
+
+	return 0;
+}
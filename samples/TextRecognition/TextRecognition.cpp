@@ -9,6 +9,7 @@ struct D2 : public algebra::dimension<2> {};
 struct D28 : public algebra::dimension<28> {};
 struct D14 : public algebra::dimension<14> {};
 struct D196 : public algebra::dimension<196> {};
+struct D16 : public algebra::dimension<16> {};
 
 typedef machine_learning::neural_network<D784, D49, D10> oacr_network;
 typedef machine_learning::neural_network<D196, D49, D10> oacr_sampled_network;
@@ -22,13 +23,27 @@ typedef algebra::matrix<D2, D2> sampling_core;
 typedef machine_learning::convolution_2d_network<_28x28, convolution_core, oacr_network> convolution_network;
 typedef machine_learning::sampling_2d_network<_28x28, _14x14, sampling_core, oacr_sampled_network> sampled_network;
 
+// Softmax outputs trained with the cross-entropy cost do not saturate
+// like logistic outputs trained with the squared error, and give the
+// probability of every digit.
+typedef machine_learning::classification_network<D784, D49, D10> oacr_classifier;
+
+// Mini-batch of training samples, one sample per row.
+typedef algebra::matrix<D16, D784> oacr_batch_input;
+typedef algebra::matrix<D16, D10> oacr_batch_target;
+
 void print_usage()
 {
 	std::cout << "USAGE:\r\n";
 	std::cout << "\r\n";
-	std::cout << "TextRecognition.exe data_path\r\n";
+	std::cout << "TextRecognition.exe data_path [adam | compare]\r\n";
 	std::cout << "\r\n";
 	std::cout << "    data_path  Path to the MNIST training data set.\r\n";
+	std::cout << "    adam       Train a single softmax network on mini-batches with\r\n";
+	std::cout << "               the Adam optimizer instead of the ensemble.\r\n";
+	std::cout << "    compare    Train a softmax and a logistic network side by side\r\n";
+	std::cout << "               with the same optimizer and mini-batches, and report\r\n";
+	std::cout << "               the test set rates of both after every epoch.\r\n";
 }
 
 const oacr_network::output& get_target(
@@ -114,6 +129,158 @@ void test_success_rate(
 		<< "\r\n";
 }
 
+// Collects the digits of the data set in a random order.
+void shuffle_digits(
+	const mnist_data& data,
+	std::vector<const mnist_digit*>& input,
+	std::mt19937& gen)
+{
+	input.resize(data.size());
+	std::transform(
+		data.cbegin(), data.cend(),
+		input.begin(),
+		[](const mnist_digit& digit) { return std::addressof(digit); });
+	std::shuffle(input.begin(), input.end(), gen);
+}
+
+// Fills a mini-batch with the digits starting at the given position.
+void fill_batch(
+	const std::vector<const mnist_digit*>& input,
+	const size_t first,
+	oacr_batch_input& data,
+	oacr_batch_target& target)
+{
+	for (size_t row = 0; row < D16::rank; ++row)
+	{
+		const mnist_digit* digit = input[first + row];
+		const oacr_network::output& expected = get_target(digit->first);
+
+		for (size_t col = 0; col < D784::rank; ++col)
+		{
+			data(row, col) = digit->second(col);
+		}
+
+		for (size_t col = 0; col < D10::rank; ++col)
+		{
+			target(row, col) = expected(col);
+		}
+	}
+}
+
+// Trains the network on mini-batches with the Adam optimizer. Adam
+// adapts the step size of every weight, so a single rate trains the
+// network in a few epochs.
+template <class _Network>
+void train_adam(
+	_Network& network,
+	const mnist_data& training,
+	const mnist_data& test,
+	std::mt19937& gen)
+{
+	machine_learning::optimizing_trainer<_Network, machine_learning::adam> trainer(
+		network, machine_learning::adam(0.001));
+
+	std::vector<const mnist_digit*> input;
+	oacr_batch_input data;
+	oacr_batch_target target;
+
+	const int epochs = 3;
+	for (int epoch = 0; epoch < epochs; ++epoch)
+	{
+		std::cout << "Training epoch " << (epoch + 1) << " with Adam\r\n";
+
+		shuffle_digits(training, input, gen);
+		for (size_t first = 0; first + D16::rank <= input.size(); first += D16::rank)
+		{
+			fill_batch(input, first, data, target);
+			trainer.train(data, target);
+		}
+
+		test_success_rate(network, training, "Training set");
+		test_success_rate(network, test, "Test set");
+	}
+}
+
+// Trains a softmax network with the cross-entropy cost and a logistic
+// network with the squared error on the same mini-batches, with the
+// same optimizer and schedule, so the test set rates after every epoch
+// show how fast each output layer converges.
+void compare_outputs(
+	const mnist_data& training,
+	const mnist_data& test,
+	std::mt19937& gen)
+{
+	oacr_classifier classifier;
+	oacr_network network;
+
+	machine_learning::optimizing_trainer<oacr_classifier, machine_learning::adam> classifierTrainer(
+		classifier, machine_learning::adam(0.001));
+	machine_learning::optimizing_trainer<oacr_network, machine_learning::adam> networkTrainer(
+		network, machine_learning::adam(0.001));
+
+	std::vector<const mnist_digit*> input;
+	oacr_batch_input data;
+	oacr_batch_target target;
+
+	const int epochs = 3;
+	for (int epoch = 0; epoch < epochs; ++epoch)
+	{
+		std::cout << "Training epoch " << (epoch + 1) << " with Adam\r\n";
+
+		shuffle_digits(training, input, gen);
+		for (size_t first = 0; first + D16::rank <= input.size(); first += D16::rank)
+		{
+			fill_batch(input, first, data, target);
+			classifierTrainer.train(data, target);
+			networkTrainer.train(data, target);
+		}
+
+		test_success_rate(classifier, test, "Softmax, cross-entropy: test set");
+		test_success_rate(network, test, "Logistic, squared error: test set");
+	}
+}
+
+// Recognizes random digits of the test set, and then all digits of the
+// data set.
+template <class _Network>
+void recognize(
+	_Network& network,
+	const mnist_data& test,
+	const std::wstring& path,
+	std::mt19937& gen)
+{
+	std::uniform_real_distribution<double> distr(0, 1);
+
+	size_t errors = 0;
+	size_t maxTests = 1000;
+	for (size_t i = 0; i < maxTests; ++i)
+	{
+		auto digit = test[(size_t)(((double)test.size()) * distr(gen))];
+
+		auto result = network.process(digit.second);
+
+		double confidence;
+		int recognized = get_result(result, confidence);
+		std::cout << "Actual: " << digit.first << "; detected: " << recognized << "; confidence: " << confidence;
+		if (digit.first != recognized)
+		{
+			std::cout << " <-- Error";
+			++errors;
+		}
+
+		std::cout << "\r\n";
+	}
+
+	std::cout
+		<< "Random sampling success rate: " << ((double)(maxTests - errors) / (double)maxTests)
+		<< " error rate: " << ((double)(errors) / (double)maxTests)
+		<< "\r\n";
+
+	mnist_data full = load_mnist(path);
+
+	test_success_rate(network, full, "Full");
+}
+
 int _tmain(int argc, _TCHAR* argv[])
 {
 	if (argc < 2)
@@ -163,6 +330,24 @@ int _tmain(int argc, _TCHAR* argv[])
 		}
 	}
 
+	if (argc > 2 && std::wstring(L"adam") == argv[2])
+	{
+		oacr_classifier network;
+
+		test_success_rate(network, training, "Untrained");
+		train_adam(network, training, test, gen);
+		recognize(network, test, std::wstring(argv[1]), gen);
+
+		return 0;
+	}
+
+	if (argc > 2 && std::wstring(L"compare") == argv[2])
+	{
+		compare_outputs(training, test, gen);
+
+		return 0;
+	}
+
 	auto network = machine_learning::ensemble(
 		oacr_network(),
 		convolution_network({ -1.0, 1.0, 0.0, 0.0 }, oacr_network()),
@@ -207,35 +392,7 @@ int _tmain(int argc, _TCHAR* argv[])
 		test_success_rate(network, test, "Test set");
 	}
 
-	// Recognition
-	size_t errors = 0;
-	size_t maxTests = 1000;
-	for (size_t i = 0; i < maxTests; ++i)
-	{
-		auto digit = test[(size_t)(((double)test.size()) * distr(gen))];
-
-		auto result = network.process(digit.second);
-
-		double confidence;
-		int recognized = get_result(result, confidence);
-		std::cout << "Actual: " << digit.first << "; detected: " << recognized << "; confidence: " << confidence;
-		if (digit.first != recognized)
-		{
-			std::cout << " <-- Error";
-			++errors;
-		}
-
-		std::cout << "\r\n";
-	}
-
-	std::cout
-		<< "Random sampling success rate: " << ((double)(maxTests - errors) / (double)maxTests)
-		<< " error rate: " << ((double)(errors) / (double)maxTests)
-		<< "\r\n";
-
-	full = load_mnist(std::wstring(argv[1]));
-
-	test_success_rate(network, full, "Full");
+	recognize(network, test, std::wstring(argv[1]), gen);
 
 	return 0;
 }
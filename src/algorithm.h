@@ -1,5 +1,11 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
 #include "matrix.h"
 
 namespace algebra
@@ -57,4 +63,1280 @@ namespace algebra
 
 		return true;
 	}
+
+	// LU decomposition with partial pivoting of a square matrix.
+	// Factors are kept in a compact row-major buffer of the requested
+	// precision, so the same implementation is used for a fast single
+	// precision factorization and for a full double precision one.
+	template <class R, class _Real = double>
+	class lu_decomposition
+	{
+	public:
+		typedef lu_decomposition<R, _Real> _Self;
+		typedef _Real value_type;
+		static const size_t rank = R::rank;
+
+		lu_decomposition()
+			: m_values(), m_pivots()
+		{
+		}
+
+		// Factorizes P * A = L * U. Returns false if the matrix is singular
+		// or cannot be represented in the working precision.
+		bool factorize(const matrix<R, R>& a)
+		{
+			const value_type _Zero = number_traits<value_type>::zero();
+
+			m_values.assign(_Self::rank * _Self::rank, _Zero);
+			m_pivots.assign(_Self::rank, 0);
+
+			if (a.empty())
+				return false;
+
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = 0; col < _Self::rank; ++col)
+				{
+					const value_type value = (value_type)a(row, col);
+					if (false == std::isfinite(value))
+						return false;
+
+					m_values[row * _Self::rank + col] = value;
+				}
+			}
+
+			for (size_t col = 0; col < _Self::rank; ++col)
+			{
+				// Partial pivoting: bring the row with the largest value
+				// in the current column into the pivot position.
+				size_t pivot = col;
+				for (size_t row = col + 1; row < _Self::rank; ++row)
+				{
+					if (std::abs(m_values[row * _Self::rank + col]) > std::abs(m_values[pivot * _Self::rank + col]))
+					{
+						pivot = row;
+					}
+				}
+
+				m_pivots[col] = pivot;
+				if (_Zero == m_values[pivot * _Self::rank + col])
+					return false;
+
+				if (pivot != col)
+				{
+					std::swap_ranges(
+						m_values.begin() + col * _Self::rank,
+						m_values.begin() + (col + 1) * _Self::rank,
+						m_values.begin() + pivot * _Self::rank);
+				}
+
+				// Eliminate values below the pivot. Both the pivot row and the current
+				// row are traversed sequentially, so the inner loop streams through memory.
+				const value_type* pRow = m_values.data() + col * _Self::rank;
+				for (size_t row = col + 1; row < _Self::rank; ++row)
+				{
+					value_type* pCur = m_values.data() + row * _Self::rank;
+					const value_type factor = pCur[col] / pRow[col];
+					pCur[col] = factor;
+
+					for (size_t i = col + 1; i < _Self::rank; ++i)
+					{
+						pCur[i] -= factor * pRow[i];
+					}
+				}
+			}
+
+			return true;
+		}
+
+		// Solves A * x = B using the computed factors. Input and output are
+		// double precision vectors, while the substitution runs in the
+		// working precision of the decomposition.
+		void solve(
+			const vector<R>& b,
+			vector<R>& x) const
+		{
+			if (m_values.empty())
+				throw std::logic_error("Matrix is not factorized.");
+
+			// Working vector has a fixed size, so the substitution does not
+			// allocate memory.
+			std::array<value_type, _Self::rank> y;
+			std::transform(b.cbegin(), b.cend(), y.begin(),
+				[](const typename vector<R>::value_type& v) { return (value_type)v; });
+
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				if (m_pivots[row] != row)
+				{
+					std::swap(y[row], y[m_pivots[row]]);
+				}
+			}
+
+			// Forward substitution with the unit lower triangular factor.
+			for (size_t row = 1; row < _Self::rank; ++row)
+			{
+				const value_type* pRow = m_values.data() + row * _Self::rank;
+				value_type sum = y[row];
+				for (size_t col = 0; col < row; ++col)
+				{
+					sum -= pRow[col] * y[col];
+				}
+
+				y[row] = sum;
+			}
+
+			// Backward substitution with the upper triangular factor.
+			for (size_t row = _Self::rank; row-- > 0;)
+			{
+				const value_type* pRow = m_values.data() + row * _Self::rank;
+				value_type sum = y[row];
+				for (size_t col = row + 1; col < _Self::rank; ++col)
+				{
+					sum -= pRow[col] * y[col];
+				}
+
+				y[row] = sum / pRow[row];
+			}
+
+			std::transform(y.cbegin(), y.cend(), x.begin(),
+				[](const value_type& v) { return (typename vector<R>::value_type)v; });
+		}
+
+	private:
+		std::vector<value_type> m_values;
+		std::vector<size_t> m_pivots;
+	};
+
+	// Mixed precision algorithm to solve a system of linear equations
+	// defined by A * x = B. The matrix is factorized in single precision,
+	// and the solution is then improved by iterative refinement with
+	// double precision residuals. If refinement stagnates or the matrix
+	// cannot be factorized in single precision, the algorithm falls back
+	// to a double precision factorization.
+	template <class R>
+	bool solve_refined(
+		const matrix<R, R>& a,
+		const vector<R>& b,
+		vector<R>& x,
+		const size_t max_iterations = 30)
+	{
+		typedef typename matrix<R, R>::value_type value_type;
+
+		const value_type epsilon = std::numeric_limits<value_type>::epsilon();
+		const value_type _Zero = number_traits<value_type>::zero();
+
+		// Infinity norm of the input is used for the convergence criteria.
+		value_type norm = _Zero;
+		for (size_t row = 0; row < R::rank; ++row)
+		{
+			value_type sum = _Zero;
+			std::for_each(a.crow_begin(row), a.crow_end(row),
+				[&sum](const value_type& v) { sum += std::abs(v); });
+
+			norm = std::max(norm, sum);
+		}
+
+		auto infinity_norm = [](const vector<R>& v)
+		{
+			value_type result = number_traits<value_type>::zero();
+			std::for_each(v.cbegin(), v.cend(),
+				[&result](const value_type& d) { result = std::max(result, std::abs(d)); });
+
+			return result;
+		};
+
+		const value_type tolerance = std::sqrt((value_type)R::rank) * epsilon * norm;
+
+		lu_decomposition<R, float> lu;
+		if (lu.factorize(a))
+		{
+			vector<R> correction;
+			value_type last = std::numeric_limits<value_type>::infinity();
+
+			lu.solve(b, x);
+
+			for (size_t i = 0; i <= max_iterations; ++i)
+			{
+				const vector<R> residual = b - a * x;
+				const value_type error = infinity_norm(residual);
+
+				if (error <= tolerance * infinity_norm(x))
+					return true;
+
+				// Each refinement step is expected to reduce the residual by at least the ratio
+				// of single precision epsilon and the condition number. If the residual does not
+				// decrease substantially, the matrix is too ill-conditioned for single precision.
+				if (false == std::isfinite(error) || error > 0.5 * last)
+					break;
+
+				last = error;
+				lu.solve(residual, correction);
+				x += correction;
+			}
+		}
+
+		lu_decomposition<R, value_type> lud;
+		if (false == lud.factorize(a))
+			return false;
+
+		lud.solve(b, x);
+
+		return true;
+	}
+
+	// Householder QR decomposition of a matrix with at least as many rows
+	// as columns. Columns are factorized in panels of _BlockSize columns, and
+	// each panel of reflectors is accumulated into the compact WY form
+	// Q = I - V * T * V^T, so updates of the trailing columns and
+	// applications of Q are performed as matrix-matrix products.
+	template <class M, class N, const size_t _BlockSize = 32>
+	class qr_decomposition
+	{
+	public:
+		typedef qr_decomposition<M, N, _BlockSize> _Self;
+		typedef typename matrix<M, N>::value_type value_type;
+		static const size_t row_rank = M::rank;
+		static const size_t column_rank = N::rank;
+		static const size_t block_size = _BlockSize;
+
+		static_assert(_Self::row_rank >= _Self::column_rank, "QR decomposition requires at least as many rows as columns.");
+		static_assert(_Self::block_size > 0, "Block size cannot be zero.");
+
+		qr_decomposition()
+			: m_values(), m_tau(), m_t()
+		{
+		}
+
+		explicit qr_decomposition(const matrix<M, N>& a)
+			: m_values(), m_tau(), m_t()
+		{
+			this->factorize(a);
+		}
+
+		void factorize(const matrix<M, N>& a)
+		{
+			const value_type _Zero = number_traits<value_type>::zero();
+
+			m_values.assign(_Self::row_rank * _Self::column_rank, _Zero);
+			m_tau.assign(_Self::column_rank, _Zero);
+			m_t.assign(_Self::column_rank * _Self::block_size, _Zero);
+
+			if (false == a.empty())
+			{
+				for (size_t row = 0; row < _Self::row_rank; ++row)
+				{
+					std::copy(a.crow_begin(row), a.crow_end(row), m_values.begin() + row * _Self::column_rank);
+				}
+			}
+
+			std::vector<value_type> work;
+
+			for (size_t first = 0; first < _Self::column_rank; first += _Self::block_size)
+			{
+				const size_t last = _Self::_PanelEnd(first);
+
+				this->_FactorizePanel(first, last);
+				this->_FormT(first, last);
+
+				// Apply transposed block reflector of the panel to the trailing columns.
+				this->_ApplyBlock(first, last, last, _Self::column_rank, true, work);
+			}
+		}
+
+		// Upper triangular factor R.
+		matrix<N, N> r() const
+		{
+			matrix<N, N> result;
+
+			for (size_t row = 0; row < _Self::column_rank; ++row)
+			{
+				for (size_t col = row; col < _Self::column_rank; ++col)
+				{
+					result(row, col) = m_values[row * _Self::column_rank + col];
+				}
+			}
+
+			return result;
+		}
+
+		// Thin orthogonal factor Q with orthonormal columns.
+		matrix<M, N> q() const
+		{
+			std::vector<value_type> values(_Self::row_rank * _Self::column_rank, number_traits<value_type>::zero());
+			for (size_t i = 0; i < _Self::column_rank; ++i)
+			{
+				values[i * _Self::column_rank + i] = 1;
+			}
+
+			// Q = Q1 * Q2 * ... * Qk, so blocks are applied to identity in reverse order.
+			std::vector<value_type> work;
+			for (size_t block = (_Self::column_rank + _Self::block_size - 1) / _Self::block_size; block-- > 0;)
+			{
+				const size_t first = block * _Self::block_size;
+				const size_t last = _Self::_PanelEnd(first);
+
+				this->_ApplyBlock(values, _Self::column_rank, first, last, 0, _Self::column_rank, false, work);
+			}
+
+			return matrix<M, N>(values);
+		}
+
+		// Computes Q^T * B.
+		vector<M> apply_qt(const vector<M>& b) const
+		{
+			std::vector<value_type> values(b.begin(), b.end());
+			std::vector<value_type> work;
+
+			for (size_t first = 0; first < _Self::column_rank; first += _Self::block_size)
+			{
+				const size_t last = _Self::_PanelEnd(first);
+				this->_ApplyBlock(values, 1, first, last, 0, 1, true, work);
+			}
+
+			return vector<M>(values);
+		}
+
+		// Computes the least squares solution that minimizes |A * x - B|
+		// using the decomposition. Returns false if the matrix is rank
+		// deficient, i.e. a diagonal value of R is negligible relative to
+		// the largest one.
+		bool solve(
+			const vector<M>& b,
+			vector<N>& x) const
+		{
+			if (m_values.empty())
+				throw std::logic_error("Matrix is not factorized.");
+
+			value_type largest = number_traits<value_type>::zero();
+			for (size_t i = 0; i < _Self::column_rank; ++i)
+			{
+				largest = std::max(largest, std::abs(m_values[i * _Self::column_rank + i]));
+			}
+
+			const value_type tolerance = std::numeric_limits<value_type>::epsilon() * (value_type)_Self::row_rank * largest;
+
+			const vector<M> qtb = this->apply_qt(b);
+
+			for (size_t row = _Self::column_rank; row-- > 0;)
+			{
+				const value_type* pRow = m_values.data() + row * _Self::column_rank;
+				if (std::abs(pRow[row]) <= tolerance)
+					return false;
+
+				value_type sum = qtb(row);
+				for (size_t col = row + 1; col < _Self::column_rank; ++col)
+				{
+					sum -= pRow[col] * x(col);
+				}
+
+				x(row) = sum / pRow[row];
+			}
+
+			return true;
+		}
+
+	private:
+		// End of the panel that starts at the given column. Ranks are copied
+		// before they are compared, since std::min takes its arguments by
+		// reference, which would require definitions of the static members.
+		static size_t _PanelEnd(const size_t first)
+		{
+			const size_t end = first + _Self::block_size;
+			const size_t columns = _Self::column_rank;
+
+			return std::min(end, columns);
+		}
+
+		// Value of the Householder vector for the given column. Vectors are stored
+		// below the diagonal of the factorized matrix with implicit unit diagonal.
+		value_type _V(const size_t row, const size_t col) const
+		{
+			if (row < col)
+				return number_traits<value_type>::zero();
+
+			if (row == col)
+				return 1;
+
+			return m_values[row * _Self::column_rank + col];
+		}
+
+		void _FactorizePanel(const size_t first, const size_t last)
+		{
+			const size_t columns = _Self::column_rank;
+
+			for (size_t col = first; col < last; ++col)
+			{
+				// Compute Householder reflector H = I - tau * v * v^T that
+				// zeroes values below the diagonal in the current column.
+				value_type norm = number_traits<value_type>::zero();
+				for (size_t row = col + 1; row < _Self::row_rank; ++row)
+				{
+					const value_type v = m_values[row * columns + col];
+					norm += v * v;
+				}
+
+				value_type& alpha = m_values[col * columns + col];
+				if (number_traits<value_type>::zero() == norm)
+				{
+					m_tau[col] = number_traits<value_type>::zero();
+					continue;
+				}
+
+				const value_type beta = (alpha >= 0 ? -1 : 1) * std::sqrt(alpha * alpha + norm);
+				const value_type scale = 1 / (alpha - beta);
+
+				m_tau[col] = (beta - alpha) / beta;
+				for (size_t row = col + 1; row < _Self::row_rank; ++row)
+				{
+					m_values[row * columns + col] *= scale;
+				}
+
+				alpha = beta;
+
+				// Apply the reflector to the remaining columns of the panel.
+				for (size_t i = col + 1; i < last; ++i)
+				{
+					value_type sum = m_values[col * columns + i];
+					for (size_t row = col + 1; row < _Self::row_rank; ++row)
+					{
+						sum += m_values[row * columns + col] * m_values[row * columns + i];
+					}
+
+					sum *= m_tau[col];
+
+					m_values[col * columns + i] -= sum;
+					for (size_t row = col + 1; row < _Self::row_rank; ++row)
+					{
+						m_values[row * columns + i] -= sum * m_values[row * columns + col];
+					}
+				}
+			}
+		}
+
+		// Forms upper triangular matrix T of the compact WY representation of the panel.
+		void _FormT(const size_t first, const size_t last)
+		{
+			const size_t width = last - first;
+			value_type* pT = m_t.data() + first * _Self::block_size;
+
+			for (size_t j = 0; j < width; ++j)
+			{
+				const value_type tau = m_tau[first + j];
+
+				// T(0:j, j) = -tau * T(0:j, 0:j) * V(:, 0:j)^T * v(j)
+				std::vector<value_type> w(j, number_traits<value_type>::zero());
+				for (size_t row = first + j; row < _Self::row_rank; ++row)
+				{
+					const value_type vj = this->_V(row, first + j);
+					for (size_t i = 0; i < j; ++i)
+					{
+						w[i] += this->_V(row, first + i) * vj;
+					}
+				}
+
+				for (size_t i = 0; i < j; ++i)
+				{
+					value_type sum = number_traits<value_type>::zero();
+					for (size_t k = i; k < j; ++k)
+					{
+						sum += pT[i * _Self::block_size + k] * w[k];
+					}
+
+					pT[i * _Self::block_size + j] = -tau * sum;
+				}
+
+				pT[j * _Self::block_size + j] = tau;
+			}
+		}
+
+		void _ApplyBlock(
+			const size_t first,
+			const size_t last,
+			const size_t begin,
+			const size_t end,
+			const bool transpose,
+			std::vector<value_type>& work)
+		{
+			this->_ApplyBlock(m_values, _Self::column_rank, first, last, begin, end, transpose, work);
+		}
+
+		// Applies block reflector (I - V * T * V^T) or its transpose to columns [begin, end)
+		// of a row-major matrix with the given number of columns:
+		//		W = V^T * C,	W = T * W (or T^T * W),		C = C - V * W
+		void _ApplyBlock(
+			std::vector<value_type>& c,
+			const size_t columns,
+			const size_t first,
+			const size_t last,
+			const size_t begin,
+			const size_t end,
+			const bool transpose,
+			std::vector<value_type>& work) const
+		{
+			if (begin >= end)
+				return;
+
+			const size_t width = last - first;
+			const size_t count = end - begin;
+			const value_type* pT = m_t.data() + first * _Self::block_size;
+
+			work.assign(width * count, number_traits<value_type>::zero());
+
+			for (size_t row = first; row < _Self::row_rank; ++row)
+			{
+				const value_type* pC = c.data() + row * columns + begin;
+				for (size_t i = 0; i < width && first + i <= row; ++i)
+				{
+					const value_type v = this->_V(row, first + i);
+					value_type* pW = work.data() + i * count;
+					for (size_t k = 0; k < count; ++k)
+					{
+						pW[k] += v * pC[k];
+					}
+				}
+			}
+
+			// Multiply by the triangular factor in place. For T, rows are processed
+			// top to bottom, since each row only depends on rows below it; for T^T
+			// rows are processed bottom to top.
+			std::vector<value_type> sum(count);
+			for (size_t n = 0; n < width; ++n)
+			{
+				const size_t i = transpose ? width - 1 - n : n;
+				std::fill(sum.begin(), sum.end(), number_traits<value_type>::zero());
+
+				const size_t from = transpose ? 0 : i;
+				const size_t to = transpose ? i + 1 : width;
+				for (size_t j = from; j < to; ++j)
+				{
+					const value_type t = transpose ? pT[j * _Self::block_size + i] : pT[i * _Self::block_size + j];
+					const value_type* pW = work.data() + j * count;
+					for (size_t k = 0; k < count; ++k)
+					{
+						sum[k] += t * pW[k];
+					}
+				}
+
+				std::copy(sum.begin(), sum.end(), work.begin() + i * count);
+			}
+
+			for (size_t row = first; row < _Self::row_rank; ++row)
+			{
+				value_type* pC = c.data() + row * columns + begin;
+				for (size_t i = 0; i < width && first + i <= row; ++i)
+				{
+					const value_type v = this->_V(row, first + i);
+					const value_type* pW = work.data() + i * count;
+					for (size_t k = 0; k < count; ++k)
+					{
+						pC[k] -= v * pW[k];
+					}
+				}
+			}
+		}
+
+		std::vector<value_type> m_values;
+		std::vector<value_type> m_tau;
+		std::vector<value_type> m_t;
+	};
+
+	// Algorithm to find the least squares solution of an overdetermined
+	// system of linear equations defined by A * x = B. The solution is
+	// computed from the QR decomposition of A, which avoids forming
+	// normal equations A^T * A and squaring the condition number.
+	template <class M, class N>
+	bool least_squares(
+		const matrix<M, N>& a,
+		const vector<M>& b,
+		vector<N>& x)
+	{
+		static_assert(M::rank > N::rank, "Least squares problem must be overdetermined.");
+
+		return qr_decomposition<M, N>(a).solve(b, x);
+	}
+
+	// Online solver of a least squares problem for a stream of observations
+	// (x, y), where each observation adds an equation x * w = y. Instead of
+	// solving the whole system for every new observation, the solver keeps
+	// the inverse of the weighted information matrix and applies
+	// Sherman-Morrison (or Woodbury for a block of observations) updates,
+	// which costs O(n^2) per observation.
+	//
+	// Older observations are discounted by the forgetting factor, so the
+	// solver can track slowly changing systems. To keep round-off errors from
+	// accumulating in the inverse, it is periodically recomputed from the
+	// information matrix, which is updated alongside the inverse.
+	template <class N>
+	class recursive_least_squares
+	{
+	public:
+		typedef recursive_least_squares<N> _Self;
+		typedef typename matrix<N, N>::value_type value_type;
+		static const size_t rank = N::rank;
+
+		recursive_least_squares(
+			const value_type forgetting_factor = 1.0,
+			const size_t refactorization_interval = 1000,
+			const value_type regularization = 1.0e-6)
+			: m_lambda(forgetting_factor),
+			m_interval(refactorization_interval),
+			m_count(0),
+			m_inverse(_Self::rank * _Self::rank, number_traits<value_type>::zero()),
+			m_information(_Self::rank * _Self::rank, number_traits<value_type>::zero()),
+			m_rhs(_Self::rank, number_traits<value_type>::zero()),
+			m_coefficients(_Self::rank, number_traits<value_type>::zero()),
+			m_x(_Self::rank, number_traits<value_type>::zero()),
+			m_px(_Self::rank, number_traits<value_type>::zero()),
+			m_block()
+		{
+			if (forgetting_factor <= 0.0 || forgetting_factor > 1.0)
+				throw std::invalid_argument("Forgetting factor must be in (0, 1] range.");
+			if (regularization <= 0.0)
+				throw std::invalid_argument("Regularization must be positive.");
+
+			// Start from a regularized information matrix, so the inverse exists
+			// before the system is fully determined by the observations.
+			for (size_t i = 0; i < _Self::rank; ++i)
+			{
+				m_information[i * _Self::rank + i] = regularization;
+				m_inverse[i * _Self::rank + i] = 1.0 / regularization;
+			}
+		}
+
+		// Adds a single observation using Sherman-Morrison formula:
+		//		k = P * x / (lambda + x^T * P * x)
+		//		w = w + k * (y - x^T * w)
+		//		P = (P - k * x^T * P) / lambda
+		// Returns false if a periodic refactorization was due and failed,
+		// see refactorize().
+		bool update(
+			const vector<N>& x,
+			const value_type y)
+		{
+			// Working vectors are members, so updates do not allocate memory.
+			std::copy(x.cbegin(), x.cend(), m_x.begin());
+
+			const std::vector<value_type>& values = m_x;
+			std::vector<value_type>& px = m_px;
+
+			value_type denominator = m_lambda;
+			value_type error = y;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				const value_type* pRow = m_inverse.data() + row * _Self::rank;
+
+				value_type sum = number_traits<value_type>::zero();
+				for (size_t col = 0; col < _Self::rank; ++col)
+				{
+					sum += pRow[col] * values[col];
+				}
+
+				px[row] = sum;
+				denominator += values[row] * sum;
+				error -= values[row] * m_coefficients[row];
+			}
+
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				m_coefficients[row] += px[row] * error / denominator;
+			}
+
+			// Inverse is symmetric, so only the upper triangle is computed,
+			// and the lower triangle is mirrored to keep it exactly symmetric.
+			const value_type scale = 1.0 / m_lambda;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				const value_type factor = px[row] / denominator;
+				for (size_t col = row; col < _Self::rank; ++col)
+				{
+					const value_type value = (m_inverse[row * _Self::rank + col] - factor * px[col]) * scale;
+					m_inverse[row * _Self::rank + col] = value;
+					m_inverse[col * _Self::rank + row] = value;
+				}
+			}
+
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				value_type* pRow = m_information.data() + row * _Self::rank;
+				for (size_t col = 0; col < _Self::rank; ++col)
+				{
+					pRow[col] = m_lambda * pRow[col] + values[row] * values[col];
+				}
+
+				m_rhs[row] = m_lambda * m_rhs[row] + values[row] * y;
+			}
+
+			return this->_Observed(1);
+		}
+
+		// Adds a block of observations (rows of X) using Woodbury formula:
+		//		G = P * X^T * (lambda * I + X * P * X^T)^-1
+		//		w = w + G * (y - X * w)
+		//		P = (P - G * X * P) / lambda
+		// Returns false if a periodic refactorization was due and failed,
+		// see refactorize().
+		template <class K>
+		bool update(
+			const matrix<K, N>& x,
+			const vector<K>& y)
+		{
+			const size_t count = K::rank;
+
+			// PX and G share a working buffer of the solver, which only grows
+			// when a larger block is observed.
+			if (m_block.size() < 2 * count * _Self::rank)
+			{
+				m_block.resize(2 * count * _Self::rank);
+			}
+
+			// PX = P * X^T is stored transposed, so each row is a contiguous vector.
+			value_type* px = m_block.data();
+			value_type* g = m_block.data() + count * _Self::rank;
+			for (size_t k = 0; k < count; ++k)
+			{
+				auto itX = x.crow_begin(k);
+				for (size_t row = 0; row < _Self::rank; ++row)
+				{
+					const value_type* pRow = m_inverse.data() + row * _Self::rank;
+					px[k * _Self::rank + row] = std::inner_product(pRow, pRow + _Self::rank, itX, number_traits<value_type>::zero());
+				}
+			}
+
+			matrix<K, K> s;
+			vector<K> error;
+			for (size_t i = 0; i < count; ++i)
+			{
+				for (size_t j = 0; j < count; ++j)
+				{
+					s(i, j) = std::inner_product(x.crow_begin(i), x.crow_end(i), px + j * _Self::rank, number_traits<value_type>::zero());
+				}
+
+				s(i, i) += m_lambda;
+				error(i) = y(i) - std::inner_product(x.crow_begin(i), x.crow_end(i), m_coefficients.cbegin(), number_traits<value_type>::zero());
+			}
+
+			lu_decomposition<K> lu;
+			if (false == lu.factorize(s))
+				throw std::domain_error("Observation block is degenerate.");
+
+			// G^T = S^-1 * PX^T is computed column by column, since S is symmetric.
+			vector<K> column;
+			vector<K> solution;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t k = 0; k < count; ++k)
+				{
+					column(k) = px[k * _Self::rank + row];
+				}
+
+				lu.solve(column, solution);
+
+				for (size_t k = 0; k < count; ++k)
+				{
+					g[k * _Self::rank + row] = solution(k);
+				}
+			}
+
+			for (size_t k = 0; k < count; ++k)
+			{
+				for (size_t row = 0; row < _Self::rank; ++row)
+				{
+					m_coefficients[row] += g[k * _Self::rank + row] * error(k);
+				}
+			}
+
+			const value_type scale = 1.0 / m_lambda;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = row; col < _Self::rank; ++col)
+				{
+					value_type sum = m_inverse[row * _Self::rank + col];
+					for (size_t k = 0; k < count; ++k)
+					{
+						sum -= g[k * _Self::rank + row] * px[k * _Self::rank + col];
+					}
+
+					m_inverse[row * _Self::rank + col] = sum * scale;
+					m_inverse[col * _Self::rank + row] = sum * scale;
+				}
+			}
+
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				value_type* pRow = m_information.data() + row * _Self::rank;
+				for (size_t col = 0; col < _Self::rank; ++col)
+				{
+					value_type sum = number_traits<value_type>::zero();
+					for (size_t k = 0; k < count; ++k)
+					{
+						sum += x(k, row) * x(k, col);
+					}
+
+					pRow[col] = m_lambda * pRow[col] + sum;
+				}
+
+				value_type rhs = number_traits<value_type>::zero();
+				for (size_t k = 0; k < count; ++k)
+				{
+					rhs += x(k, row) * y(k);
+				}
+
+				m_rhs[row] = m_lambda * m_rhs[row] + rhs;
+			}
+
+			return this->_Observed(count);
+		}
+
+		// Recomputes the inverse and the solution from the information matrix
+		// to discard numerical drift accumulated by rank-1 updates. Returns
+		// false and keeps the current state if the information matrix is
+		// singular, e.g. when the forgetting factor has discounted all
+		// observations that determined the system.
+		bool refactorize()
+		{
+			lu_decomposition<N> lu;
+			if (false == lu.factorize(matrix<N, N>(m_information)))
+				return false;
+
+			vector<N> column;
+			vector<N> solution;
+			for (size_t col = 0; col < _Self::rank; ++col)
+			{
+				column = vector<N>();
+				column(col) = 1.0;
+
+				lu.solve(column, solution);
+
+				for (size_t row = 0; row < _Self::rank; ++row)
+				{
+					m_inverse[row * _Self::rank + col] = solution(row);
+				}
+			}
+
+			lu.solve(vector<N>(m_rhs), solution);
+			std::copy(solution.cbegin(), solution.cend(), m_coefficients.begin());
+
+			return true;
+		}
+
+		value_type predict(const vector<N>& x) const
+		{
+			return std::inner_product(m_coefficients.cbegin(), m_coefficients.cend(), x.cbegin(), number_traits<value_type>::zero());
+		}
+
+		vector<N> coefficients() const
+		{
+			return vector<N>(m_coefficients);
+		}
+
+		matrix<N, N> inverse() const
+		{
+			return matrix<N, N>(m_inverse);
+		}
+
+		size_t observations() const
+		{
+			return m_count;
+		}
+
+	private:
+		bool _Observed(const size_t count)
+		{
+			const size_t before = m_count;
+			m_count += count;
+
+			// Zero interval disables periodic refactorization.
+			if (m_interval > 0 && m_count / m_interval != before / m_interval)
+				return this->refactorize();
+
+			return true;
+		}
+
+		value_type m_lambda;
+		size_t m_interval;
+		size_t m_count;
+		std::vector<value_type> m_inverse;
+		std::vector<value_type> m_information;
+		std::vector<value_type> m_rhs;
+		std::vector<value_type> m_coefficients;
+		std::vector<value_type> m_x;
+		std::vector<value_type> m_px;
+		std::vector<value_type> m_block;
+	};
+
+	// Truncated singular value decomposition A ~ U * S * V^T of rank K computed
+	// with a randomized range finder. The range of A is sampled by multiplying
+	// it with a random matrix of K + _Oversampling columns, refined with power
+	// iterations, and orthonormalized with QR decomposition. The small projected
+	// matrix Q^T * A is then decomposed exactly with one-sided Jacobi rotations.
+	// The whole computation costs O(m * n * k).
+	template <class M, class N, class K, const size_t _Oversampling = 10>
+	class truncated_svd
+	{
+	public:
+		typedef truncated_svd<M, N, K, _Oversampling> _Self;
+		typedef typename matrix<M, N>::value_type value_type;
+		static const size_t row_rank = M::rank;
+		static const size_t column_rank = N::rank;
+		static const size_t rank = K::rank;
+
+		static_assert(_Self::rank <= _Self::row_rank && _Self::rank <= _Self::column_rank, "Rank of decomposition cannot exceed matrix dimensions.");
+
+		// Number of samples of the matrix range.
+		static const size_t sketch_rank =
+			(_Self::rank + _Oversampling < _Self::row_rank)
+			? ((_Self::rank + _Oversampling < _Self::column_rank) ? _Self::rank + _Oversampling : _Self::column_rank)
+			: ((_Self::row_rank < _Self::column_rank) ? _Self::row_rank : _Self::column_rank);
+
+		typedef dimension<_Self::sketch_rank> L;
+
+		explicit truncated_svd(
+			const matrix<M, N>& a,
+			const size_t power_iterations = 2)
+			: m_u(), m_sigma(), m_v()
+		{
+			std::vector<value_type> values(_Self::row_rank * _Self::column_rank, number_traits<value_type>::zero());
+			if (false == a.empty())
+			{
+				for (size_t row = 0; row < _Self::row_rank; ++row)
+				{
+					std::copy(a.crow_begin(row), a.crow_end(row), values.begin() + row * _Self::column_rank);
+				}
+			}
+
+			std::random_device rd;
+			std::mt19937 gen(rd());
+			std::normal_distribution<value_type> distr(0.0, 1.0);
+
+			std::vector<value_type> omega(_Self::column_rank * L::rank);
+			std::generate(omega.begin(), omega.end(), [&distr, &gen]() { return distr(gen); });
+
+			// Sample the range of the matrix: Y = A * Omega.
+			std::vector<value_type> q = _Self::_Orthonormalize<M>(_Self::_Multiply(values, omega));
+
+			// Power iterations Y = (A * A^T)^q * Y amplify the gap between leading and trailing singular
+			// values. Samples are orthonormalized after each multiplication to preserve small singular values.
+			for (size_t i = 0; i < power_iterations; ++i)
+			{
+				const std::vector<value_type> z = _Self::_Orthonormalize<N>(_Self::_MultiplyTransposed(values, _Self::column_rank, q, L::rank));
+				q = _Self::_Orthonormalize<M>(_Self::_Multiply(values, z));
+			}
+
+			// Project the matrix to the sampled range: B = Q^T * A, which is L x N.
+			std::vector<value_type> b = _Self::_MultiplyTransposed(q, L::rank, values, _Self::column_rank);
+			std::vector<value_type> u(L::rank * L::rank, number_traits<value_type>::zero());
+			for (size_t i = 0; i < L::rank; ++i)
+			{
+				u[i * L::rank + i] = 1;
+			}
+
+			_Self::_Jacobi(b, u);
+
+			// Rows of B are now orthogonal: B = S * V^T. Pick rows with the largest norms.
+			std::vector<value_type> norms(L::rank);
+			std::vector<size_t> order(L::rank);
+			for (size_t i = 0; i < L::rank; ++i)
+			{
+				const value_type* pRow = b.data() + i * _Self::column_rank;
+				norms[i] = std::sqrt(std::inner_product(pRow, pRow + _Self::column_rank, pRow, number_traits<value_type>::zero()));
+				order[i] = i;
+			}
+
+			std::sort(order.begin(), order.end(),
+				[&norms](const size_t i1, const size_t i2) { return norms[i1] > norms[i2]; });
+
+			for (size_t k = 0; k < _Self::rank; ++k)
+			{
+				const size_t index = order[k];
+				const value_type sigma = norms[index];
+				m_sigma(k) = sigma;
+
+				// U = Q * U(B)
+				for (size_t row = 0; row < _Self::row_rank; ++row)
+				{
+					const value_type* pQ = q.data() + row * L::rank;
+					value_type sum = number_traits<value_type>::zero();
+					for (size_t i = 0; i < L::rank; ++i)
+					{
+						sum += pQ[i] * u[i * L::rank + index];
+					}
+
+					m_u(row, k) = sum;
+				}
+
+				if (number_traits<value_type>::zero() != sigma)
+				{
+					const value_type* pRow = b.data() + index * _Self::column_rank;
+					for (size_t col = 0; col < _Self::column_rank; ++col)
+					{
+						m_v(col, k) = pRow[col] / sigma;
+					}
+				}
+			}
+		}
+
+		// Left singular vectors.
+		const matrix<M, K>& u() const
+		{
+			return m_u;
+		}
+
+		// Singular values in descending order.
+		const vector<K>& singular_values() const
+		{
+			return m_sigma;
+		}
+
+		// Right singular vectors.
+		const matrix<N, K>& v() const
+		{
+			return m_v;
+		}
+
+	private:
+		// Computes A * B for row-major A with N columns.
+		static std::vector<value_type> _Multiply(
+			const std::vector<value_type>& a,
+			const std::vector<value_type>& b)
+		{
+			const size_t rows = a.size() / _Self::column_rank;
+			const size_t columns = b.size() / _Self::column_rank;
+
+			std::vector<value_type> result(rows * columns, number_traits<value_type>::zero());
+			for (size_t row = 0; row < rows; ++row)
+			{
+				value_type* pResult = result.data() + row * columns;
+				const value_type* pA = a.data() + row * _Self::column_rank;
+				for (size_t i = 0; i < _Self::column_rank; ++i)
+				{
+					const value_type factor = pA[i];
+					const value_type* pB = b.data() + i * columns;
+					for (size_t col = 0; col < columns; ++col)
+					{
+						pResult[col] += factor * pB[col];
+					}
+				}
+			}
+
+			return result;
+		}
+
+		// Computes A^T * B for row-major matrices with the same number of rows.
+		static std::vector<value_type> _MultiplyTransposed(
+			const std::vector<value_type>& a,
+			const size_t a_columns,
+			const std::vector<value_type>& b,
+			const size_t b_columns)
+		{
+			const size_t rows = a.size() / a_columns;
+
+			// Each row of the inputs contributes an outer product to the result,
+			// so both inputs are traversed in memory order.
+			std::vector<value_type> result(a_columns * b_columns, number_traits<value_type>::zero());
+			for (size_t row = 0; row < rows; ++row)
+			{
+				const value_type* pA = a.data() + row * a_columns;
+				const value_type* pB = b.data() + row * b_columns;
+				for (size_t i = 0; i < a_columns; ++i)
+				{
+					const value_type factor = pA[i];
+					value_type* pResult = result.data() + i * b_columns;
+					for (size_t col = 0; col < b_columns; ++col)
+					{
+						pResult[col] += factor * pB[col];
+					}
+				}
+			}
+
+			return result;
+		}
+
+		// Returns orthonormal basis of the columns of a row-major R x L matrix.
+		template <class R>
+		static std::vector<value_type> _Orthonormalize(const std::vector<value_type>& values)
+		{
+			const matrix<R, L> q = qr_decomposition<R, L>(matrix<R, L>(values)).q();
+
+			std::vector<value_type> result(R::rank * L::rank);
+			for (size_t row = 0; row < R::rank; ++row)
+			{
+				std::copy(q.crow_begin(row), q.crow_end(row), result.begin() + row * L::rank);
+			}
+
+			return result;
+		}
+
+		// One-sided Jacobi algorithm that applies plane rotations to the rows of B
+		// until they are orthogonal, and accumulates rotations in the columns of U.
+		static void _Jacobi(
+			std::vector<value_type>& b,
+			std::vector<value_type>& u)
+		{
+			const value_type epsilon = std::numeric_limits<value_type>::epsilon();
+			const size_t columns = _Self::column_rank;
+			const size_t max_sweeps = 60;
+
+			for (size_t sweep = 0; sweep < max_sweeps; ++sweep)
+			{
+				bool rotated = false;
+
+				for (size_t p = 0; p + 1 < L::rank; ++p)
+				{
+					for (size_t q = p + 1; q < L::rank; ++q)
+					{
+						value_type* pP = b.data() + p * columns;
+						value_type* pQ = b.data() + q * columns;
+
+						const value_type alpha = std::inner_product(pP, pP + columns, pP, number_traits<value_type>::zero());
+						const value_type beta = std::inner_product(pQ, pQ + columns, pQ, number_traits<value_type>::zero());
+						const value_type gamma = std::inner_product(pP, pP + columns, pQ, number_traits<value_type>::zero());
+
+						if (std::abs(gamma) <= epsilon * std::sqrt(alpha * beta))
+							continue;
+
+						rotated = true;
+
+						const value_type zeta = (beta - alpha) / (2 * gamma);
+						const value_type t = (zeta >= 0 ? 1 : -1) / (std::abs(zeta) + std::sqrt(1 + zeta * zeta));
+						const value_type c = 1 / std::sqrt(1 + t * t);
+						const value_type s = c * t;
+
+						for (size_t col = 0; col < columns; ++col)
+						{
+							const value_type vp = pP[col];
+							const value_type vq = pQ[col];
+							pP[col] = c * vp - s * vq;
+							pQ[col] = s * vp + c * vq;
+						}
+
+						for (size_t row = 0; row < L::rank; ++row)
+						{
+							value_type* pU = u.data() + row * L::rank;
+							const value_type vp = pU[p];
+							const value_type vq = pU[q];
+							pU[p] = c * vp - s * vq;
+							pU[q] = s * vp + c * vq;
+						}
+					}
+				}
+
+				if (false == rotated)
+					break;
+			}
+		}
+
+		matrix<M, K> m_u;
+		vector<K> m_sigma;
+		matrix<N, K> m_v;
+	};
+
+	// Principal component analysis of a data set with F features, which keeps
+	// K components with the largest variance. Components are computed with the
+	// randomized truncated SVD of the centered data matrix.
+	template <class F, class K>
+	class principal_components
+	{
+	public:
+		typedef principal_components<F, K> _Self;
+		typedef typename matrix<F, K>::value_type value_type;
+
+		// Computes principal components of the data set with samples in matrix rows.
+		template <class S>
+		explicit principal_components(
+			const matrix<S, F>& data,
+			const size_t power_iterations = 2)
+			: m_mean(), m_components(), m_offset(), m_variance()
+		{
+			for (size_t row = 0; row < S::rank; ++row)
+			{
+				std::transform(data.crow_begin(row), data.crow_end(row), m_mean.cbegin(), m_mean.begin(),
+					[](const value_type& v, const value_type& sum) { return sum + v; });
+			}
+
+			m_mean = m_mean * (1.0 / S::rank);
+
+			matrix<S, F> centered(data);
+			for (size_t row = 0; row < S::rank; ++row)
+			{
+				std::transform(centered.crow_begin(row), centered.crow_end(row), m_mean.cbegin(), centered.row_begin(row),
+					[](const value_type& v, const value_type& mean) { return v - mean; });
+			}
+
+			truncated_svd<S, F, K> svd(centered, power_iterations);
+
+			m_components = svd.v();
+			m_offset = m_components.transpose() * m_mean;
+
+			for (size_t k = 0; k < K::rank; ++k)
+			{
+				const value_type sigma = svd.singular_values()(k);
+				m_variance(k) = sigma * sigma / std::max<size_t>(S::rank - 1, 1);
+			}
+		}
+
+		// Projects all samples of the data set with a single matrix multiplication:
+		// (X - 1 * mean^T) * V == X * V - 1 * (V^T * mean)^T
+		template <class S>
+		matrix<S, K> project(const matrix<S, F>& data) const
+		{
+			matrix<S, K> result = data * m_components;
+
+			for (size_t row = 0; row < S::rank; ++row)
+			{
+				std::transform(result.crow_begin(row), result.crow_end(row), m_offset.cbegin(), result.row_begin(row),
+					[](const value_type& v, const value_type& offset) { return v - offset; });
+			}
+
+			return result;
+		}
+
+		vector<K> project(const vector<F>& sample) const
+		{
+			vector<K> result;
+			for (size_t k = 0; k < K::rank; ++k)
+			{
+				value_type sum = -m_offset(k);
+				for (size_t i = 0; i < F::rank; ++i)
+				{
+					sum += sample(i) * m_components(i, k);
+				}
+
+				result(k) = sum;
+			}
+
+			return result;
+		}
+
+		const vector<F>& mean() const
+		{
+			return m_mean;
+		}
+
+		// Principal directions in matrix columns.
+		const matrix<F, K>& components() const
+		{
+			return m_components;
+		}
+
+		// Variance of the data set along each principal direction.
+		const vector<K>& explained_variance() const
+		{
+			return m_variance;
+		}
+
+	private:
+		vector<F> m_mean;
+		matrix<F, K> m_components;
+		vector<K> m_offset;
+		vector<K> m_variance;
+	};
+
+	// Utility function to project a data set with samples in matrix rows
+	// to K principal components.
+	template <class K, class S, class F>
+	matrix<S, K> pca_projection(const matrix<S, F>& data)
+	{
+		return principal_components<F, K>(data).project(data);
+	}
 }
@@ -1,12 +1,2304 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <functional>
+#include <future>
+#include <limits>
+#include <map>
 #include <memory>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "thread_pool.h"
 
 namespace algebra
 {
 namespace expressions
 {
+	// Cache statistics of an expression graph.
+	struct cache_statistics
+	{
+		size_t hits;
+		size_t misses;
+	};
+
+	// Memory for the nodes of expression graphs. While an arena_scope
+	// for an arena is active on a thread, nodes created on that thread
+	// are placed in large blocks owned by the arena instead of separate
+	// heap allocations, and their memory is released at once with the
+	// last of them. Nodes keep the arena alive, so expressions may
+	// outlive both the scope and the arena object.
+	//
+	// An arena is not synchronized and must be active on a single
+	// thread at a time. Node memory is never reused, so an arena is
+	// meant for graphs built once, not for graphs rebuilt in a loop.
+	//
+	// Sample usage:
+	//		algebra::expressions::expression_arena arena;
+	//		algebra::expressions::arena_scope scope(arena);
+	//		auto e = (v1 + v2) * 2.0;
+	//
+	class expression_arena;
+
+	// Arena scopes of one thread. Slots are only ever added, so a thread
+	// finds its own slot by id without a lock, and only the thread with
+	// that id writes the arena of a slot.
+	struct _arena_slot
+	{
+		std::thread::id thread;
+		const expression_arena* arena;
+		_arena_slot* next;
+	};
+
+	// Slots of all threads which have used an arena scope, and the number
+	// of threads with an active arena. Static data members are zero
+	// initialized before any code runs, and keep the lookup free of
+	// thread_local, which the targeted compilers do not support.
+	template <class _Arena>
+	struct _arena_slots
+	{
+		static std::atomic<_arena_slot*> head;
+		static std::atomic<size_t> active;
+	};
+
+	template <class _Arena>
+	std::atomic<_arena_slot*> _arena_slots<_Arena>::head;
+
+	template <class _Arena>
+	std::atomic<size_t> _arena_slots<_Arena>::active;
+
+	class expression_arena
+	{
+	private:
+		struct _blocks;
+		typedef _arena_slots<expression_arena> _slots;
+
+	public:
+		// Throws std::invalid_argument if block_size cannot hold the block
+		// header and one maximally aligned object.
+		explicit expression_arena(const size_t block_size = 16 * 1024)
+			: m_blocks(new _blocks(block_size))
+		{
+		}
+
+		~expression_arena()
+		{
+			m_blocks->release(m_blocks->reserved + 1);
+		}
+
+		expression_arena(const expression_arena&) = delete;
+		expression_arena& operator=(const expression_arena&) = delete;
+
+		// Bytes taken by nodes.
+		size_t size() const
+		{
+			return m_blocks->used;
+		}
+
+		// Number of blocks allocated from the heap.
+		size_t blocks() const
+		{
+			return m_blocks->count;
+		}
+
+		// Allocator placing objects in an arena, with deallocation left
+		// to the arena. Every allocation holds a reference to the arena
+		// memory, so copies of the allocator are free.
+		template <class T>
+		class allocator
+		{
+		public:
+			typedef T value_type;
+
+			explicit allocator(const expression_arena& arena)
+				: m_blocks(arena.m_blocks)
+			{
+			}
+
+			template <class U>
+			allocator(const allocator<U>& other)
+				: m_blocks(other.m_blocks)
+			{
+			}
+
+			T* allocate(const size_t count)
+			{
+				void* memory = m_blocks->allocate(count * sizeof(T), std::alignment_of<T>::value);
+				m_blocks->acquire();
+
+				return static_cast<T*>(memory);
+			}
+
+			void deallocate(T*, const size_t)
+			{
+				m_blocks->release(1);
+			}
+
+			template <class U>
+			bool operator==(const allocator<U>& other) const
+			{
+				return m_blocks == other.m_blocks;
+			}
+
+			template <class U>
+			bool operator!=(const allocator<U>& other) const
+			{
+				return m_blocks != other.m_blocks;
+			}
+
+		private:
+			template <class U>
+			friend class allocator;
+
+			_blocks* m_blocks;
+		};
+
+		// Arena active on the calling thread, nullptr if there is none.
+		// Threads are only looked up while some thread has an active
+		// arena.
+		static const expression_arena* current()
+		{
+			if (0 == _slots::active.load(std::memory_order_relaxed))
+				return nullptr;
+
+			const _arena_slot* slot = _Slot(false);
+			return (nullptr != slot) ? slot->arena : nullptr;
+		}
+
+		// Makes the given arena, or none for nullptr, active on the
+		// calling thread and returns the arena active before.
+		static const expression_arena* _Activate(const expression_arena* arena)
+		{
+			_arena_slot* slot = _Slot(true);
+			const expression_arena* previous = slot->arena;
+			slot->arena = arena;
+
+			if (nullptr == previous && nullptr != arena)
+			{
+				_slots::active.fetch_add(1, std::memory_order_relaxed);
+			}
+			else if (nullptr != previous && nullptr == arena)
+			{
+				_slots::active.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			return previous;
+		}
+
+	private:
+		// Finds the slot of the calling thread, and adds it if create is
+		// set and there is none.
+		static _arena_slot* _Slot(const bool create)
+		{
+			const std::thread::id id = std::this_thread::get_id();
+
+			_arena_slot* head = _slots::head.load(std::memory_order_acquire);
+			for (_arena_slot* slot = head; nullptr != slot; slot = slot->next)
+			{
+				if (id == slot->thread)
+					return slot;
+			}
+
+			if (false == create)
+				return nullptr;
+
+			_arena_slot* slot = new _arena_slot();
+			slot->thread = id;
+			slot->arena = nullptr;
+			slot->next = head;
+
+			while (false == _slots::head.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_acquire))
+			{
+			}
+
+			return slot;
+		}
+
+		// Blocks are chained through a header holding the previous block,
+		// and released with the last reference to them. The arena and
+		// every allocation hold a reference. References are counted
+		// atomically, since nodes may be released on any thread, and
+		// taken by the arena thread in batches, so allocations do not
+		// pay for an atomic operation each.
+		struct _blocks
+		{
+			explicit _blocks(const size_t size)
+				: block_size(size), used(0), count(0), current(nullptr), offset(0), last(nullptr), reserved(0), owners(1)
+			{
+				// A block must hold its header and at least one aligned object.
+				if (size < 2 * header)
+				{
+					throw std::invalid_argument("Block size is too small.");
+				}
+			}
+
+			~_blocks()
+			{
+				while (nullptr != last)
+				{
+					char* previous = *reinterpret_cast<char**>(last);
+					delete[] last;
+					last = previous;
+				}
+			}
+
+			void release(const size_t references)
+			{
+				if (references == owners.fetch_sub(references, std::memory_order_acq_rel))
+				{
+					delete this;
+				}
+			}
+
+			void acquire()
+			{
+				if (0 == reserved)
+				{
+					const size_t batch = 64;
+					owners.fetch_add(batch, std::memory_order_relaxed);
+					reserved = batch;
+				}
+
+				--reserved;
+			}
+
+			void* allocate(const size_t size, const size_t alignment)
+			{
+				// Objects larger than a block get a block of their own,
+				// which leaves the current block open for smaller ones.
+				if (size + alignment > block_size - header)
+				{
+					char* block = _Block(header + size + alignment);
+					used += size;
+
+					return _Align(block + header, size + alignment, size, alignment);
+				}
+
+				void* start = (nullptr != current) ? _Align(current + offset, block_size - offset, size, alignment) : nullptr;
+				if (nullptr == start)
+				{
+					current = _Block(block_size);
+					start = _Align(current + header, block_size - header, size, alignment);
+				}
+
+				offset = static_cast<size_t>(static_cast<char*>(start) - current) + size;
+				used += size;
+
+				return start;
+			}
+
+			char* _Block(const size_t size)
+			{
+				char* block = new char[size];
+				*reinterpret_cast<char**>(block) = last;
+				last = block;
+				++count;
+
+				return block;
+			}
+
+			static void* _Align(void* start, size_t space, const size_t size, const size_t alignment)
+			{
+				return std::align(alignment, size, start, space);
+			}
+
+			static const size_t header = std::alignment_of<std::max_align_t>::value;
+
+			size_t block_size;
+			size_t used;
+			size_t count;
+			char* current;
+			size_t offset;
+			char* last;
+			size_t reserved;
+			std::atomic<size_t> owners;
+		};
+
+	private:
+		_blocks* m_blocks;
+	};
+
+	// Makes an arena active on the calling thread for the lifetime of
+	// the scope. Scopes may be nested, the innermost one is active.
+	class arena_scope
+	{
+	public:
+		explicit arena_scope(const expression_arena& arena)
+			: m_previous(expression_arena::_Activate(std::addressof(arena)))
+		{
+		}
+
+		~arena_scope()
+		{
+			expression_arena::_Activate(m_previous);
+		}
+
+		arena_scope(const arena_scope&) = delete;
+		arena_scope& operator=(const arena_scope&) = delete;
+
+	private:
+		const expression_arena* m_previous;
+	};
+
+	// Creates a node in the active arena, or on the heap if there is none.
+	template <class _Node, class... _Args>
+	std::shared_ptr<_Node> _make_node(_Args&&... args)
+	{
+		const expression_arena* arena = expression_arena::current();
+		if (nullptr == arena)
+			return std::make_shared<_Node>(std::forward<_Args>(args)...);
+
+		return std::allocate_shared<_Node>(expression_arena::allocator<_Node>(*arena), std::forward<_Args>(args)...);
+	}
+
+	struct _plus
+	{
+		template <class A, class B>
+		auto operator()(const A& a, const B& b) const -> decltype(a + b)
+		{
+			return a + b;
+		}
+	};
+
+	struct _minus
+	{
+		template <class A, class B>
+		auto operator()(const A& a, const B& b) const -> decltype(a - b)
+		{
+			return a - b;
+		}
+	};
+
+	struct _multiplies
+	{
+		template <class A, class B>
+		auto operator()(const A& a, const B& b) const -> decltype(a * b)
+		{
+			return a * b;
+		}
+	};
+
+	struct _transpose
+	{
+		template <class A>
+		auto operator()(const A& a) const -> decltype(a.transpose())
+		{
+			return a.transpose();
+		}
+	};
+
+	// Computes the result of an operation into an existing destination.
+	// Overloads for matrix and vector types write element by element, so
+	// repeated evaluation into the same destination does not allocate.
+	template <class _Op, class T, class A>
+	void _apply(const _Op& op, T& dest, const A& a)
+	{
+		dest = static_cast<T>(op(a));
+	}
+
+	template <class _Op, class T, class A, class B>
+	void _apply(const _Op& op, T& dest, const A& a, const B& b)
+	{
+		dest = static_cast<T>(op(a, b));
+	}
+
+	// Computes alpha * (a * b) into an existing destination.
+	template <class T, class A, class B>
+	void _apply(const _multiplies& op, T& dest, const A& a, const B& b, const double alpha)
+	{
+		dest = static_cast<T>(op(a, b) * alpha);
+	}
+
+	// Checks if a value is the identity of an operation. Only arithmetic
+	// values are checked by default, matrix.h adds identity matrices.
+	template <class T>
+	bool _is_identity(const T& value, std::true_type)
+	{
+		return static_cast<T>(1) == value;
+	}
+
+	template <class T>
+	bool _is_identity(const T&, std::false_type)
+	{
+		return false;
+	}
+
+	template <class T>
+	bool _is_identity(const _multiplies&, const T& value)
+	{
+		return _is_identity(value, std::is_arithmetic<T>());
+	}
+
+	// Storage for an intermediate result of a compiled expression.
+	class _buffer_base
+	{
+	public:
+		virtual ~_buffer_base()
+		{
+		}
+
+		virtual void* get() = 0;
+	};
+
+	template <class T>
+	class _buffer : public _buffer_base
+	{
+	public:
+		void* get() override
+		{
+			return std::addressof(m_value);
+		}
+
+	private:
+		T m_value;
+	};
+
+	class _node_base;
+
+	// Adjoints of the nodes of a graph, the derivatives of the
+	// differentiated expression with respect to the node values,
+	// accumulated during reverse mode differentiation.
+	class _adjoints
+	{
+	public:
+		// Returns the adjoint of a node, nullptr if nothing depends on it.
+		template <class T>
+		const T* find(const _node_base* node) const
+		{
+			auto found = m_values.find(node);
+			if (m_values.end() == found)
+				return nullptr;
+
+			return static_cast<const T*>(found->second->get());
+		}
+
+		// Returns the adjoint of a node, zero if nothing depends on it.
+		template <class T>
+		T value(const _node_base* node) const
+		{
+			const T* adjoint = find<T>(node);
+			return (nullptr != adjoint) ? *adjoint : T();
+		}
+
+		template <class T>
+		void add(const _node_base* node, const T& value)
+		{
+			std::unique_ptr<_buffer_base>& slot = m_values[node];
+
+			if (nullptr == slot)
+			{
+				slot.reset(new _buffer<T>());
+				*static_cast<T*>(slot->get()) = value;
+			}
+			else
+			{
+				T& sum = *static_cast<T*>(slot->get());
+				_apply(_plus(), sum, sum, value);
+			}
+		}
+
+	private:
+		std::unordered_map<const _node_base*, std::unique_ptr<_buffer_base>> m_values;
+	};
+
+	// Adjoint of an operand, passed to the differentiation rules.
+	template <class T>
+	class _adjoint
+	{
+	public:
+		_adjoint(_adjoints& adjoints, const _node_base* node)
+			: m_adjoints(adjoints), m_node(node)
+		{
+		}
+
+		void add(const T& value) const
+		{
+			m_adjoints.add<T>(m_node, value);
+		}
+
+	private:
+		_adjoints& m_adjoints;
+		const _node_base* m_node;
+	};
+
+	// Propagates the adjoint g of the result of an operation to the
+	// adjoints of its operands. Rules for matrices and vectors are in
+	// matrix.h and vector.h.
+	template <class _Op, class T, class A>
+	void _backward(const _Op&, const T&, const A&, _adjoint<A>)
+	{
+		throw std::invalid_argument("Operation is not differentiable.");
+	}
+
+	template <class _Op, class T, class A, class B>
+	void _backward(const _Op&, const T&, const A&, const B&, _adjoint<A>, _adjoint<B>)
+	{
+		throw std::invalid_argument("Operation is not differentiable.");
+	}
+
+	template <class T, class A>
+	void _backward(const _transpose&, const T& g, const A&, _adjoint<A> da)
+	{
+		da.add(g.transpose());
+	}
+
+	template <class T>
+	void _backward(const _plus&, const T& g, const T&, const T&, _adjoint<T> da, _adjoint<T> db)
+	{
+		da.add(g);
+		db.add(g);
+	}
+
+	template <class T>
+	void _backward(const _minus&, const T& g, const T&, const T&, _adjoint<T> da, _adjoint<T> db)
+	{
+		T negated;
+		_apply(_multiplies(), negated, g, -1.0);
+
+		da.add(g);
+		db.add(negated);
+	}
+
+	template <class T, class A, class B>
+	typename std::enable_if<std::is_arithmetic<A>::value && std::is_arithmetic<B>::value>::type _backward(
+		const _multiplies&,
+		const T& g,
+		const A& a,
+		const B& b,
+		_adjoint<A> da,
+		_adjoint<B> db)
+	{
+		da.add(static_cast<A>(g * b));
+		db.add(static_cast<B>(g * a));
+	}
+
+	// Single operation of a compiled expression. Operands and destination
+	// are bound when the expression is compiled.
+	class _step
+	{
+	public:
+		virtual ~_step()
+		{
+		}
+
+		virtual void execute() const = 0;
+	};
+
+	template <class T, class _Op, class A>
+	class _unary_step : public _step
+	{
+	public:
+		_unary_step(const A* arg, T* dest)
+			: m_arg(arg), m_dest(dest)
+		{
+		}
+
+		void execute() const override
+		{
+			_apply(_Op(), *m_dest, *m_arg);
+		}
+
+	private:
+		const A* m_arg;
+		T* m_dest;
+	};
+
+	template <class T, class _Op, class A, class B>
+	class _binary_step : public _step
+	{
+	public:
+		_binary_step(const A* left, const B* right, T* dest)
+			: m_left(left), m_right(right), m_dest(dest)
+		{
+		}
+
+		void execute() const override
+		{
+			_apply(_Op(), *m_dest, *m_left, *m_right);
+		}
+
+	private:
+		const A* m_left;
+		const B* m_right;
+		T* m_dest;
+	};
+
+	template <class T, class A, class B>
+	class _scaled_product_step : public _step
+	{
+	public:
+		_scaled_product_step(const A* left, const B* right, const double alpha, T* dest)
+			: m_left(left), m_right(right), m_alpha(alpha), m_dest(dest)
+		{
+		}
+
+		void execute() const override
+		{
+			_apply(_multiplies(), *m_dest, *m_left, *m_right, m_alpha);
+		}
+
+	private:
+		const A* m_left;
+		const B* m_right;
+		double m_alpha;
+		T* m_dest;
+	};
+
+	template <class T>
+	class _function_step : public _step
+	{
+	public:
+		typedef typename std::function<T()> evaluator;
+
+		_function_step(const evaluator* func, T* dest)
+			: m_evaluator(func), m_dest(dest)
+		{
+		}
+
+		void execute() const override
+		{
+			*m_dest = (*m_evaluator)();
+		}
+
+	private:
+		const evaluator* m_evaluator;
+		T* m_dest;
+	};
+
+	struct _chain_factor;
+
+	// Decides if a product operand is kept as a single factor of a matrix
+	// chain instead of being flattened into it, given the operand and the
+	// number of its owners. Products with more than one parent are kept,
+	// so their value is computed once and shared.
+	typedef std::function<bool(const _node_base*, long)> _sharing;
+
+	// Outside of compile() the owners of a node are its only known parents.
+	inline bool _shared(const _node_base*, const long owners)
+	{
+		return 1 < owners;
+	}
+
+	template <class T>
+	class _node;
+
+	template <class T>
+	class _constant_node;
+
+	template <class T>
+	class _chain_node;
+
+	// Describes values which may be factors of a matrix chain. matrix.h
+	// and vector.h specialize it for matrices and column vectors.
+	template <class T>
+	struct _chain_traits
+	{
+		static const bool chainable = false;
+	};
+
+	// Rewrites an expression graph bottom up. Every node is rewritten
+	// once, so subexpressions shared in the input stay shared.
+	class _rewriter
+	{
+	public:
+		template <class T>
+		std::shared_ptr<_node<T>> simplify(const std::shared_ptr<_node<T>>& node)
+		{
+			auto found = m_rewritten.find(node.get());
+			if (m_rewritten.end() != found)
+				return std::static_pointer_cast<_node<T>>(found->second);
+
+			std::shared_ptr<_node<T>> result = node->_Simplify(node, *this);
+
+			// Subtrees depending only on constants are computed once here.
+			if (0 < result->arity() && result->_IsConstant())
+			{
+				result = _make_node<_constant_node<T>>(result->evaluate());
+			}
+
+			m_rewritten[node.get()] = result;
+			return result;
+		}
+
+	private:
+		std::unordered_map<const _node_base*, std::shared_ptr<_node_base>> m_rewritten;
+	};
+
+	template <class T>
+	std::shared_ptr<_node<T>> _scale(const std::shared_ptr<_node<T>>& node, const double alpha);
+
+	// Base class of expression graph nodes.
+	//
+	// Every node carries a version which changes whenever its value may
+	// have changed. Variables bump their version on every write, cached
+	// nodes use the sum of versions of their inputs, which grows as soon
+	// as any input below them changes.
+	//
+	// Cached values live in the nodes, so a graph, and any graph sharing
+	// nodes with it, is evaluated by one thread at a time. Compiled and
+	// asynchronous evaluations keep their results out of the nodes.
+	class _node_base
+	{
+	public:
+		_node_base()
+			: m_version(0), m_hits(0), m_misses(0)
+		{
+		}
+
+		virtual ~_node_base()
+		{
+		}
+
+		size_t version() const
+		{
+			return m_version;
+		}
+
+		size_t hits() const
+		{
+			return m_hits;
+		}
+
+		size_t misses() const
+		{
+			return m_misses;
+		}
+
+		void reset_statistics() const
+		{
+			m_hits = 0;
+			m_misses = 0;
+		}
+
+		virtual size_t arity() const
+		{
+			return 0;
+		}
+
+		virtual const _node_base* child(const size_t) const
+		{
+			return nullptr;
+		}
+
+		// Type of the value produced by the node.
+		virtual std::type_index _ValueType() const = 0;
+
+		virtual std::unique_ptr<_buffer_base> _MakeBuffer() const = 0;
+
+		// Leaves with persistent storage return its address, so compiled
+		// expressions read them in place.
+		virtual const void* _Storage() const
+		{
+			return nullptr;
+		}
+
+		// Compares nodes of the same type and with the same inputs for
+		// common subexpression elimination. Leaves are only equivalent
+		// to themselves unless they override this.
+		virtual bool _Equals(const _node_base& other) const
+		{
+			return 0 < this->arity() || this == std::addressof(other);
+		}
+
+		// Checks if the value of the node never changes. Operation nodes
+		// are constant if all their inputs are.
+		virtual bool _IsConstant() const
+		{
+			if (0 == this->arity())
+				return false;
+
+			for (size_t i = 0; i < this->arity(); ++i)
+			{
+				if (false == this->child(i)->_IsConstant())
+					return false;
+			}
+
+			return true;
+		}
+
+		// Checks if the node is a constant multiplicative identity.
+		virtual bool _IsIdentity() const
+		{
+			return false;
+		}
+
+		// Products of matrices and vectors append their factors and
+		// multiply alpha by their constant factor. Other nodes return
+		// false and are used as a single factor.
+		virtual bool _Factors(std::vector<_chain_factor>&, double&, const _sharing&) const
+		{
+			return false;
+		}
+
+		// Returns the product of three or more matrices and vectors as a
+		// single chain node, nullptr for other nodes.
+		virtual std::shared_ptr<_node_base> _Chain(const _sharing&) const
+		{
+			return nullptr;
+		}
+
+		// Chain nodes return the product they were flattened from, which
+		// compile() lowers instead, so products shared by several chains
+		// are computed once.
+		virtual std::shared_ptr<_node_base> _Source() const
+		{
+			return nullptr;
+		}
+
+		// Creates the step computing the node from inputs into output.
+		virtual std::unique_ptr<_step> _Emit(const std::vector<const void*>&, void*) const
+		{
+			return nullptr;
+		}
+
+		// Propagates the adjoint of the node to the adjoints of its
+		// inputs. Leaves have no inputs.
+		virtual void _Backward(_adjoints&) const
+		{
+		}
+
+		// Calls func once for every node of the graph rooted at root.
+		template <class _Func>
+		static void walk(const _node_base* root, _Func func)
+		{
+			std::unordered_set<const _node_base*> visited;
+			std::vector<const _node_base*> pending(1, root);
+
+			while (false == pending.empty())
+			{
+				const _node_base* node = pending.back();
+				pending.pop_back();
+
+				if (false == visited.insert(node).second)
+					continue;
+
+				func(node);
+
+				for (size_t i = 0; i < node->arity(); ++i)
+				{
+					pending.push_back(node->child(i));
+				}
+			}
+		}
+
+		// Returns the nodes of the graph rooted at root, every node after
+		// all nodes it reads.
+		static std::vector<const _node_base*> topological(const _node_base* root)
+		{
+			std::vector<const _node_base*> order;
+			std::unordered_set<const _node_base*> visited;
+			std::vector<std::pair<const _node_base*, size_t>> pending(1, std::make_pair(root, size_t(0)));
+
+			visited.insert(root);
+			while (false == pending.empty())
+			{
+				std::pair<const _node_base*, size_t>& top = pending.back();
+
+				if (top.second == top.first->arity())
+				{
+					order.push_back(top.first);
+					pending.pop_back();
+					continue;
+				}
+
+				const _node_base* child = top.first->child(top.second++);
+				if (visited.insert(child).second)
+				{
+					pending.push_back(std::make_pair(child, size_t(0)));
+				}
+			}
+
+			return order;
+		}
+
+	protected:
+		mutable size_t m_version;
+		mutable size_t m_hits;
+		mutable size_t m_misses;
+	};
+
+	template <class T>
+	class _node : public _node_base
+	{
+	public:
+		typedef T value_type;
+
+		// Returns the current value of the node. The reference stays
+		// valid until the node is evaluated again.
+		const value_type& evaluate() const
+		{
+			size_t version;
+			return this->_Update(version);
+		}
+
+		// Computes the value of the node into dest. Operation nodes write
+		// their result directly into dest, without an intermediate copy.
+		// dest must not be the value of a variable the node reads.
+		void evaluate_into(value_type& dest) const
+		{
+			this->_Into(dest);
+		}
+
+		// Brings the node and all nodes below it up to date, returns its
+		// value and sets version to its version. Operation nodes call
+		// their inputs through their static types, so evaluation takes
+		// a single virtual call per node.
+		virtual const value_type& _Update(size_t& version) const = 0;
+
+		// Returns the value computed by the last evaluation.
+		virtual const value_type& _Current() const = 0;
+
+		// Brings the inputs of the node up to date and writes the value
+		// of the node into dest.
+		virtual void _Into(value_type& dest) const
+		{
+			size_t version;
+			dest = this->_Update(version);
+		}
+
+		std::type_index _ValueType() const override
+		{
+			return std::type_index(typeid(T));
+		}
+
+		std::unique_ptr<_buffer_base> _MakeBuffer() const override
+		{
+			return std::unique_ptr<_buffer_base>(new _buffer<T>());
+		}
+
+		// Returns the simplified form of the node, self if there is none.
+		virtual std::shared_ptr<_node<T>> _Simplify(const std::shared_ptr<_node<T>>& self, _rewriter&) const
+		{
+			return self;
+		}
+
+		// Returns a node computing alpha times the value of this node
+		// without an extra scaling step, or nullptr if there is none.
+		virtual std::shared_ptr<_node<T>> _Absorb(const double) const
+		{
+			return nullptr;
+		}
+
+		// If the node scales another node by a constant factor, multiplies
+		// alpha by the factor and returns the scaled node.
+		virtual std::shared_ptr<_node<T>> _Unscale(double&) const
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<_node_base> _Chain(const _sharing& shared) const override
+		{
+			return _Chain(shared, std::integral_constant<bool, _chain_traits<T>::chainable>());
+		}
+
+	private:
+		std::shared_ptr<_node_base> _Chain(const _sharing& shared, std::true_type) const
+		{
+			std::vector<_chain_factor> factors;
+			double alpha = 1.0;
+
+			if (false == this->_Factors(factors, alpha, shared) || factors.size() < 3)
+				return nullptr;
+
+			return _make_node<_chain_node<T>>(factors, alpha);
+		}
+
+		std::shared_ptr<_node_base> _Chain(const _sharing&, std::false_type) const
+		{
+			return nullptr;
+		}
+	};
+
+	// Factor of a matrix chain: a node of a chainable type with its shape
+	// and type specific operations.
+	struct _chain_factor
+	{
+		std::shared_ptr<_node_base> node;
+		size_t rows;
+		size_t columns;
+
+		// Evaluates the node, returns the address of its value and sets
+		// version to its version.
+		const void* (*evaluate)(const _node_base&, size_t&);
+
+		// Returns the address of the current value of the node.
+		const void* (*value)(const _node_base&);
+
+		// Returns the row-major storage of a value of the factor type,
+		// nullptr for a zero value without storage.
+		const double* (*data)(const void*);
+
+		// Adds alpha times a row-major buffer to the adjoint of the node.
+		void (*add)(_adjoints&, const _node_base&, const double*, double);
+
+		// Simplifies the node and appends the result to factors.
+		void (*simplify)(const std::shared_ptr<_node_base>&, _rewriter&, std::vector<_chain_factor>&, double&);
+
+		template <class X>
+		static _chain_factor make(const std::shared_ptr<_node<X>>& node)
+		{
+			_chain_factor factor = {
+				node,
+				_chain_traits<X>::rows,
+				_chain_traits<X>::columns,
+				&_chain_factor::_Evaluate<X>,
+				&_chain_factor::_Value<X>,
+				&_chain_factor::_Data<X>,
+				&_chain_factor::_Add<X>,
+				&_chain_factor::_Simplify<X> };
+
+			return factor;
+		}
+
+		template <class X>
+		static void collect(const std::shared_ptr<_node<X>>& node, std::vector<_chain_factor>& factors, double& alpha, const _sharing& shared)
+		{
+			if (shared(node.get(), node.use_count()) || false == node->_Factors(factors, alpha, shared))
+			{
+				factors.push_back(make<X>(node));
+			}
+		}
+
+	private:
+		template <class X>
+		static const void* _Evaluate(const _node_base& node, size_t& version)
+		{
+			return std::addressof(static_cast<const _node<X>&>(node)._Update(version));
+		}
+
+		template <class X>
+		static const void* _Value(const _node_base& node)
+		{
+			return std::addressof(static_cast<const _node<X>&>(node)._Current());
+		}
+
+		template <class X>
+		static const double* _Data(const void* value)
+		{
+			return _chain_traits<X>::data(*static_cast<const X*>(value));
+		}
+
+		template <class X>
+		static void _Add(_adjoints& adjoints, const _node_base& node, const double* src, const double alpha)
+		{
+			X value;
+			_chain_traits<X>::write(src, alpha, value);
+			adjoints.add<X>(std::addressof(node), value);
+		}
+
+		template <class X>
+		static void _Simplify(const std::shared_ptr<_node_base>& node, _rewriter& rewriter, std::vector<_chain_factor>& factors, double& alpha)
+		{
+			std::shared_ptr<_node<X>> simplified = rewriter.simplify(std::static_pointer_cast<_node<X>>(node));
+
+			std::shared_ptr<_node<X>> unscaled = simplified->_Unscale(alpha);
+			collect<X>((nullptr != unscaled) ? unscaled : simplified, factors, alpha, &_shared);
+		}
+	};
+
+	template <class T>
+	class _variable_node : public _node<T>
+	{
+	public:
+		_variable_node()
+			: m_value(), m_constant(false)
+		{
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			version = this->m_version;
+			return m_value;
+		}
+
+		const T& _Current() const override
+		{
+			return m_value;
+		}
+
+		const T& value() const
+		{
+			return m_value;
+		}
+
+		const void* _Storage() const override
+		{
+			return std::addressof(m_value);
+		}
+
+		// Non-const access marks the variable as changed.
+		T& value()
+		{
+			++this->m_version;
+			return m_value;
+		}
+
+		bool _IsConstant() const override
+		{
+			return m_constant;
+		}
+
+		bool _IsIdentity() const override
+		{
+			return m_constant && _is_identity(_multiplies(), m_value);
+		}
+
+		void set_constant(const bool constant)
+		{
+			m_constant = constant;
+		}
+
+	private:
+		T m_value;
+		bool m_constant;
+	};
+
+	template <class T>
+	class _constant_node : public _node<T>
+	{
+	public:
+		explicit _constant_node(const T& value)
+			: m_value(value)
+		{
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			version = this->m_version;
+			return m_value;
+		}
+
+		const T& _Current() const override
+		{
+			return m_value;
+		}
+
+		const void* _Storage() const override
+		{
+			return std::addressof(m_value);
+		}
+
+		// Arithmetic constants with equal values are interchangeable.
+		bool _Equals(const _node_base& other) const override
+		{
+			return _Equals(other, std::is_arithmetic<T>());
+		}
+
+		bool _IsConstant() const override
+		{
+			return true;
+		}
+
+		bool _IsIdentity() const override
+		{
+			return _is_identity(_multiplies(), m_value);
+		}
+
+	private:
+		bool _Equals(const _node_base& other, std::true_type) const
+		{
+			return m_value == static_cast<const _constant_node<T>&>(other).m_value;
+		}
+
+		bool _Equals(const _node_base& other, std::false_type) const
+		{
+			return this == std::addressof(other);
+		}
+
+	private:
+		T m_value;
+	};
+
+	// Node wrapping a user supplied evaluator. Its inputs are unknown,
+	// so it is recomputed on every evaluation and always reports a new
+	// version to its consumers.
+	template <class T>
+	class _function_node : public _node<T>
+	{
+	public:
+		typedef typename std::function<T()> evaluator;
+
+		explicit _function_node(const evaluator& func)
+			: m_evaluator(func), m_value()
+		{
+		}
+
+		const T& _Current() const override
+		{
+			return m_value;
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			m_value = m_evaluator();
+			++this->m_misses;
+
+			version = ++this->m_version;
+			return m_value;
+		}
+
+		// The inputs of the evaluator are unknown, so no gradient can
+		// flow through it.
+		void _Backward(_adjoints& adjoints) const override
+		{
+			if (nullptr != adjoints.find<T>(this))
+				throw std::invalid_argument("Function expressions are not differentiable.");
+		}
+
+		std::unique_ptr<_step> _Emit(const std::vector<const void*>&, void* output) const override
+		{
+			return std::unique_ptr<_step>(new _function_step<T>(
+				std::addressof(m_evaluator), static_cast<T*>(output)));
+		}
+
+	private:
+		evaluator m_evaluator;
+		mutable T m_value;
+	};
+
+	// Node computing its value from its inputs. The value is kept and
+	// only recomputed after the version of an input changed. Derived
+	// nodes evaluate their inputs, which also yields the sum of their
+	// versions, and pass the computation to _Cached() or _CachedInto().
+	template <class T>
+	class _cached_node : public _node<T>
+	{
+	public:
+		const T& _Current() const override
+		{
+			return m_value;
+		}
+
+	protected:
+		_cached_node()
+			: m_value(), m_valid(false)
+		{
+		}
+
+		// Returns the cached value, computed into it by compute unless it
+		// was computed from inputs of the same version.
+		template <class _Func>
+		const T& _Cached(const size_t version, _Func compute) const
+		{
+			if (m_valid && version == this->m_version)
+			{
+				++this->m_hits;
+			}
+			else
+			{
+				compute(m_value);
+				m_valid = true;
+				this->m_version = version;
+				++this->m_misses;
+			}
+
+			return m_value;
+		}
+
+		// An up to date cached value is copied, otherwise the value is
+		// computed into dest and the cache is left as it is.
+		template <class _Func>
+		void _CachedInto(T& dest, const size_t version, _Func compute) const
+		{
+			if (m_valid && version == this->m_version)
+			{
+				dest = m_value;
+				++this->m_hits;
+			}
+			else
+			{
+				compute(dest);
+				++this->m_misses;
+			}
+		}
+
+	private:
+		mutable T m_value;
+		mutable bool m_valid;
+	};
+
+	template <class T, class _Op, class A>
+	class _unary_node : public _cached_node<T>
+	{
+	public:
+		typedef _unary_node<T, _Op, A> _Self;
+
+		explicit _unary_node(const std::shared_ptr<_node<A>>& arg)
+			: m_arg(arg)
+		{
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			const A& arg = m_arg->_Update(version);
+			return this->_Cached(version, [&arg](T& dest) { _apply(_Op(), dest, arg); });
+		}
+
+		void _Into(T& dest) const override
+		{
+			size_t version;
+			const A& arg = m_arg->_Update(version);
+
+			this->_CachedInto(dest, version, [&arg](T& value) { _apply(_Op(), value, arg); });
+		}
+
+		size_t arity() const override
+		{
+			return 1;
+		}
+
+		const _node_base* child(const size_t) const override
+		{
+			return m_arg.get();
+		}
+
+		void _Backward(_adjoints& adjoints) const override
+		{
+			const T* adjoint = adjoints.find<T>(this);
+			if (nullptr != adjoint)
+			{
+				_backward(_Op(), *adjoint, m_arg->_Current(), _adjoint<A>(adjoints, m_arg.get()));
+			}
+		}
+
+		std::unique_ptr<_step> _Emit(const std::vector<const void*>& inputs, void* output) const override
+		{
+			return std::unique_ptr<_step>(new _unary_step<T, _Op, A>(
+				static_cast<const A*>(inputs[0]), static_cast<T*>(output)));
+		}
+
+		std::shared_ptr<_node<T>> _Simplify(const std::shared_ptr<_node<T>>& self, _rewriter& rewriter) const override
+		{
+			return _Rewrite(_Op(), self, rewriter.simplify(m_arg));
+		}
+
+		const std::shared_ptr<_node<A>>& arg() const
+		{
+			return m_arg;
+		}
+
+	private:
+		template <class _Other>
+		std::shared_ptr<_node<T>> _Rewrite(const _Other&, const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& arg) const
+		{
+			if (arg == m_arg)
+				return self;
+
+			return _make_node<_Self>(arg);
+		}
+
+		// transpose(transpose(e)) is e.
+		std::shared_ptr<_node<T>> _Rewrite(const _transpose& op, const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& arg) const
+		{
+			auto inner = dynamic_cast<const _unary_node<A, _transpose, T>*>(arg.get());
+			if (nullptr != inner)
+				return inner->arg();
+
+			return _Rewrite<_Op>(op, self, arg);
+		}
+
+	private:
+		std::shared_ptr<_node<A>> m_arg;
+	};
+
+	template <class T, class _Op, class A, class B>
+	class _binary_node : public _cached_node<T>
+	{
+	public:
+		typedef _binary_node<T, _Op, A, B> _Self;
+
+		_binary_node(const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right)
+			: m_left(left), m_right(right)
+		{
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			size_t left, right;
+			const A& a = m_left->_Update(left);
+			const B& b = m_right->_Update(right);
+
+			version = left + right;
+			return this->_Cached(version, [&a, &b](T& dest) { _apply(_Op(), dest, a, b); });
+		}
+
+		void _Into(T& dest) const override
+		{
+			size_t left, right;
+			const A& a = m_left->_Update(left);
+			const B& b = m_right->_Update(right);
+
+			this->_CachedInto(dest, left + right, [&a, &b](T& value) { _apply(_Op(), value, a, b); });
+		}
+
+		size_t arity() const override
+		{
+			return 2;
+		}
+
+		const _node_base* child(const size_t index) const override
+		{
+			return (0 == index) ? static_cast<const _node_base*>(m_left.get()) : m_right.get();
+		}
+
+		void _Backward(_adjoints& adjoints) const override
+		{
+			const T* adjoint = adjoints.find<T>(this);
+			if (nullptr != adjoint)
+			{
+				_backward(_Op(), *adjoint, m_left->_Current(), m_right->_Current(),
+					_adjoint<A>(adjoints, m_left.get()), _adjoint<B>(adjoints, m_right.get()));
+			}
+		}
+
+		std::unique_ptr<_step> _Emit(const std::vector<const void*>& inputs, void* output) const override
+		{
+			return std::unique_ptr<_step>(new _binary_step<T, _Op, A, B>(
+				static_cast<const A*>(inputs[0]), static_cast<const B*>(inputs[1]), static_cast<T*>(output)));
+		}
+
+		std::shared_ptr<_node<T>> _Simplify(const std::shared_ptr<_node<T>>& self, _rewriter& rewriter) const override
+		{
+			return _Rewrite(_Op(), self, rewriter.simplify(m_left), rewriter.simplify(m_right));
+		}
+
+		std::shared_ptr<_node<T>> _Absorb(const double alpha) const override
+		{
+			return _Absorb(alpha, _Op(), _Kind());
+		}
+
+		std::shared_ptr<_node<T>> _Unscale(double& alpha) const override
+		{
+			return _Unscale(alpha, _Op(), _Kind());
+		}
+
+		bool _Factors(std::vector<_chain_factor>& factors, double& alpha, const _sharing& shared) const override
+		{
+			return _Factors(factors, alpha, shared, std::integral_constant<bool,
+				std::is_same<_Op, _multiplies>::value &&
+				_chain_traits<T>::chainable &&
+				_chain_traits<A>::chainable &&
+				_chain_traits<B>::chainable>());
+		}
+
+		const std::shared_ptr<_node<A>>& left() const
+		{
+			return m_left;
+		}
+
+		const std::shared_ptr<_node<B>>& right() const
+		{
+			return m_right;
+		}
+
+	private:
+		bool _Factors(std::vector<_chain_factor>& factors, double& alpha, const _sharing& shared, std::true_type) const
+		{
+			_chain_factor::collect(m_left, factors, alpha, shared);
+			_chain_factor::collect(m_right, factors, alpha, shared);
+
+			return true;
+		}
+
+		bool _Factors(std::vector<_chain_factor>&, double&, const _sharing&, std::false_type) const
+		{
+			return false;
+		}
+
+		// Shape of a multiplication: a value scaled by a double on the
+		// right (1) or on the left (2), a product of two non scalar values
+		// (3) or anything else (0). Integral results are never rewritten
+		// since scaling them truncates at every step.
+		typedef std::integral_constant<int,
+			std::is_integral<T>::value ? 0 :
+			(std::is_same<A, T>::value && std::is_same<B, double>::value) ? 1 :
+			(std::is_same<A, double>::value && std::is_same<B, T>::value) ? 2 :
+			(std::is_same<A, double>::value || std::is_same<B, double>::value) ? 0 : 3> _Kind;
+
+		std::shared_ptr<_node<T>> _Rebuild(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right) const
+		{
+			if (left == m_left && right == m_right)
+				return self;
+
+			return _make_node<_Self>(left, right);
+		}
+
+		template <class _Other>
+		std::shared_ptr<_node<T>> _Rewrite(const _Other&, const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right) const
+		{
+			return _Rebuild(self, left, right);
+		}
+
+		std::shared_ptr<_node<T>> _Rewrite(const _multiplies&, const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right) const
+		{
+			return _Multiply(self, left, right, _Kind());
+		}
+
+		std::shared_ptr<_node<T>> _Multiply(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, std::integral_constant<int, 0>) const
+		{
+			return _Rebuild(self, left, right);
+		}
+
+		// e * C folds C into e or into the constant factor of e.
+		std::shared_ptr<_node<T>> _Multiply(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, std::integral_constant<int, 1>) const
+		{
+			if (right->_IsConstant())
+				return _scale<T>(left, right->evaluate());
+
+			return _MultiplyConstantLeft(self, left, right, std::is_same<A, double>());
+		}
+
+		// For scalar expressions the constant may also be on the left.
+		std::shared_ptr<_node<T>> _MultiplyConstantLeft(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, std::true_type) const
+		{
+			if (left->_IsConstant())
+				return _scale<T>(_Cast<T>(right), left->evaluate());
+
+			return _Rebuild(self, left, right);
+		}
+
+		std::shared_ptr<_node<T>> _MultiplyConstantLeft(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, std::false_type) const
+		{
+			return _Rebuild(self, left, right);
+		}
+
+		// C * e folds C into e or into the constant factor of e.
+		std::shared_ptr<_node<T>> _Multiply(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, std::integral_constant<int, 2>) const
+		{
+			if (left->_IsConstant())
+				return _scale<T>(right, left->evaluate());
+
+			return _Rebuild(self, left, right);
+		}
+
+		// Constant factors of both operands move to the product, where
+		// they scale the result while it is computed. Identity operands
+		// are dropped.
+		std::shared_ptr<_node<T>> _Multiply(const std::shared_ptr<_node<T>>& self, const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, std::integral_constant<int, 3>) const
+		{
+			double alpha = 1.0;
+
+			std::shared_ptr<_node<A>> a = left->_Unscale(alpha);
+			if (nullptr == a)
+				a = left;
+
+			std::shared_ptr<_node<B>> b = right->_Unscale(alpha);
+			if (nullptr == b)
+				b = right;
+
+			if (std::is_same<B, T>::value && a->_IsIdentity())
+				return _scale<T>(_Cast<T>(b), alpha);
+
+			if (std::is_same<A, T>::value && b->_IsIdentity())
+				return _scale<T>(_Cast<T>(a), alpha);
+
+			if (1.0 != alpha)
+				return _Scaled(a, b, alpha);
+
+			return _Rebuild(self, a, b);
+		}
+
+		template <class _Other, class _Any>
+		std::shared_ptr<_node<T>> _Absorb(const double, const _Other&, _Any) const
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<_node<T>> _Absorb(const double alpha, const _multiplies&, std::integral_constant<int, 1>) const
+		{
+			if (m_right->_IsConstant())
+				return _scale<T>(m_left, alpha * m_right->evaluate());
+
+			return nullptr;
+		}
+
+		std::shared_ptr<_node<T>> _Absorb(const double alpha, const _multiplies&, std::integral_constant<int, 2>) const
+		{
+			if (m_left->_IsConstant())
+				return _scale<T>(m_right, alpha * m_left->evaluate());
+
+			return nullptr;
+		}
+
+		std::shared_ptr<_node<T>> _Absorb(const double alpha, const _multiplies&, std::integral_constant<int, 3>) const
+		{
+			return _Scaled(m_left, m_right, alpha);
+		}
+
+		template <class _Other, class _Any>
+		std::shared_ptr<_node<T>> _Unscale(double&, const _Other&, _Any) const
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<_node<T>> _Unscale(double& alpha, const _multiplies&, std::integral_constant<int, 1>) const
+		{
+			if (false == m_right->_IsConstant())
+				return nullptr;
+
+			alpha *= m_right->evaluate();
+			return m_left;
+		}
+
+		std::shared_ptr<_node<T>> _Unscale(double& alpha, const _multiplies&, std::integral_constant<int, 2>) const
+		{
+			if (false == m_left->_IsConstant())
+				return nullptr;
+
+			alpha *= m_left->evaluate();
+			return m_right;
+		}
+
+		static std::shared_ptr<_node<T>> _Scaled(const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, const double alpha);
+
+		// Casts between node pointers of types known to be the same
+		// in the branch where the cast is used.
+		template <class _To, class _From>
+		static std::shared_ptr<_node<_To>> _Cast(const std::shared_ptr<_node<_From>>& node)
+		{
+			return std::static_pointer_cast<_node<_To>>(std::static_pointer_cast<_node_base>(node));
+		}
+
+	private:
+		std::shared_ptr<_node<A>> m_left;
+		std::shared_ptr<_node<B>> m_right;
+	};
+
+	// Product of two values scaled by a constant, alpha * (a * b).
+	// Created by simplify() to avoid a separate scaling pass.
+	template <class T, class A, class B>
+	class _scaled_product_node : public _cached_node<T>
+	{
+	public:
+		typedef _scaled_product_node<T, A, B> _Self;
+
+		_scaled_product_node(const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, const double alpha)
+			: m_left(left), m_right(right), m_alpha(alpha)
+		{
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			size_t left, right;
+			const A& a = m_left->_Update(left);
+			const B& b = m_right->_Update(right);
+
+			version = left + right;
+			return this->_Cached(version, [this, &a, &b](T& dest) { _apply(_multiplies(), dest, a, b, m_alpha); });
+		}
+
+		void _Into(T& dest) const override
+		{
+			size_t left, right;
+			const A& a = m_left->_Update(left);
+			const B& b = m_right->_Update(right);
+
+			this->_CachedInto(dest, left + right, [this, &a, &b](T& value) { _apply(_multiplies(), value, a, b, m_alpha); });
+		}
+
+		size_t arity() const override
+		{
+			return 2;
+		}
+
+		const _node_base* child(const size_t index) const override
+		{
+			return (0 == index) ? static_cast<const _node_base*>(m_left.get()) : m_right.get();
+		}
+
+		bool _Equals(const _node_base& other) const override
+		{
+			return m_alpha == static_cast<const _Self&>(other).m_alpha;
+		}
+
+		void _Backward(_adjoints& adjoints) const override
+		{
+			const T* adjoint = adjoints.find<T>(this);
+			if (nullptr != adjoint)
+			{
+				T scaled;
+				_apply(_multiplies(), scaled, *adjoint, m_alpha);
+
+				_backward(_multiplies(), scaled, m_left->_Current(), m_right->_Current(),
+					_adjoint<A>(adjoints, m_left.get()), _adjoint<B>(adjoints, m_right.get()));
+			}
+		}
+
+		std::unique_ptr<_step> _Emit(const std::vector<const void*>& inputs, void* output) const override
+		{
+			return std::unique_ptr<_step>(new _scaled_product_step<T, A, B>(
+				static_cast<const A*>(inputs[0]), static_cast<const B*>(inputs[1]), m_alpha, static_cast<T*>(output)));
+		}
+
+		std::shared_ptr<_node<T>> _Simplify(const std::shared_ptr<_node<T>>& self, _rewriter& rewriter) const override
+		{
+			auto left = rewriter.simplify(m_left);
+			auto right = rewriter.simplify(m_right);
+
+			if (left == m_left && right == m_right)
+				return self;
+
+			return _make_node<_Self>(left, right, m_alpha);
+		}
+
+		std::shared_ptr<_node<T>> _Absorb(const double alpha) const override
+		{
+			return _make_node<_Self>(m_left, m_right, alpha * m_alpha);
+		}
+
+		std::shared_ptr<_node<T>> _Unscale(double& alpha) const override
+		{
+			alpha *= m_alpha;
+			return _make_node<_binary_node<T, _multiplies, A, B>>(m_left, m_right);
+		}
+
+		bool _Factors(std::vector<_chain_factor>& factors, double& alpha, const _sharing& shared) const override
+		{
+			return _Factors(factors, alpha, shared, std::integral_constant<bool,
+				_chain_traits<T>::chainable &&
+				_chain_traits<A>::chainable &&
+				_chain_traits<B>::chainable>());
+		}
+
+		double alpha() const
+		{
+			return m_alpha;
+		}
+
+	private:
+		bool _Factors(std::vector<_chain_factor>& factors, double& alpha, const _sharing& shared, std::true_type) const
+		{
+			_chain_factor::collect(m_left, factors, alpha, shared);
+			_chain_factor::collect(m_right, factors, alpha, shared);
+			alpha *= m_alpha;
+
+			return true;
+		}
+
+		bool _Factors(std::vector<_chain_factor>&, double&, const _sharing&, std::false_type) const
+		{
+			return false;
+		}
+
+	private:
+		std::shared_ptr<_node<A>> m_left;
+		std::shared_ptr<_node<B>> m_right;
+		double m_alpha;
+	};
+
+	template <class T>
+	class _chain_node;
+
+	// Intermediate products of a chain and the addresses of the operands
+	// of its multiplications, the factors followed by the products.
+	struct _chain_buffers
+	{
+		std::vector<std::vector<double>> products;
+		std::vector<const double*> operands;
+	};
+
+	// Step computing a chain. Every step has buffers of its own, so steps
+	// of one chain node may run concurrently.
+	template <class T>
+	class _chain_step : public _step
+	{
+	public:
+		_chain_step(const _chain_node<T>* node, const std::vector<const void*>& inputs, T* dest)
+			: m_node(node), m_inputs(inputs), m_dest(dest), m_buffers(node->buffers())
+		{
+		}
+
+		void execute() const override
+		{
+			m_node->compute(m_inputs, *m_dest, m_buffers);
+		}
+
+	private:
+		const _chain_node<T>* m_node;
+		std::vector<const void*> m_inputs;
+		T* m_dest;
+		mutable _chain_buffers m_buffers;
+	};
+
+	// Product of a chain of matrices, optionally ending with a vector,
+	// scaled by a constant. The multiplication order is chosen once when
+	// the node is created, using the same cost model as the compile time
+	// planner of multiply() in matrix.h: multiplying an A x B matrix by
+	// a B x C matrix costs A * B * C. Factors are read in place and the
+	// last product is written directly into the result. Intermediate
+	// products are kept in buffers owned by the node, or by the step of
+	// a compiled chain, so evaluation does not allocate.
+	//
+	// Chains built by multiplying expressions keep the product as it was
+	// written. compile() lowers that product instead of the chain, so it
+	// can share common subproducts between chains and flatten the rest.
+	template <class T>
+	class _chain_node : public _cached_node<T>
+	{
+	public:
+		typedef _chain_node<T> _Self;
+
+		_chain_node(const std::vector<_chain_factor>& factors, const double alpha, const std::shared_ptr<_node<T>>& source = nullptr)
+			: m_factors(factors), m_alpha(alpha), m_source(source), m_cost(0), m_inputs(factors.size(), nullptr)
+		{
+			_Plan();
+		}
+
+		// Computes the product of the factor values at inputs into dest,
+		// with intermediate products in buffers laid out as buffers().
+		void compute(const std::vector<const void*>& inputs, T& dest, _chain_buffers& buffers) const
+		{
+			double* result = _chain_traits<T>::data(dest);
+			const size_t size = _chain_traits<T>::rows * _chain_traits<T>::columns;
+
+			for (size_t i = 0; i < m_factors.size(); ++i)
+			{
+				buffers.operands[i] = m_factors[i].data(inputs[i]);
+
+				// A zero factor without storage makes the product zero.
+				if (nullptr == buffers.operands[i])
+				{
+					std::fill(result, result + size, 0.0);
+					return;
+				}
+			}
+
+			for (size_t i = 0; i < m_operations.size(); ++i)
+			{
+				const _operation& op = m_operations[i];
+				double* output = (i + 1 < m_operations.size()) ? buffers.products[i].data() : result;
+
+				_Multiply(buffers.operands[op.left], buffers.operands[op.right], output, op.rows, op.inner, op.columns);
+				buffers.operands[op.output] = output;
+			}
+
+			if (1.0 != m_alpha)
+			{
+				std::transform(result, result + size, result, [this](const double value) { return m_alpha * value; });
+			}
+		}
+
+		// Buffers used by compute(), with room for every intermediate
+		// product but the last.
+		const _chain_buffers& buffers() const
+		{
+			return m_buffers;
+		}
+
+		const T& _Update(size_t& version) const override
+		{
+			version = _Inputs();
+			return this->_Cached(version, [this](T& dest) { compute(m_inputs, dest, m_buffers); });
+		}
+
+		void _Into(T& dest) const override
+		{
+			const size_t version = _Inputs();
+			this->_CachedInto(dest, version, [this](T& value) { compute(m_inputs, value, m_buffers); });
+		}
+
+		// Number of scalar multiplications of the chosen order.
+		size_t cost() const
+		{
+			return m_cost;
+		}
+
+		size_t arity() const override
+		{
+			return m_factors.size();
+		}
+
+		const _node_base* child(const size_t index) const override
+		{
+			return m_factors[index].node.get();
+		}
+
+		bool _Equals(const _node_base& other) const override
+		{
+			return m_alpha == static_cast<const _Self&>(other).m_alpha;
+		}
+
+		std::unique_ptr<_step> _Emit(const std::vector<const void*>& inputs, void* output) const override
+		{
+			return std::unique_ptr<_step>(new _chain_step<T>(this, inputs, static_cast<T*>(output)));
+		}
+
+		// The adjoint of factor i is alpha * L' * G * R', where L and R
+		// are the products of the factors left and right of it. L' * G
+		// is built up from the left one factor at a time, the products
+		// R from the right. The first factor has no factors left of it,
+		// so its R is never needed.
+		void _Backward(_adjoints& adjoints) const override
+		{
+			const T* adjoint = adjoints.find<T>(this);
+			if (nullptr == adjoint || adjoint->empty())
+				return;
+
+			const size_t count = m_factors.size();
+			const size_t columns = m_factors.back().columns;
+			_scratch& scratch = m_scratch;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const double* value = m_factors[i].data(m_factors[i].value(*m_factors[i].node));
+				scratch.values[i] = (nullptr != value) ? value : scratch.zeros.data();
+			}
+
+			scratch.right[count - 1] = scratch.values[count - 1];
+			for (size_t i = count - 1; 1 < i--;)
+			{
+				_Multiply(scratch.values[i], scratch.right[i + 1], scratch.products[i].data(), m_factors[i].rows, m_factors[i].columns, columns);
+				scratch.right[i] = scratch.products[i].data();
+			}
+
+			const double* adjoint_data = _chain_traits<T>::data(*adjoint);
+			std::copy(adjoint_data, adjoint_data + m_factors.front().rows * columns, scratch.left.begin());
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const _chain_factor& factor = m_factors[i];
+
+				if (i + 1 < count)
+				{
+					_MultiplyTransposed(scratch.left.data(), scratch.right[i + 1], scratch.gradient.data(), factor.rows, columns, factor.columns);
+					factor.add(adjoints, *factor.node, scratch.gradient.data(), m_alpha);
+
+					_TransposedMultiply(scratch.values[i], scratch.left.data(), scratch.next.data(), factor.rows, factor.columns, columns);
+					scratch.left.swap(scratch.next);
+				}
+				else
+				{
+					factor.add(adjoints, *factor.node, scratch.left.data(), m_alpha);
+				}
+			}
+		}
+
+		bool _Factors(std::vector<_chain_factor>& factors, double& alpha, const _sharing& shared) const override
+		{
+			if (nullptr != m_source)
+				return m_source->_Factors(factors, alpha, shared);
+
+			factors.insert(factors.end(), m_factors.begin(), m_factors.end());
+			alpha *= m_alpha;
+
+			return true;
+		}
+
+		std::shared_ptr<_node_base> _Chain(const _sharing&) const override
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<_node_base> _Source() const override
+		{
+			return m_source;
+		}
+
+		std::shared_ptr<_node<T>> _Simplify(const std::shared_ptr<_node<T>>& self, _rewriter& rewriter) const override
+		{
+			std::vector<_chain_factor> factors;
+			double alpha = m_alpha;
+
+			for (const _chain_factor& factor : m_factors)
+			{
+				factor.simplify(factor.node, rewriter, factors, alpha);
+			}
+
+			bool changed = (alpha != m_alpha) || (factors.size() != m_factors.size());
+			for (size_t i = 0; false == changed && i < factors.size(); ++i)
+			{
+				changed = (factors[i].node != m_factors[i].node);
+			}
+
+			if (false == changed)
+				return self;
+
+			return _make_node<_Self>(factors, alpha);
+		}
+
+		std::shared_ptr<_node<T>> _Absorb(const double alpha) const override
+		{
+			return _make_node<_Self>(m_factors, alpha * m_alpha);
+		}
+
+		std::shared_ptr<_node<T>> _Unscale(double& alpha) const override
+		{
+			if (1.0 == m_alpha)
+				return nullptr;
+
+			alpha *= m_alpha;
+			return _make_node<_Self>(m_factors, 1.0);
+		}
+
+	private:
+		// Evaluates the factors, keeps the addresses of their values and
+		// returns the sum of their versions.
+		size_t _Inputs() const
+		{
+			size_t version = 0;
+			for (size_t i = 0; i < m_factors.size(); ++i)
+			{
+				size_t factor;
+				m_inputs[i] = m_factors[i].evaluate(*m_factors[i].node, factor);
+				version += factor;
+			}
+
+			return version;
+		}
+
+		struct _scratch
+		{
+			std::vector<const double*> values;
+			std::vector<const double*> right;
+			std::vector<std::vector<double>> products;
+			std::vector<double> zeros;
+			std::vector<double> gradient;
+			std::vector<double> left;
+			std::vector<double> next;
+		};
+
+		struct _operation
+		{
+			size_t left;
+			size_t right;
+			size_t output;
+			size_t rows;
+			size_t inner;
+			size_t columns;
+		};
+
+		// Picks the cheapest order by dynamic programming over all
+		// subchains and lays out the resulting multiplications.
+		void _Plan()
+		{
+			const size_t count = m_factors.size();
+
+			std::vector<size_t> dims(count + 1);
+			for (size_t i = 0; i < count; ++i)
+			{
+				dims[i] = m_factors[i].rows;
+			}
+
+			dims[count] = m_factors.back().columns;
+
+			std::vector<size_t> costs(count * count, 0);
+			std::vector<size_t> splits(count * count, 0);
+
+			for (size_t length = 2; length <= count; ++length)
+			{
+				for (size_t first = 0; first + length <= count; ++first)
+				{
+					const size_t last = first + length - 1;
+					costs[first * count + last] = std::numeric_limits<size_t>::max();
+
+					for (size_t split = first; split < last; ++split)
+					{
+						const size_t cost =
+							costs[first * count + split] +
+							costs[(split + 1) * count + last] +
+							dims[first] * dims[split + 1] * dims[last + 1];
+
+						if (cost < costs[first * count + last])
+						{
+							costs[first * count + last] = cost;
+							splits[first * count + last] = split;
+						}
+					}
+				}
+			}
+
+			m_cost = costs[count - 1];
+			_Schedule(0, count - 1, dims, splits);
+
+			// The last product goes to the result.
+			m_buffers.products.back().clear();
+			m_buffers.products.back().shrink_to_fit();
+			m_buffers.operands.resize(count + m_operations.size(), nullptr);
+
+			// Scratch of the backward pass: the factors, the products of
+			// the factors right of each one but the first, and room for
+			// the largest factor and partial adjoint.
+			const size_t columns = dims[count];
+			size_t factor_size = 0;
+			size_t left_size = 0;
+
+			m_scratch.values.resize(count, nullptr);
+			m_scratch.right.resize(count, nullptr);
+			m_scratch.products.resize(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				factor_size = std::max(factor_size, dims[i] * dims[i + 1]);
+				left_size = std::max(left_size, dims[i] * columns);
+
+				if (0 < i && i + 1 < count)
+				{
+					m_scratch.products[i].resize(dims[i] * columns);
+				}
+			}
+
+			m_scratch.zeros.resize(factor_size, 0.0);
+			m_scratch.gradient.resize(factor_size);
+			m_scratch.left.resize(left_size);
+			m_scratch.next.resize(left_size);
+		}
+
+		size_t _Schedule(const size_t first, const size_t last, const std::vector<size_t>& dims, const std::vector<size_t>& splits)
+		{
+			if (first == last)
+				return first;
+
+			const size_t split = splits[first * m_factors.size() + last];
+
+			_operation op;
+			op.left = _Schedule(first, split, dims, splits);
+			op.right = _Schedule(split + 1, last, dims, splits);
+			op.output = m_factors.size() + m_operations.size();
+			op.rows = dims[first];
+			op.inner = dims[split + 1];
+			op.columns = dims[last + 1];
+
+			m_buffers.products.push_back(std::vector<double>(op.rows * op.columns));
+			m_operations.push_back(op);
+
+			return op.output;
+		}
+
+		static void _Multiply(const double* a, const double* b, double* c, const size_t rows, const size_t inner, const size_t columns)
+		{
+			std::fill(c, c + rows * columns, 0.0);
+
+			for (size_t row = 0; row < rows; ++row)
+			{
+				for (size_t i = 0; i < inner; ++i)
+				{
+					const double value = a[row * inner + i];
+
+					for (size_t col = 0; col < columns; ++col)
+					{
+						c[row * columns + col] += value * b[i * columns + col];
+					}
+				}
+			}
+		}
+
+	private:
+		// Computes c = a * b' for an a of rows x inner and a b of
+		// columns x inner.
+		static void _MultiplyTransposed(const double* a, const double* b, double* c, const size_t rows, const size_t inner, const size_t columns)
+		{
+			for (size_t row = 0; row < rows; ++row)
+			{
+				for (size_t col = 0; col < columns; ++col)
+				{
+					double cell = 0;
+					for (size_t i = 0; i < inner; ++i)
+					{
+						cell += a[row * inner + i] * b[col * inner + i];
+					}
+
+					c[row * columns + col] = cell;
+				}
+			}
+		}
+
+		// Computes c = a' * b for an a of inner x rows and a b of
+		// inner x columns.
+		static void _TransposedMultiply(const double* a, const double* b, double* c, const size_t inner, const size_t rows, const size_t columns)
+		{
+			std::fill(c, c + rows * columns, 0.0);
+
+			for (size_t i = 0; i < inner; ++i)
+			{
+				for (size_t row = 0; row < rows; ++row)
+				{
+					const double value = a[i * rows + row];
+
+					for (size_t col = 0; col < columns; ++col)
+					{
+						c[row * columns + col] += value * b[i * columns + col];
+					}
+				}
+			}
+		}
+
+	private:
+		std::vector<_chain_factor> m_factors;
+		double m_alpha;
+		std::shared_ptr<_node<T>> m_source;
+		size_t m_cost;
+		std::vector<_operation> m_operations;
+		mutable _chain_buffers m_buffers;
+		mutable std::vector<const void*> m_inputs;
+		mutable _scratch m_scratch;
+	};
+
+	template <class T, class _Op, class A, class B>
+	std::shared_ptr<_node<T>> _binary_node<T, _Op, A, B>::_Scaled(const std::shared_ptr<_node<A>>& left, const std::shared_ptr<_node<B>>& right, const double alpha)
+	{
+		return _make_node<_scaled_product_node<T, A, B>>(left, right, alpha);
+	}
+
+	// Returns a node computing alpha * node, folding alpha into the node
+	// where possible.
+	template <class T>
+	std::shared_ptr<_node<T>> _scale(const std::shared_ptr<_node<T>>& node, const double alpha)
+	{
+		if (1.0 == alpha)
+			return node;
+
+		std::shared_ptr<_node<T>> absorbed = node->_Absorb(alpha);
+		if (nullptr != absorbed)
+			return absorbed;
+
+		return _make_node<_binary_node<T, _multiplies, T, double>>(
+			node, _make_node<_constant_node<double>>(alpha));
+	}
+
+	// Shared flag stopping asynchronous evaluations. Copies of a token
+	// refer to the same flag.
+	class cancellation_token
+	{
+	public:
+		cancellation_token()
+			: m_cancelled(std::make_shared<std::atomic<bool>>(false))
+		{
+		}
+
+		void cancel() const
+		{
+			m_cancelled->store(true, std::memory_order_release);
+		}
+
+		bool is_cancelled() const
+		{
+			return m_cancelled->load(std::memory_order_acquire);
+		}
+
+	private:
+		std::shared_ptr<std::atomic<bool>> m_cancelled;
+	};
+
+	// Reported by the future of a cancelled evaluation.
+	class evaluation_cancelled : public std::runtime_error
+	{
+	public:
+		evaluation_cancelled()
+			: std::runtime_error("expression evaluation cancelled")
+		{
+		}
+	};
+
+	template <class T>
+	class _async_evaluation;
+
 	template <class T>
 	class variable
 	{
@@ -14,36 +2306,57 @@ namespace expressions
 		typedef T type;
 
 		variable(const variable<T>& other)
-			: m_pvalue(other.m_pvalue)
+			: m_node(other.m_node)
 		{}
 
 		variable()
 		{
-			m_pvalue = std::make_shared<T>();
+			m_node = _make_node<_variable_node<T>>();
 		}
 
 		const T& value() const
 		{
-			return *m_pvalue;
+			return static_cast<const _variable_node<T>&>(*m_node).value();
 		}
 
+		// Returns a writable reference and marks the variable as changed.
+		// Writes through a reference kept after the next evaluation are
+		// not tracked.
 		T& value()
 		{
-			return *m_pvalue;
+			return m_node->value();
 		}
 
 		void set(const T& value)
 		{
-			*m_pvalue = value;
+			m_node->value() = value;
 		}
 
 		void set(T&& value)
 		{
-			*m_pvalue = std::move(value);
+			m_node->value() = std::move(value);
+		}
+
+		size_t version() const
+		{
+			return m_node->version();
+		}
+
+		// Marks the variable as constant, so simplify() precomputes the
+		// subexpressions depending only on constants. The values are
+		// taken when simplify() is called.
+		void set_constant(const bool constant = true)
+		{
+			m_node->set_constant(constant);
+		}
+
+		std::shared_ptr<_node<T>> node() const
+		{
+			return m_node;
 		}
 
 	private:
-		std::shared_ptr<T> m_pvalue;
+		std::shared_ptr<_variable_node<T>> m_node;
 	};
 
 	template<class T>
@@ -56,40 +2369,705 @@ namespace expressions
 	class expression
 	{
 	public:
+		typedef T value_type;
 		typedef typename std::function<T()> evaluator;
+		typedef typename std::shared_ptr<_node<T>> node_pointer;
 
 		expression() = delete;
 
+		expression(const expression<T>& other)
+			: m_node(other.m_node)
+		{
+		}
+
+		expression(expression<T>&& other)
+			: m_node(std::move(other.m_node))
+		{
+		}
+
+		expression<T>& operator=(const expression<T>& other)
+		{
+			m_node = other.m_node;
+			return *this;
+		}
+
+		expression<T>& operator=(expression<T>&& other)
+		{
+			m_node = std::move(other.m_node);
+			return *this;
+		}
+
 		expression(const variable<T> var)
+			: m_node(var.node())
 		{
-			m_evaluator = std::make_shared<evaluator>([var]() { return var.value(); });
 		}
 
 		expression(const evaluator& func)
-			: m_evaluator(std::make_shared<evaluator>(func))
+			: m_node(_make_node<_function_node<T>>(func))
 		{
 		}
 
 		expression(evaluator&& func)
-			: m_evaluator(std::make_shared<evaluator>(func))
+			: m_node(_make_node<_function_node<T>>(func))
+		{
+		}
+
+		explicit expression(const node_pointer& node)
+			: m_node(node)
 		{
 		}
 
+		// Evaluates the expression. Only nodes depending on variables
+		// changed since the previous evaluation are recomputed. The graph,
+		// and graphs sharing nodes with it, must not be evaluated this way
+		// by several threads at once.
 		T evaluate() const
 		{
-			return (*m_evaluator)();
+			return m_node->evaluate();
+		}
+
+		// Evaluates the expression into dest. Variables are read in place
+		// and the result of the last operation is written directly into
+		// dest, so evaluating matrix expressions this way copies neither
+		// the inputs nor the result. dest must not be the value of a
+		// variable used by the expression.
+		void evaluate_into(T& dest) const
+		{
+			m_node->evaluate_into(dest);
+		}
+
+		// Evaluates the expression on a thread pool, computing independent
+		// subexpressions in parallel. The evaluation computes every node
+		// into buffers of its own and leaves the cached values alone, so
+		// it may run concurrently with other evaluations of the graph.
+		// Variables must not change until the future is ready. Function
+		// expressions are called on the workers of the pool.
+		//
+		// Sample usage:
+		//		algebra::expressions::cancellation_token token;
+		//		auto result = e.evaluate_async(algebra::default_pool(), token);
+		//		...
+		//		token.cancel();
+		//
+		std::future<T> evaluate_async(
+			thread_pool& pool = default_pool(),
+			const cancellation_token& token = cancellation_token()) const
+		{
+			return _async_evaluation<T>::start(*this, pool, token);
+		}
+
+		// Evaluates the expression on a thread pool and waits for the
+		// result. Called from a worker of the pool, the compiled
+		// expression is run on the calling thread, which would otherwise
+		// wait for tasks queued behind itself.
+		T evaluate(thread_pool& pool, const cancellation_token& token = cancellation_token()) const
+		{
+			if (pool.is_worker())
+			{
+				if (token.is_cancelled())
+					throw evaluation_cancelled();
+
+				return compile(*this).run();
+			}
+
+			return evaluate_async(pool, token).get();
+		}
+
+		const node_pointer& node() const
+		{
+			return m_node;
+		}
+
+		// Returns cache hits and misses summed over all nodes of the graph.
+		cache_statistics statistics() const
+		{
+			cache_statistics result = { 0, 0 };
+
+			_node_base::walk(m_node.get(), [&result](const _node_base* node)
+				{
+					result.hits += node->hits();
+					result.misses += node->misses();
+				});
+
+			return result;
+		}
+
+		void reset_statistics() const
+		{
+			_node_base::walk(m_node.get(), [](const _node_base* node) { node->reset_statistics(); });
+		}
+
+	private:
+		node_pointer m_node;
+	};
+
+	template <class T>
+	expression<T> constant(const T& value)
+	{
+		return expression<T>(typename expression<T>::node_pointer(
+			_make_node<_constant_node<T>>(value)));
+	}
+
+	template <class T, class _Op, class A>
+	expression<T> _unary(const expression<A>& a)
+	{
+		return expression<T>(typename expression<T>::node_pointer(
+			_make_node<_unary_node<T, _Op, A>>(a.node())));
+	}
+
+	template <class T, class _Op, class A, class B>
+	expression<T> _binary(const expression<A>& a, const expression<B>& b)
+	{
+		return expression<T>(typename expression<T>::node_pointer(
+			_make_node<_binary_node<T, _Op, A, B>>(a.node(), b.node())));
+	}
+
+	// Operand of a product as written. A chain flattened into the product
+	// is replaced by the product it was built from, which releases the
+	// chain and its buffers.
+	template <class X>
+	std::shared_ptr<_node<X>> _operand(const std::shared_ptr<_node<X>>& node)
+	{
+		if (_shared(node.get(), node.use_count()))
+			return node;
+
+		std::shared_ptr<_node_base> source = node->_Source();
+		return (nullptr != source) ? std::static_pointer_cast<_node<X>>(source) : node;
+	}
+
+	// Multiplies matrices and vectors. Products of three or more factors
+	// are flattened into a single chain node which picks the cheapest
+	// multiplication order. Operands referenced elsewhere, by other nodes
+	// or by expressions the caller keeps, stay single factors. Operators
+	// move their operands here, so temporaries have a single owner.
+	template <class T, class A, class B>
+	expression<T> _product(const expression<A> a, const expression<B> b)
+	{
+		std::vector<_chain_factor> factors;
+		double alpha = 1.0;
+
+		_chain_factor::collect(a.node(), factors, alpha, &_shared);
+		_chain_factor::collect(b.node(), factors, alpha, &_shared);
+
+		std::shared_ptr<_node<T>> product = _make_node<_binary_node<T, _multiplies, A, B>>(_operand(a.node()), _operand(b.node()));
+		if (factors.size() < 3)
+			return expression<T>(product);
+
+		return expression<T>(typename expression<T>::node_pointer(
+			_make_node<_chain_node<T>>(factors, alpha, product)));
+	}
+
+	// Execution plan of a compiled expression.
+	//
+	// Compilation lowers the expression graph to a sequence of steps in
+	// topological order. Equivalent subexpressions share a single step,
+	// and intermediate results are stored in buffers which are reused
+	// once the last step reading them has run. Products of matrices and
+	// vectors are lowered as written and then flattened into chains,
+	// except for products used more than once, which keep their step.
+	class _plan
+	{
+	public:
+		// Number of operations executed by a run.
+		size_t steps() const
+		{
+			return m_steps.size();
+		}
+
+		// Number of buffers holding intermediate results.
+		size_t buffers() const
+		{
+			return m_buffers.size();
+		}
+
+	protected:
+		_plan()
+			: m_result(nullptr)
+		{
+		}
+
+		// Lowers the graph rooted at root. Without reuse every step gets
+		// a buffer of its own, so independent steps may run concurrently.
+		void _Compile(const _node_base* root, const bool reuse = true)
+		{
+			std::vector<_instruction> program;
+			std::unordered_map<const _node_base*, size_t> lowered;
+			std::map<std::pair<std::type_index, std::vector<size_t>>, std::vector<size_t>> candidates;
+
+			const size_t result = _Lower(root, program, lowered, candidates);
+
+			std::vector<size_t> uses(program.size(), 0);
+			for (const _instruction& instruction : program)
+			{
+				for (const size_t input : instruction.inputs)
+				{
+					++uses[input];
+				}
+			}
+
+			const _sharing shared = [&uses, &lowered](const _node_base* node, long)
+				{
+					return 1 != uses[lowered.at(node)];
+				};
+
+			// Consumers come after their inputs, so every product is
+			// flattened before the products it absorbs are visited.
+			// Absorbed products are not used any more and are skipped.
+			std::vector<bool> live(program.size(), false);
+			live[result] = true;
+
+			for (size_t i = program.size(); 0 < i--;)
+			{
+				if (false == live[i])
+					continue;
+
+				std::shared_ptr<_node_base> chain = program[i].node->_Chain(shared);
+				if (nullptr != chain)
+				{
+					program[i].node = chain.get();
+					program[i].inputs.clear();
+
+					for (size_t j = 0; j < chain->arity(); ++j)
+					{
+						program[i].inputs.push_back(lowered.at(chain->child(j)));
+					}
+
+					m_nodes.push_back(chain);
+				}
+
+				for (const size_t input : program[i].inputs)
+				{
+					live[input] = true;
+				}
+			}
+
+			// The last step reading a value releases its buffer.
+			for (size_t i = 0; i < program.size(); ++i)
+			{
+				if (false == live[i])
+					continue;
+
+				program[i].last_use = i;
+				for (const size_t input : program[i].inputs)
+				{
+					program[input].last_use = i;
+				}
+			}
+
+			program[result].last_use = program.size();
+
+			std::map<std::type_index, std::vector<size_t>> available;
+			std::vector<void*> locations(program.size(), nullptr);
+			// A local copy, since the vector would bind npos by reference.
+			const size_t none = _instruction::npos;
+			std::vector<size_t> steps(program.size(), none);
+
+			for (size_t i = 0; i < program.size(); ++i)
+			{
+				if (false == live[i])
+					continue;
+
+				const _node_base* node = program[i].node;
+
+				const void* storage = node->_Storage();
+				if (nullptr != storage)
+				{
+					locations[i] = const_cast<void*>(storage);
+					continue;
+				}
+
+				// The destination is taken before inputs are released,
+				// so a step never writes over its own inputs.
+				std::vector<size_t>& pool = available[node->_ValueType()];
+				if (pool.empty() || false == reuse)
+				{
+					program[i].buffer = m_buffers.size();
+					m_buffers.push_back(node->_MakeBuffer());
+				}
+				else
+				{
+					program[i].buffer = pool.back();
+					pool.pop_back();
+				}
+
+				locations[i] = m_buffers[program[i].buffer]->get();
+
+				std::vector<const void*> inputs;
+				std::vector<size_t> dependencies;
+				for (const size_t input : program[i].inputs)
+				{
+					inputs.push_back(locations[input]);
+
+					if (none != steps[input])
+					{
+						dependencies.push_back(steps[input]);
+					}
+				}
+
+				steps[i] = m_steps.size();
+				m_steps.push_back(node->_Emit(inputs, locations[i]));
+				m_dependencies.push_back(dependencies);
+
+				for (const size_t id : program[i].inputs)
+				{
+					_instruction& input = program[id];
+
+					if (input.last_use == i && _instruction::npos != input.buffer)
+					{
+						available[input.node->_ValueType()].push_back(input.buffer);
+						input.buffer = _instruction::npos;
+					}
+				}
+			}
+
+			m_result = locations[result];
+		}
+
+		void _Execute() const
+		{
+			for (const auto& step : m_steps)
+			{
+				step->execute();
+			}
+		}
+
+		const void* _Result() const
+		{
+			return m_result;
+		}
+
+		// Runs a single step.
+		void _Execute(const size_t step) const
+		{
+			m_steps[step]->execute();
+		}
+
+		// Returns the steps computing the inputs of a step.
+		const std::vector<size_t>& _Dependencies(const size_t step) const
+		{
+			return m_dependencies[step];
+		}
+
+	private:
+		struct _instruction
+		{
+			static const size_t npos = static_cast<size_t>(-1);
+
+			const _node_base* node;
+			std::vector<size_t> inputs;
+			size_t last_use;
+			size_t buffer;
+		};
+
+		static size_t _Lower(
+			const _node_base* node,
+			std::vector<_instruction>& program,
+			std::unordered_map<const _node_base*, size_t>& lowered,
+			std::map<std::pair<std::type_index, std::vector<size_t>>, std::vector<size_t>>& candidates)
+		{
+			auto found = lowered.find(node);
+			if (lowered.end() != found)
+				return found->second;
+
+			std::shared_ptr<_node_base> source = node->_Source();
+			if (nullptr != source)
+			{
+				const size_t id = _Lower(source.get(), program, lowered, candidates);
+
+				lowered[node] = id;
+				return id;
+			}
+
+			std::vector<size_t> inputs;
+			for (size_t i = 0; i < node->arity(); ++i)
+			{
+				inputs.push_back(_Lower(node->child(i), program, lowered, candidates));
+			}
+
+			std::vector<size_t>& same = candidates[std::make_pair(std::type_index(typeid(*node)), inputs)];
+			for (const size_t id : same)
+			{
+				if (program[id].node->_Equals(*node))
+				{
+					lowered[node] = id;
+					return id;
+				}
+			}
+
+			const size_t id = program.size();
+
+			_instruction instruction = { node, inputs, id, _instruction::npos };
+			program.push_back(instruction);
+
+			same.push_back(id);
+			lowered[node] = id;
+
+			return id;
+		}
+
+	private:
+		// Chains created while compiling, referenced by their steps.
+		std::vector<std::shared_ptr<_node_base>> m_nodes;
+		std::vector<std::unique_ptr<_buffer_base>> m_buffers;
+		std::vector<std::unique_ptr<_step>> m_steps;
+		std::vector<std::vector<size_t>> m_dependencies;
+		const void* m_result;
+	};
+
+	// Evaluation of an expression graph as a task graph on a thread pool.
+	//
+	// The graph is compiled into steps with buffers owned by the
+	// evaluation, so the cached values of the nodes are neither read nor
+	// written. Every step waits for the steps computing its distinct
+	// inputs. The worker completing the last input of a step continues
+	// with that step itself and submits the other steps which became
+	// ready, so independent subexpressions run in parallel. The first
+	// exception, or cancellation, checked before every step, is reported
+	// through the future and stops the remaining steps.
+	template <class T>
+	class _async_evaluation : public _plan, public std::enable_shared_from_this<_async_evaluation<T>>
+	{
+	public:
+		typedef _async_evaluation<T> _Self;
+
+		static std::future<T> start(const expression<T>& root, thread_pool& pool, const cancellation_token& token)
+		{
+			std::shared_ptr<_Self> evaluation(new _Self(root, pool, token));
+			std::future<T> result = evaluation->m_promise.get_future();
+
+			evaluation->_Start();
+			return result;
+		}
+
+	private:
+		static const size_t _npos = static_cast<size_t>(-1);
+
+		_async_evaluation(const expression<T>& root, thread_pool& pool, const cancellation_token& token)
+			: m_root(root), m_pool(pool), m_token(token), m_failed(false)
+		{
+			this->_Compile(root.node().get(), false);
+
+			m_parents.resize(this->steps());
+			m_waiting.reset(new std::atomic<size_t>[this->steps()]);
+
+			for (size_t i = 0; i < this->steps(); ++i)
+			{
+				std::vector<size_t> inputs(this->_Dependencies(i));
+				std::sort(inputs.begin(), inputs.end());
+				inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+
+				for (const size_t input : inputs)
+				{
+					m_parents[input].push_back(i);
+				}
+
+				m_waiting[i].store(inputs.size(), std::memory_order_relaxed);
+			}
+		}
+
+		void _Start()
+		{
+			// Leaves are read in place and need no step.
+			if (0 == this->steps())
+			{
+				m_promise.set_value(_Value());
+				return;
+			}
+
+			// Steps are found before any runs, since running steps make
+			// others ready.
+			std::vector<size_t> ready;
+			for (size_t i = 0; i < this->steps(); ++i)
+			{
+				if (0 == m_waiting[i].load(std::memory_order_relaxed))
+				{
+					ready.push_back(i);
+				}
+			}
+
+			for (const size_t index : ready)
+			{
+				_Submit(index);
+			}
+		}
+
+		void _Submit(const size_t index)
+		{
+			std::shared_ptr<_Self> self = this->shared_from_this();
+			m_pool.submit([self, index]() { self->_Run(index); });
+		}
+
+		void _Run(size_t index)
+		{
+			while (_npos != index)
+			{
+				if (m_failed.load(std::memory_order_acquire))
+					return;
+
+				try
+				{
+					if (m_token.is_cancelled())
+						throw evaluation_cancelled();
+
+					this->_Execute(index);
+				}
+				catch (...)
+				{
+					if (false == m_failed.exchange(true, std::memory_order_acq_rel))
+					{
+						m_promise.set_exception(std::current_exception());
+					}
+
+					return;
+				}
+
+				index = _Complete(index);
+			}
+		}
+
+		// Releases the consumers of a completed step. Returns one of the
+		// consumers which became ready, for the caller to continue with.
+		// The root is computed by the last step.
+		size_t _Complete(const size_t index)
+		{
+			if (index + 1 == this->steps())
+			{
+				m_promise.set_value(_Value());
+				return _npos;
+			}
+
+			size_t next = _npos;
+			for (const size_t parent : m_parents[index])
+			{
+				if (1 != m_waiting[parent].fetch_sub(1, std::memory_order_acq_rel))
+					continue;
+
+				if (_npos == next)
+				{
+					next = parent;
+				}
+				else
+				{
+					_Submit(parent);
+				}
+			}
+
+			return next;
+		}
+
+		const T& _Value() const
+		{
+			return *static_cast<const T*>(this->_Result());
+		}
+
+	private:
+		// Keeps the graph alive while steps refer to its storage.
+		expression<T> m_root;
+		thread_pool& m_pool;
+		cancellation_token m_token;
+		std::vector<std::vector<size_t>> m_parents;
+		std::unique_ptr<std::atomic<size_t>[]> m_waiting;
+		std::atomic<bool> m_failed;
+		std::promise<T> m_promise;
+	};
+
+	// Compiled form of an expression.
+	//
+	// Variables are read in place and intermediate results are written
+	// into buffers owned by the plan. After the first run, repeated runs
+	// of expressions over matrices and vectors do not allocate memory.
+	//
+	// Sample usage:
+	//		auto plan = algebra::expressions::compile((a * b) * x + (a * b) * y);
+	//		const auto& r = plan.run();
+	//
+	template <class T>
+	class compiled_expression : public _plan
+	{
+	public:
+		typedef T value_type;
+
+		explicit compiled_expression(const expression<T>& e)
+			: m_expression(e)
+		{
+			this->_Compile(e.node().get());
+		}
+
+		// Executes the plan. The returned reference stays valid until
+		// the next run.
+		const T& run() const
+		{
+			this->_Execute();
+			return *static_cast<const T*>(this->_Result());
 		}
 
 	private:
-		std::shared_ptr<evaluator> m_evaluator;
+		// Keeps the graph alive while steps refer to its storage.
+		expression<T> m_expression;
 	};
 
+	template <class T>
+	compiled_expression<T> compile(const expression<T>& e)
+	{
+		return compiled_expression<T>(e);
+	}
+
+	// Returns an algebraically simplified equivalent of an expression.
+	//
+	// Rewrites transpose(transpose(e)) to e, drops multiplications by one
+	// and by identity matrices, folds chains of scalar factors, moves
+	// scalar factors of products into the product itself and precomputes
+	// subexpressions depending only on constants.
+	//
+	// Sample usage:
+	//		auto plan = algebra::expressions::compile(algebra::expressions::simplify(e));
+	//
+	template <class T>
+	expression<T> simplify(const expression<T>& e)
+	{
+		_rewriter rewriter;
+		return expression<T>(rewriter.simplify(e.node()));
+	}
+
+	// Returns the gradients of a scalar expression with respect to the
+	// given variables, in the order of the variables.
+	//
+	// The expression is evaluated once, then the adjoints are propagated
+	// from the result to the variables through every node once, in
+	// reverse topological order. The gradient with respect to a variable
+	// the expression does not depend on is zero. Function expressions
+	// are opaque and throw std::invalid_argument if the result depends
+	// on them.
+	//
+	// Sample usage:
+	//		auto loss = (w * x - y) * (w * x - y);
+	//		auto g = algebra::expressions::gradient(loss, w, x);
+	//		auto dw = std::get<0>(g);
+	//
+	template <class... V>
+	std::tuple<V...> gradient(const expression<double>& e, const variable<V>&... wrt)
+	{
+		const _node_base* root = e.node().get();
+		e.node()->evaluate();
+
+		_adjoints adjoints;
+		adjoints.add<double>(root, 1.0);
+
+		const std::vector<const _node_base*> order = _node_base::topological(root);
+		for (auto node = order.rbegin(); order.rend() != node; ++node)
+		{
+			(*node)->_Backward(adjoints);
+		}
+
+		return std::tuple<V...>(adjoints.value<V>(wrt.node().get())...);
+	}
+
 	template <class T>
 	expression<T> operator+ (
 		const expression<T> e1,
 		const expression<T> e2)
 	{
-		return expression<T>([e1, e2]() { return e1.evaluate() + e2.evaluate(); });
+		return _binary<T, _plus, T, T>(e1, e2);
 	}
 
 	template <class T>
@@ -97,7 +3075,7 @@ namespace expressions
 		const variable<T> v1,
 		const variable<T> v2)
 	{
-		return expression<T>([v1, v2]() { return v1.value() + v2.value(); });
+		return _binary<T, _plus, T, T>(v1, v2);
 	}
 
 	template <class T>
@@ -105,7 +3083,7 @@ namespace expressions
 		const expression<T> e1,
 		const variable<T> v2)
 	{
-		return expression<T>([e1, v2]() { return e1.evaluate() + v2.value(); });
+		return _binary<T, _plus, T, T>(e1, v2);
 	}
 
 	template <class T>
@@ -113,7 +3091,7 @@ namespace expressions
 		const variable<T> v1,
 		const expression<T> e2)
 	{
-		return expression<T>([v1, e2]() { return v1.value() + e2.evaluate(); });
+		return _binary<T, _plus, T, T>(v1, e2);
 	}
 
 	template <class T>
@@ -121,7 +3099,7 @@ namespace expressions
 		const expression<T> e1,
 		const expression<T> e2)
 	{
-		return expression<T>([e1, e2]() { return e1.evaluate() - e2.evaluate(); });
+		return _binary<T, _minus, T, T>(e1, e2);
 	}
 
 	template <class T>
@@ -129,7 +3107,7 @@ namespace expressions
 		const variable<T> v1,
 		const variable<T> v2)
 	{
-		return expression<T>([v1, v2]() { return v1.value() - v2.value(); });
+		return _binary<T, _minus, T, T>(v1, v2);
 	}
 
 	template <class T>
@@ -137,7 +3115,7 @@ namespace expressions
 		const expression<T> e1,
 		const variable<T> v2)
 	{
-		return expression<T>([e1, v2]() { return e1.evaluate() - v2.value(); });
+		return _binary<T, _minus, T, T>(e1, v2);
 	}
 
 	template <class T>
@@ -145,7 +3123,7 @@ namespace expressions
 		const variable<T> v1,
 		const expression<T> e2)
 	{
-		return expression<T>([v1, e2](){ return v1.value() - e2.evaluate(); });
+		return _binary<T, _minus, T, T>(v1, e2);
 	}
 
 	template <class T>
@@ -153,7 +3131,7 @@ namespace expressions
 		const variable<T> v,
 		const double C)
 	{
-		return expression<T>([v, C]() { return (T)(v.value() * C); });
+		return _binary<T, _multiplies, T, double>(v, constant(C));
 	}
 
 	template <class T>
@@ -169,7 +3147,7 @@ namespace expressions
 		const variable<T> v1,
 		const variable<double> v2)
 	{
-		return expression<T>([v1, v2]() { return v1.value() * v2.value(); });
+		return _binary<T, _multiplies, T, double>(v1, v2);
 	}
 
 	template <class T>
@@ -185,7 +3163,7 @@ namespace expressions
 		const expression<T> e,
 		const double C)
 	{
-		return expression<T>([e, C]() { return (T)(e.evaluate() * C); });
+		return _binary<T, _multiplies, T, double>(e, constant(C));
 	}
 
 	template <class T>
@@ -201,7 +3179,7 @@ namespace expressions
 		const expression<T> e1,
 		const expression<T> e2)
 	{
-		return expression<T>([e1, e2]() { return e1.evaluate() * e2.evaluate(); });
+		return _binary<T, _multiplies, T, T>(e1, e2);
 	}
 }
 }
\ No newline at end of file
@@ -897,7 +897,7 @@ namespace algebra
 			return m_values[row * _Self::column_rank + column];
 		}
 
-		matrix<N, M> transpose()
+		matrix<N, M> transpose() const
 		{
 			matrix<N, M> result;
 
@@ -1938,31 +1938,315 @@ namespace algebra
 
 	namespace expressions
 	{
+		template <class M, class N>
+		struct _chain_traits<matrix<M, N>>
+		{
+			static const bool chainable = true;
+			static const size_t rows = M::rank;
+			static const size_t columns = N::rank;
+
+			// Matrices store their rows one after another.
+			static const double* data(const matrix<M, N>& m)
+			{
+				return m.empty() ? nullptr : std::addressof(m(0, 0));
+			}
+
+			static double* data(matrix<M, N>& m)
+			{
+				return std::addressof(m(0, 0));
+			}
+
+			static void write(const double* src, const double alpha, matrix<M, N>& dest)
+			{
+				for (size_t row = 0; row < M::rank; ++row)
+				{
+					for (size_t col = 0; col < N::rank; ++col)
+					{
+						dest(row, col) = alpha * src[row * N::rank + col];
+					}
+				}
+			}
+		};
+
+		template <class M, class N>
+		void _apply(
+			const _plus&,
+			matrix<M, N>& dest,
+			const matrix<M, N>& m1,
+			const matrix<M, N>& m2)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					dest(row, col) = m1(row, col) + m2(row, col);
+				}
+			}
+		}
+
+		template <class M, class N>
+		void _apply(
+			const _minus&,
+			matrix<M, N>& dest,
+			const matrix<M, N>& m1,
+			const matrix<M, N>& m2)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					dest(row, col) = m1(row, col) - m2(row, col);
+				}
+			}
+		}
+
+		template <class M, class N, class P>
+		void _apply(
+			const _multiplies&,
+			matrix<M, P>& dest,
+			const matrix<M, N>& m1,
+			const matrix<N, P>& m2)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < P::rank; ++col)
+				{
+					typename matrix<M, P>::value_type cell = number_traits<typename matrix<M, P>::value_type>::zero();
+
+					for (size_t i = 0; i < N::rank; ++i)
+					{
+						cell += m1(row, i) * m2(i, col);
+					}
+
+					dest(row, col) = cell;
+				}
+			}
+		}
+
+		template <class M, class N, class P>
+		void _apply(
+			const _multiplies&,
+			matrix<M, P>& dest,
+			const matrix<M, N>& m1,
+			const matrix<N, P>& m2,
+			const double alpha)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < P::rank; ++col)
+				{
+					typename matrix<M, P>::value_type cell = number_traits<typename matrix<M, P>::value_type>::zero();
+
+					for (size_t i = 0; i < N::rank; ++i)
+					{
+						cell += m1(row, i) * m2(i, col);
+					}
+
+					dest(row, col) = alpha * cell;
+				}
+			}
+		}
+
+		template <class M, class N>
+		void _apply(
+			const _multiplies&,
+			vector<M>& dest,
+			const matrix<M, N>& m,
+			const vector<N>& v,
+			const double alpha)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				typename matrix<M, N>::value_type cell = number_traits<typename matrix<M, N>::value_type>::zero();
+
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					cell += m(row, col) * v(col);
+				}
+
+				dest(row) = alpha * cell;
+			}
+		}
+
+		template <class M>
+		bool _is_identity(
+			const _multiplies&,
+			const matrix<M, M>& m)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < M::rank; ++col)
+				{
+					if (m(row, col) != ((row == col) ? 1.0 : 0.0))
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		template <class M, class N>
+		void _apply(
+			const _multiplies&,
+			vector<M>& dest,
+			const matrix<M, N>& m,
+			const vector<N>& v)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				typename matrix<M, N>::value_type cell = number_traits<typename matrix<M, N>::value_type>::zero();
+
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					cell += m(row, col) * v(col);
+				}
+
+				dest(row) = cell;
+			}
+		}
+
+		template <class M, class N>
+		void _apply(
+			const _multiplies&,
+			matrix<M, N>& dest,
+			const matrix<M, N>& m,
+			const double C)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					dest(row, col) = m(row, col) * C;
+				}
+			}
+		}
+
+		template <class M, class N>
+		void _apply(
+			const _multiplies& op,
+			matrix<M, N>& dest,
+			const double C,
+			const matrix<M, N>& m)
+		{
+			_apply(op, dest, m, C);
+		}
+
+		template <class M, class N>
+		void _apply(
+			const _transpose&,
+			matrix<N, M>& dest,
+			const matrix<M, N>& m)
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					dest(col, row) = m(row, col);
+				}
+			}
+		}
+
+		// Differentiation rules. The adjoint of m1 * m2 flows to m1 as
+		// g * m2' and to m2 as m1' * g.
+		template <class M, class N, class P>
+		void _backward(
+			const _multiplies&,
+			const matrix<M, P>& g,
+			const matrix<M, N>& m1,
+			const matrix<N, P>& m2,
+			_adjoint<matrix<M, N>> d1,
+			_adjoint<matrix<N, P>> d2)
+		{
+			d1.add(g * m2.transpose());
+			d2.add(m1.transpose() * g);
+		}
+
+		template <class M, class N>
+		void _backward(
+			const _multiplies&,
+			const vector<M>& g,
+			const matrix<M, N>& m,
+			const vector<N>& v,
+			_adjoint<matrix<M, N>> dm,
+			_adjoint<vector<N>> dv)
+		{
+			matrix<M, N> outer;
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					outer(row, col) = g(row) * v(col);
+				}
+			}
+
+			dm.add(outer);
+			dv.add(m.transpose() * g);
+		}
+
+		template <class M, class N>
+		double _inner(
+			const matrix<M, N>& m1,
+			const matrix<M, N>& m2)
+		{
+			double result = 0;
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					result += m1(row, col) * m2(row, col);
+				}
+			}
+
+			return result;
+		}
+
+		template <class M, class N>
+		void _backward(
+			const _multiplies&,
+			const matrix<M, N>& g,
+			const matrix<M, N>& m,
+			const double C,
+			_adjoint<matrix<M, N>> dm,
+			_adjoint<double> dC)
+		{
+			dm.add(g * C);
+			dC.add(_inner(g, m));
+		}
+
+		template <class M, class N>
+		void _backward(
+			const _multiplies&,
+			const matrix<M, N>& g,
+			const double C,
+			const matrix<M, N>& m,
+			_adjoint<double> dC,
+			_adjoint<matrix<M, N>> dm)
+		{
+			_backward(_multiplies(), g, m, C, dm, dC);
+		}
+
 		template <class M, class N, class P>
 		expression<matrix<M, P>> operator* (
-			const expression<matrix<M, N>> e1,
-			const expression<matrix<N, P>> e2)
+			expression<matrix<M, N>> e1,
+			expression<matrix<N, P>> e2)
 		{
-			return expression<matrix<M, P>>(
-				[e1, e2]() { return e1.evaluate() * e2.evaluate(); });
+			return _product<matrix<M, P>, matrix<M, N>, matrix<N, P>>(std::move(e1), std::move(e2));
 		}
 
 		template <class M, class N, class P>
 		expression<matrix<M, P>> operator* (
 			const variable<matrix<M, N>> v1,
-			const expression<matrix<N, P>> e2)
+			expression<matrix<N, P>> e2)
 		{
-			return expression<matrix<M, P>>(
-				[v1, e2]() { return v1.value() * e2.evaluate(); });
+			return _product<matrix<M, P>, matrix<M, N>, matrix<N, P>>(v1, std::move(e2));
 		}
 
 		template <class M, class N, class P>
 		expression<matrix<M, P>> operator* (
-			const expression<matrix<M, N>> e1,
+			expression<matrix<M, N>> e1,
 			const variable<matrix<N, P>> v2)
 		{
-			return expression<matrix<M, P>>(
-				[e1, v2]() { return e1.evaluate() * v2.value(); });
+			return _product<matrix<M, P>, matrix<M, N>, matrix<N, P>>(std::move(e1), v2);
 		}
 
 		template <class M, class N, class P>
@@ -1970,8 +2254,7 @@ namespace algebra
 			const variable<matrix<M, N>> v1,
 			const variable<matrix<N, P>> v2)
 		{
-			return expression<matrix<M, P>>(
-				[v1, v2]() { return v1.value() * v2.value(); });
+			return _product<matrix<M, P>, matrix<M, N>, matrix<N, P>>(v1, v2);
 		}
 
 		template <class M, class N>
@@ -1979,8 +2262,7 @@ namespace algebra
 			const expression<matrix<M, N>> e1,
 			const expression<double> e2)
 		{
-			return expression<matrix<M, N>>(
-				[e1, e2]() { return e1.evaluate() * e2.evaluate(); });
+			return _binary<matrix<M, N>, _multiplies, matrix<M, N>, double>(e1, e2);
 		}
 
 		template <class M, class N>
@@ -1988,35 +2270,31 @@ namespace algebra
 			const expression<double> e1,
 			const expression<matrix<M, N>> e2)
 		{
-			return expression<matrix<M, N>>(
-				[e1, e2]() { return e1.evaluate() * e2.evaluate(); });
+			return _binary<matrix<M, N>, _multiplies, double, matrix<M, N>>(e1, e2);
 		}
 
 		template <class M, class N>
 		expression<vector<M>> operator* (
-			const expression<matrix<M, N>> e1,
-			const expression<vector<N>> e2)
+			expression<matrix<M, N>> e1,
+			expression<vector<N>> e2)
 		{
-			return expression<vector<M>>(
-				[e1, e2]() { return e1.evaluate() * e2.evaluate(); });
+			return _product<vector<M>, matrix<M, N>, vector<N>>(std::move(e1), std::move(e2));
 		}
 
 		template <class M, class N>
 		expression<vector<M>> operator* (
-			const expression<matrix<M, N>> e1,
+			expression<matrix<M, N>> e1,
 			const variable<vector<N>> v2)
 		{
-			return expression<vector<M>>(
-				[e1, v2]() { return e1.evaluate() * v2.value(); });
+			return _product<vector<M>, matrix<M, N>, vector<N>>(std::move(e1), v2);
 		}
 
 		template <class M, class N>
 		expression<vector<M>> operator* (
 			const variable<matrix<M, N>> v1,
-			const expression<vector<N>> e2)
+			expression<vector<N>> e2)
 		{
-			return expression<vector<M>>(
-				[v1, e2]() { return v2.value() * e2.evaluate(); });
+			return _product<vector<M>, matrix<M, N>, vector<N>>(v1, std::move(e2));
 		}
 
 		template <class M, class N>
@@ -2024,16 +2302,14 @@ namespace algebra
 			const variable<matrix<M, N>> v1,
 			const variable<vector<N>> v2)
 		{
-			return expression<vector<M>>(
-				[v1, v2]() { return v2.value() * v2.value(); });
+			return _product<vector<M>, matrix<M, N>, vector<N>>(v1, v2);
 		}
 
 		template <class M, class N>
 		expression<matrix<N, M>> transpose(
 			const expression<matrix<M, N>> e)
 		{
-			return expression<matrix<N, M>>(
-				[e]() { return e.evaluate().transpose(); });
+			return _unary<matrix<N, M>, _transpose, matrix<M, N>>(e);
 		}
 	}
 }
\ No newline at end of file
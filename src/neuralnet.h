@@ -1,6 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "matrix.h"
+#include "thread_pool.h"
 
 namespace machine_learning
 {
@@ -23,290 +36,2395 @@ namespace machine_learning
 		return (_Dest);
 	}
 
-	class _LayerBase
+	// Activation functions of neuron layers, selected at compile time.
+	// Every policy provides:
+	//		value(x)		the function of one net input,
+	//		apply(pValues, count)	the function applied in place to the net
+	//				inputs of a layer,
+	//		derivative(y)	the derivative for a neuron with output y,
+	//		output_delta(pOutput, pTarget, pDelta, count)
+	//				gradient of the cost of an output layer with respect
+	//				to its net inputs, the squared error unless noted.
+	// Derivatives are computed from the outputs of the neurons, so a
+	// training step evaluates every activation function only once.
+
+	// Base of activation functions that are applied to every neuron on
+	// its own. Loops have no dependencies between iterations, so they are
+	// left to the vectorizer of the compiler.
+	template <class _Policy>
+	struct _elementwise_activation
 	{
-	public:
-		static const double activation(const double& x)
+		typedef double value_type;
+
+		static void apply(
+			value_type* pValues,
+			const size_t count)
 		{
-			// Logistic function: F(x) = 1 / (1 + e^-x) == e^x / (1 + e^x)
-			const double eX = std::exp(x);
-			return eX / (1 + eX);
+			for (size_t i = 0; i < count; ++i)
+			{
+				pValues[i] = _Policy::value(pValues[i]);
+			}
 		}
 
-		static const double activation_derivative(const double& x)
+		static void output_delta(
+			const value_type* pOutput,
+			const value_type* pTarget,
+			value_type* pDelta,
+			const size_t count)
 		{
-			// Derivative of the logistic function is F(x) * (1 - F(x))
-			const double logistic = _LayerBase::activation(x);
-			return logistic * (1.0 - logistic);
+			for (size_t i = 0; i < count; ++i)
+			{
+				pDelta[i] = (pOutput[i] - pTarget[i]) * _Policy::derivative(pOutput[i]);
+			}
 		}
 	};
 
-	template <class _Input, class _Output>
-	class neuron_layer : public _LayerBase
+	// Logistic function: F(x) = 1 / (1 + e^-x), F'(x) = F(x) * (1 - F(x))
+	struct logistic : public _elementwise_activation<logistic>
 	{
-	public:
-		typedef typename neuron_layer<_Input, _Output> _Self;
-		typedef typename algebra::vector<_Input> input;
-		typedef typename algebra::vector<_Output> output;
-		typedef typename algebra::matrix<_Output, _Input> weights;
+		static value_type value(const value_type x)
+		{
+			return 1.0 / (1.0 + std::exp(-x));
+		}
 
-		typedef typename weights::value_type value_type;
+		static value_type derivative(const value_type y)
+		{
+			return y * (1.0 - y);
+		}
+	};
 
-		neuron_layer()
-			: m_weights(weights::random(-0.5, 0.5)), m_net_input(), m_output(), m_delta(), m_bias(output::random(-0.5, 0.5))
-		{}
+	// Hyperbolic tangent: F(x) = tanh(x), F'(x) = 1 - F(x)^2
+	struct hyperbolic_tangent : public _elementwise_activation<hyperbolic_tangent>
+	{
+		static value_type value(const value_type x)
+		{
+			return std::tanh(x);
+		}
 
-		const output& process(
-			const input& data,
-			bool training = false)
+		static value_type derivative(const value_type y)
 		{
-			m_net_input = m_weights * data;
+			return 1.0 - y * y;
+		}
+	};
 
-			// Bias transforms input vector from (x1, ..., xN) into (x1, ..., xN, 1.0),
-			// but to avoid input vector reallocs weights for bias column are kept separately
-			// from the weight matrix, and bias column is handled individually.
-			// Since input for bias column is always 1.0, then weight(row, bias) * 1.0
-			// is the same as weight(row, bias), so it is sufficient to simply add bias weight
-			// to the weighted sum of input.
-			m_net_input += m_bias;
+	// Rectified linear unit: F(x) = max(0, x)
+	struct relu : public _elementwise_activation<relu>
+	{
+		static value_type value(const value_type x)
+		{
+			return (x > 0.0) ? x : 0.0;
+		}
 
-			std::transform(
-				m_net_input.cbegin(), m_net_input.cend(),
-				m_output.begin(),
-				&_Self::activation);
+		static value_type derivative(const value_type y)
+		{
+			return (y > 0.0) ? 1.0 : 0.0;
+		}
+	};
+
+	// Leaky rectified linear unit: F(x) = x for x > 0, 0.01 * x otherwise
+	struct leaky_relu : public _elementwise_activation<leaky_relu>
+	{
+		static value_type slope()
+		{
+			return 0.01;
+		}
+
+		static value_type value(const value_type x)
+		{
+			return (x > 0.0) ? x : slope() * x;
+		}
+
+		static value_type derivative(const value_type y)
+		{
+			return (y > 0.0) ? 1.0 : slope();
+		}
+	};
+
+	// Softmax: F(x)i = e^xi / sum(e^xj). Outputs depend on all net inputs
+	// of the layer, so softmax has no per-neuron derivative and can only
+	// be used for the output layer.
+	struct softmax
+	{
+		typedef double value_type;
 
-			if (false == training)
+		static void apply(
+			value_type* pValues,
+			const size_t count)
+		{
+			// Shifting by the largest input does not change the result and
+			// keeps exponents from overflowing.
+			const value_type max = *std::max_element(pValues, pValues + count);
+			value_type sum = 0;
+
+			for (size_t i = 0; i < count; ++i)
 			{
-				m_net_input.clear();
-				m_delta.clear();
+				pValues[i] = std::exp(pValues[i] - max);
+				sum += pValues[i];
 			}
 
-			return m_output;
+			const value_type scale = 1.0 / sum;
+			for (size_t i = 0; i < count; ++i)
+			{
+				pValues[i] *= scale;
+			}
 		}
 
-		void compute_output_delta(
-			const output& target)
+		// Product of the error and the Jacobian of softmax:
+		// delta(i) = y(i) * (e(i) - sum(e(j) * y(j))), where e = y - target.
+		static void output_delta(
+			const value_type* pOutput,
+			const value_type* pTarget,
+			value_type* pDelta,
+			const size_t count)
 		{
-			// Compute cost function gradient for the output layer.
-			transform(
-				target.begin(), target.end(),
-				m_output.cbegin(),
-				m_net_input.cbegin(),
-				m_delta.begin(),
-				[](const value_type& t, const value_type& o, const value_type& net)
-			{
-				return (o - t) * _Self::activation_derivative(net);
-			});
+			value_type dot = 0;
+			for (size_t j = 0; j < count; ++j)
+			{
+				dot += (pOutput[j] - pTarget[j]) * pOutput[j];
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				pDelta[i] = pOutput[i] * ((pOutput[i] - pTarget[i]) - dot);
+			}
 		}
+	};
 
-		template <class _NextOutput>
-		void compute_inner_delta(
-			const typename neuron_layer<_Output, _NextOutput>& nextLayer)
+	// Softmax output layer with the cross-entropy cost
+	// C = -sum(target(i) * log(y(i))). For targets that sum to one, e.g.
+	// one-hot vectors of classes, the gradient with respect to the net
+	// inputs is y - target. Unlike the squared error through the Jacobian
+	// of softmax, it does not vanish when the outputs saturate, and no
+	// logarithm or division is evaluated during training.
+	struct softmax_cross_entropy : public softmax
+	{
+		static void output_delta(
+			const value_type* pOutput,
+			const value_type* pTarget,
+			value_type* pDelta,
+			const size_t count)
 		{
-			// Compute cost function gradient for hidden layer using 
-			// weights and gradient from the next layer, which are
-			// expected to be computed at this point.
-			typedef typename typename neuron_layer<_Output, _NextOutput> _Next;
-
-			for (size_t i = 0; i < output::rank; ++i)
+			for (size_t i = 0; i < count; ++i)
 			{
-				value_type sum = 0.0;
+				pDelta[i] = pOutput[i] - pTarget[i];
+			}
+		}
 
-				auto dN = nextLayer.delta();
-				auto wN = nextLayer.weight();
-				for (size_t j = 0; j < _Next::output::rank; ++j)
+		// Cross-entropy of the outputs for the given target. Outputs that
+		// underflowed to zero are clamped to the smallest normal value,
+		// so the cost stays finite.
+		static value_type loss(
+			const value_type* pOutput,
+			const value_type* pTarget,
+			const size_t count)
+		{
+			value_type sum = 0;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (0.0 != pTarget[i])
 				{
-					sum += dN(j) * wN(j, i);
+					sum -= pTarget[i] * std::log(std::max(pOutput[i], std::numeric_limits<value_type>::min()));
 				}
-
-				m_delta(i) = sum * _Self::activation_derivative(m_net_input(i));
 			}
+
+			return sum;
 		}
+	};
 
-		void update_weights(
-			const input& data,
-			value_type rate,
-			value_type regularization)
+	class _LayerBase
+	{
+	public:
+		static const double activation(const double& x)
+		{
+			return logistic::value(x);
+		}
+
+		static const double activation_derivative(const double& x)
+		{
+			// Derivative of the logistic function is F(x) * (1 - F(x))
+			return logistic::derivative(logistic::value(x));
+		}
+	};
+
+	// Contiguous block of memory that holds all parameters of a network,
+	// aligned to a cache line. Copies allocate a new block and copy all
+	// values at once.
+	class parameter_arena
+	{
+	public:
+		typedef parameter_arena _Self;
+		typedef double value_type;
+
+		static const size_t alignment = 64;
+
+		explicit parameter_arena(const size_t size)
+			: m_storage(size + _Padding(), 0.0), m_pData(nullptr), m_size(size)
+		{
+			m_pData = _Align(m_storage);
+		}
+
+		parameter_arena(const _Self& other)
+			: m_storage(other.m_storage.size(), 0.0), m_pData(nullptr), m_size(other.m_size)
+		{
+			m_pData = _Align(m_storage);
+			std::memcpy(m_pData, other.m_pData, m_size * sizeof(value_type));
+		}
+
+		parameter_arena(_Self&& other)
+			: m_storage(std::move(other.m_storage)), m_pData(other.m_pData), m_size(other.m_size)
+		{
+			other.m_pData = nullptr;
+			other.m_size = 0;
+		}
+
+		_Self& operator=(const _Self& other)
 		{
-			// Update main weight table first. It is possible to use std::transform
-			// with column iterators, however the resulting code is less efficient
-			// compared to this version.
-			for (size_t col = 0; col < weights::column_rank; ++col)
+			if (this != std::addressof(other))
 			{
-				const value_type factor = data(col) * rate;
-				for (size_t row = 0; row < weights::row_rank; ++row)
+				if (m_size != other.m_size)
+				{
+					_Self copy(other);
+					*this = std::move(copy);
+				}
+				else
 				{
-					m_weights(row, col) += (m_delta(row) + regularization * m_weights(row, col)) * factor;
+					std::memcpy(m_pData, other.m_pData, m_size * sizeof(value_type));
 				}
 			}
 
-			// And now update weights for bias column. This time std::transform is used
-			// to take advantage of vector iterators and memory prefetcher.
-			std::transform(
-				m_bias.cbegin(), m_bias.cend(),
-				m_delta.cbegin(),
-				m_bias.begin(),
-				[regularization, rate](const value_type& bias, const value_type& delta)
-				{
-					return bias + (delta + regularization * bias) * rate;
-				});
+			return (*this);
 		}
 
-		const output& delta() const
+		_Self& operator=(_Self&& other)
 		{
-			return m_delta;
+			if (this != std::addressof(other))
+			{
+				m_storage = std::move(other.m_storage);
+				m_pData = other.m_pData;
+				m_size = other.m_size;
+
+				other.m_pData = nullptr;
+				other.m_size = 0;
+			}
+
+			return (*this);
 		}
 
-		const weights& weight() const
+		value_type* data()
 		{
-			return m_weights;
+			return m_pData;
 		}
 
-		const output& last_output() const
+		const value_type* data() const
 		{
-			return m_output;
+			return m_pData;
+		}
+
+		size_t size() const
+		{
+			return m_size;
 		}
 
 	private:
-		weights m_weights;
-		output m_net_input;
-		output m_output;
-		output m_delta;
-		output m_bias;
+		static size_t _Padding()
+		{
+			return alignment / sizeof(value_type);
+		}
+
+		static value_type* _Align(std::vector<value_type>& storage)
+		{
+			void* p = storage.data();
+			size_t space = storage.size() * sizeof(value_type);
+
+			return static_cast<value_type*>(std::align(alignment, sizeof(value_type), p, space));
+		}
+
+	private:
+		std::vector<value_type> m_storage;
+		value_type* m_pData;
+		size_t m_size;
 	};
 
-	// Implementation of an input or hidden layer in a neural network.
-	// Next layer in the network is represented by the base class.
-	template <class _L1, class _L2, class... _Args>
-	class _network_impl : public _network_impl<_L2, _Args...>
+	// Access to parameters owned by one thread at a time.
+	struct _exclusive_parameters
 	{
-	public:
-		typedef typename _network_impl<_L1, _L2, _Args...> _Self;
-		typedef typename _network_impl<_L2, _Args...> _Base;
-		typedef typename neuron_layer<_L1, _L2> this_layer;
-		typedef typename this_layer::input input;
-		typedef typename _Base::output output;
-		typedef typename _Base::value_type value_type;
+		typedef double value_type;
 
-		const output& process(
-			const input& data,
-			bool training)
+		static value_type load(const value_type* pValue)
 		{
-			// Feed forward results from this layer into the next layer
-			return _Base::process(
-				m_hidden.process(data, training),
-				training);
+			return *pValue;
 		}
 
-		void compute_delta(const output& target)
+		static void store(value_type* pValue, const value_type value)
 		{
-			// For backpropagation, compute cost gradient for the
-			// next layer first, and then compute cost gradient
-			// for the current hidden layer.
-			_Base::compute_delta(target);
-			m_hidden.compute_inner_delta(_Base::get_layer());
+			*pValue = value;
 		}
+	};
 
-		void update_weights(
-			const input& data,
-			value_type rate,
-			value_type regularization)
+	// Access to parameters which other threads update at the same time,
+	// as in asynchronous training. Updates of different threads may
+	// overwrite each other, but no read or write is torn:
+	// - with std::atomic_ref, every access is an atomic relaxed operation,
+	//   so there is no data race;
+	// - with Visual C++ on x64, aligned 64 bit loads and stores are atomic,
+	//   and volatile keeps the compiler from splitting or caching them;
+	// - with Visual C++ on x86, accesses go through interlocked 64 bit
+	//   compare and exchange, which is atomic but costs a locked operation;
+	// - otherwise volatile accesses are used, which keep the compiler from
+	//   vectorizing or caching them, but are still a data race by the
+	//   standard and rely on the hardware not tearing aligned doubles.
+	struct _shared_parameters
+	{
+		typedef double value_type;
+
+		static value_type load(const value_type* pValue)
 		{
-			// Finally, update weights for this and next layers.
-			// Since the members of base class are allocated in memory
-			// before the members of the derived class, update weights
-			// from the base class first for a slight perf benefit.
-			_Base::update_weights(m_hidden.last_output(), rate, regularization);
-			m_hidden.update_weights(data, rate, regularization);
+#if defined(__cpp_lib_atomic_ref)
+			return std::atomic_ref<value_type>(*const_cast<value_type*>(pValue)).load(std::memory_order_relaxed);
+#elif defined(_MSC_VER) && defined(_M_IX86)
+			volatile __int64* pBits = reinterpret_cast<volatile __int64*>(const_cast<value_type*>(pValue));
+			const __int64 bits = _InterlockedCompareExchange64(pBits, 0, 0);
+			value_type value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+#else
+			return *static_cast<const volatile value_type*>(pValue);
+#endif
 		}
 
-		const this_layer& get_layer() const
+		static void store(value_type* pValue, const value_type value)
 		{
-			return m_hidden;
-		}
+#if defined(__cpp_lib_atomic_ref)
+			std::atomic_ref<value_type>(*pValue).store(value, std::memory_order_relaxed);
+#elif defined(_MSC_VER) && defined(_M_IX86)
+			volatile __int64* pBits = reinterpret_cast<volatile __int64*>(pValue);
+			__int64 bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			__int64 expected = *pBits;
+			for (;;)
+			{
+				const __int64 previous = _InterlockedCompareExchange64(pBits, bits, expected);
+				if (previous == expected)
+				{
+					break;
+				}
 
-	private:
-		this_layer m_hidden;
+				expected = previous;
+			}
+#else
+			*static_cast<volatile value_type*>(pValue) = value;
+#endif
+		}
 	};
 
-	// Explicit instantiation for the final (output) layer in a neural network.
-	// This implementation acts as exit point from recursion.
-	template <class _L1, class _L2>
-	class _network_impl<_L1, _L2>
+	template <class _Input, class _Output, class _Activation = logistic>
+	class neuron_layer
 	{
 	public:
-		typedef typename neuron_layer<_L1, _L2> this_layer;
-		typedef typename this_layer::input input;
-		typedef typename this_layer::output output;
-		typedef typename this_layer::value_type value_type;
+		typedef typename neuron_layer<_Input, _Output, _Activation> _Self;
+		typedef typename _Activation activation;
+		typedef typename algebra::vector<_Input> input;
+		typedef typename algebra::vector<_Output> output;
+		typedef typename algebra::matrix<_Output, _Input> weights;
 
-		const output& process(
-			const input& data,
-			bool training)
+		typedef typename weights::value_type value_type;
+
+		// Intermediate values of one training step, kept outside of the
+		// layer by callers that train one layer from several threads.
+		struct state
 		{
-			return m_output.process(data, training);
+			output values;
+			output delta;
+		};
+
+		// Number of values the layer takes in a parameter arena: the
+		// row-major weight matrix followed by the bias column, padded to
+		// a multiple of a cache line so the next layer starts aligned.
+		static const size_t parameter_count =
+			(weights::row_rank * weights::column_rank + output::rank + 7) / 8 * 8;
+
+		// Tag for layers of a network, which are bound to the parameter
+		// arena of the network right after construction.
+		struct unbound
+		{
+		};
+
+		// A layer on its own owns a parameter arena with random weights
+		// and biases, until it is bound to another arena with bind().
+		neuron_layer()
+			: m_pOwned(new parameter_arena(parameter_count)), m_pWeights(nullptr), m_pBias(nullptr), m_output(), m_delta(),
+			m_batch_output(), m_batch_delta(), m_gradient(), m_bias_gradient(), m_input_sum()
+		{
+			_Bind(m_pOwned->data());
+			initialize();
 		}
 
-		void compute_delta(
-			const output& target)
+		// Layers of networks do not own their parameters. They are kept
+		// in the parameter arena of the network, see bind().
+		explicit neuron_layer(unbound)
+			: m_pOwned(), m_pWeights(nullptr), m_pBias(nullptr), m_output(), m_delta(),
+			m_batch_output(), m_batch_delta(), m_gradient(), m_bias_gradient(), m_input_sum()
+		{}
+
+		// A copy of a layer which owns its parameters owns a copy of them.
+		// Other copies share the parameters until they are bound.
+		neuron_layer(const _Self& other)
+			: m_pOwned(), m_pWeights(other.m_pWeights), m_pBias(other.m_pBias), m_output(other.m_output), m_delta(other.m_delta),
+			m_batch_output(other.m_batch_output), m_batch_delta(other.m_batch_delta), m_gradient(other.m_gradient),
+			m_bias_gradient(other.m_bias_gradient), m_input_sum(other.m_input_sum)
 		{
-			m_output.compute_output_delta(target);
+			if (nullptr != other.m_pOwned)
+			{
+				m_pOwned.reset(new parameter_arena(*other.m_pOwned));
+				_Bind(m_pOwned->data());
+			}
 		}
 
-		void update_weights(
-			const input& data,
-			value_type rate,
-			value_type regularization)
+		neuron_layer(_Self&& other)
+			: m_pOwned(std::move(other.m_pOwned)), m_pWeights(other.m_pWeights), m_pBias(other.m_pBias), m_output(std::move(other.m_output)), m_delta(std::move(other.m_delta)),
+			m_batch_output(std::move(other.m_batch_output)), m_batch_delta(std::move(other.m_batch_delta)), m_gradient(std::move(other.m_gradient)),
+			m_bias_gradient(std::move(other.m_bias_gradient)), m_input_sum(std::move(other.m_input_sum))
 		{
-			m_output.update_weights(data, rate, regularization);
 		}
 
-		const this_layer& get_layer() const
+		_Self& operator=(const _Self& other)
 		{
-			return m_output;
+			if (this != std::addressof(other))
+			{
+				_Self copy(other);
+				*this = std::move(copy);
+			}
+
+			return (*this);
 		}
 
-	private:
-		this_layer m_output;
-	};
+		_Self& operator=(_Self&& other)
+		{
+			if (this != std::addressof(other))
+			{
+				m_pOwned = std::move(other.m_pOwned);
+				m_pWeights = other.m_pWeights;
+				m_pBias = other.m_pBias;
+				m_output = std::move(other.m_output);
+				m_delta = std::move(other.m_delta);
+				m_batch_output = std::move(other.m_batch_output);
+				m_batch_delta = std::move(other.m_batch_delta);
+				m_gradient = std::move(other.m_gradient);
+				m_bias_gradient = std::move(other.m_bias_gradient);
+				m_input_sum = std::move(other.m_input_sum);
+			}
 
-	// Variadic template for a feed-forward neural network
-	// that is trained using backpropagation algorithm.
-	template <class _L1, class _L2, class... _Args>
-	class neural_network : protected _network_impl<_L1, _L2, _Args...>
-	{
-	public:
-		typedef typename _network_impl<_L1, _L2, _Args...> _Base;
-		typedef typename _Base::input input;
-		typedef typename _Base::output output;
-		typedef typename _Base::value_type value_type;
+			return (*this);
+		}
 
-		const output& process(
-			const input& data)
+		// Points the layer to its parameters in a parameter arena, and
+		// releases the parameters the layer owned, if any.
+		void bind(value_type* pParameters)
 		{
-			return _Base::process(data, false);
+			_Bind(pParameters);
+			m_pOwned.reset();
 		}
 
-		void train(const input& data,
-			const output& target,
-			value_type rate,
-			value_type regularization = 0.000001)
+		// Sets weights and biases to random values in [-0.5, 0.5].
+		void initialize()
 		{
-			// First, recursively process input through all layers.
-			// Training mode enables caching of important intermediate
-			// values which are used late.
-			_Base::process(data, true);
+			std::random_device rd;
+			std::mt19937 gen(rd());
+			std::uniform_real_distribution<value_type> distr(-0.5, 0.5);
 
-			// Then recursively compute gradient and propagate it
-			// in backward direction.
-			_Base::compute_delta(target);
+			std::generate(m_pWeights, m_pBias + output::rank, [&]() { return distr(gen); });
+		}
 
-			// Finally, update the costs of all layers.
-			// Make sure that correct learning and regularization rate values are used.
-			rate = -std::abs(rate);
-			regularization = std::abs(regularization);
-			_Base::update_weights(data, rate, regularization);
+		const output& process(
+			const input& data,
+			bool /* training */ = false)
+		{
+			// Bias transforms input vector from (x1, ..., xN) into (x1, ..., xN, 1.0),
+			// but to avoid input vector reallocs weights for bias column are kept separately
+			// from the weight matrix, and bias column is handled individually.
+			// Since input for bias column is always 1.0, then weight(row, bias) * 1.0
+			// is the same as weight(row, bias), so it is sufficient to simply add bias weight
+			// to the weighted sum of input.
+			//
+			// The delta vector is kept after inference, so switching between
+			// inference and training does not reallocate it.
+			_Forward(data, std::addressof(m_output(0)));
+			return m_output;
+		}
+
+		// Computes the same output as process() into the given result
+		// vector and leaves the layer untouched, so any number of threads
+		// may use one layer at the same time, each with its own result.
+		// The result vector is allocated on first use and then reused.
+		const output& process(
+			const input& data,
+			output& result) const
+		{
+			_Forward(data, std::addressof(result(0)));
+			return result;
 		}
+
+		// Same as process() in training mode, with the intermediate values
+		// kept in the given state instead of the layer. Weights are read
+		// as parameters shared with concurrent training steps.
+		const output& process(
+			const input& data,
+			state& context) const
+		{
+			_ForwardKernel<_shared_parameters>(m_pWeights, m_pBias, _Data(data), 1, std::addressof(context.values(0)));
+			return context.values;
+		}
+
+		void compute_output_delta(
+			const output& target)
+		{
+			// Compute cost function gradient for the output layer.
+			activation::output_delta(
+				std::addressof(m_output(0)),
+				_Data(target),
+				std::addressof(m_delta(0)),
+				output::rank);
+		}
+
+		// Storage for the error of this layer, which the next layer adds
+		// up in backward(). It becomes the delta of this layer in
+		// compute_inner_delta().
+		value_type* error()
+		{
+			return std::addressof(m_delta(0));
+		}
+
+		void compute_inner_delta()
+		{
+			// Compute cost function gradient for hidden layer from the
+			// error propagated by the next layer.
+			for (size_t i = 0; i < output::rank; ++i)
+			{
+				m_delta(i) *= activation::derivative(m_output(i));
+			}
+		}
+
+		// Propagates the delta of this layer to the error of the previous
+		// layer in pBack, unless it is nullptr, and updates the weights.
+		void backward(
+			const input& data,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			_BackwardKernel<_exclusive_parameters>(_Data(data), std::addressof(m_delta(0)), pBack, nullptr, rate, regularization);
+		}
+
+		// Same as backward(), but leaves the weights unchanged and writes
+		// the gradient of the cost function with respect to the weights
+		// and biases to pGradient, in the layout of the parameters.
+		void gradient(
+			const input& data,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type regularization)
+		{
+			_BackwardKernel<_exclusive_parameters>(_Data(data), std::addressof(m_delta(0)), pBack, pGradient, 0.0, regularization);
+		}
+
+		void compute_output_delta(
+			const output& target,
+			state& context) const
+		{
+			activation::output_delta(
+				std::addressof(context.values(0)),
+				_Data(target),
+				std::addressof(context.delta(0)),
+				output::rank);
+		}
+
+		void compute_inner_delta(
+			state& context) const
+		{
+			for (size_t i = 0; i < output::rank; ++i)
+			{
+				context.delta(i) *= activation::derivative(context.values(i));
+			}
+		}
+
+		// Same as backward() with the delta from the given state. There is
+		// no locking: when several threads update one layer, an update can
+		// overwrite a concurrent update of the same weight, which is
+		// tolerated by asynchronous stochastic gradient descent. Weights
+		// are read and written as shared parameters, and weights of zero
+		// inputs are not written at all, which avoids needless conflicts
+		// with other threads for sparse inputs.
+		void backward(
+			const input& data,
+			const state& context,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			_BackwardKernel<_shared_parameters>(_Data(data), std::addressof(context.delta(0)), pBack, nullptr, rate, regularization);
+		}
+
+		const output& delta() const
+		{
+			return m_delta;
+		}
+
+		// Copy of the weight matrix. The weights live in a parameter arena
+		// rather than in a matrix, so unlike before the arena was added,
+		// this returns a copy, not a reference; a copy does not follow
+		// later training. parameters() gives the weights in place, as a
+		// row-major matrix followed by the biases.
+		weights weight() const
+		{
+			weights result;
+
+			for (size_t row = 0; row < weights::row_rank; ++row)
+			{
+				for (size_t col = 0; col < weights::column_rank; ++col)
+				{
+					result(row, col) = m_pWeights[row * weights::column_rank + col];
+				}
+			}
+
+			return result;
+		}
+
+		const output& last_output() const
+		{
+			return m_output;
+		}
+
+		// Mini-batch training works on row-major buffers with one sample
+		// per row. Every step is a matrix product over the whole batch,
+		// so the weights are streamed from memory once per batch instead
+		// of once per sample.
+		const value_type* process_batch(
+			const value_type* data,
+			const size_t batch)
+		{
+			m_batch_output.resize(batch * output::rank);
+			m_batch_delta.resize(batch * output::rank);
+
+			_ForwardKernel(m_pWeights, m_pBias, data, batch, m_batch_output.data());
+
+			return m_batch_output.data();
+		}
+
+		void compute_output_delta_batch(
+			const value_type* target,
+			const size_t batch)
+		{
+			for (size_t sample = 0; sample < batch; ++sample)
+			{
+				const size_t offset = sample * output::rank;
+
+				activation::output_delta(
+					m_batch_output.data() + offset,
+					target + offset,
+					m_batch_delta.data() + offset,
+					output::rank);
+			}
+		}
+
+		template <class _NextOutput, class _NextActivation>
+		void compute_inner_delta_batch(
+			const typename neuron_layer<_Output, _NextOutput, _NextActivation>& nextLayer,
+			const size_t batch)
+		{
+			typedef typename typename neuron_layer<_Output, _NextOutput, _NextActivation> _Next;
+
+			// delta = (deltaN * WN) .* F'(net). Rows of WN are added to the
+			// delta row of a sample, so all accesses are sequential.
+			const value_type* pWeights = nextLayer.batch_weights();
+			const value_type* pDeltaN = nextLayer.batch_delta();
+
+			std::fill(m_batch_delta.begin(), m_batch_delta.end(), 0.0);
+
+			for (size_t sample = 0; sample < batch; ++sample)
+			{
+				value_type* pDelta = m_batch_delta.data() + sample * output::rank;
+
+				for (size_t j = 0; j < _Next::output::rank; ++j)
+				{
+					const value_type d = pDeltaN[sample * _Next::output::rank + j];
+					const value_type* pW = pWeights + j * output::rank;
+
+					for (size_t i = 0; i < output::rank; ++i)
+					{
+						pDelta[i] += d * pW[i];
+					}
+				}
+
+				const value_type* pValues = m_batch_output.data() + sample * output::rank;
+				for (size_t i = 0; i < output::rank; ++i)
+				{
+					pDelta[i] *= activation::derivative(pValues[i]);
+				}
+			}
+		}
+
+		value_type* batch_error()
+		{
+			return m_batch_delta.data();
+		}
+
+		void compute_inner_delta_batch(
+			const size_t batch)
+		{
+			for (size_t i = 0; i < batch * output::rank; ++i)
+			{
+				m_batch_delta[i] *= activation::derivative(m_batch_output[i]);
+			}
+		}
+
+		// Applies the average of the per-sample updates of the batch,
+		// computed with the weights as they were before the batch, and
+		// propagates the deltas of the batch to the errors of the previous
+		// layer in pBack, unless it is nullptr.
+		void backward_batch(
+			const value_type* data,
+			const size_t batch,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			_BackwardBatch(data, batch, pBack, nullptr, rate, regularization);
+		}
+
+		// Same as backward_batch(), but leaves the weights unchanged and
+		// writes the average gradient of the batch to pGradient, in the
+		// layout of the parameters.
+		void gradient_batch(
+			const value_type* data,
+			const size_t batch,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type regularization)
+		{
+			_BackwardBatch(data, batch, pBack, pGradient, 0.0, regularization);
+		}
+
+		// Sums the weight gradients of the samples of the batch, without
+		// changing the weights.
+		void accumulate_gradient_batch(
+			const value_type* data,
+			const size_t batch)
+		{
+			// Gradient = delta' * data, accumulated separately from the
+			// weights. Each gradient row stays in cache while the samples
+			// stream through it.
+			m_gradient.assign(weights::row_rank * weights::column_rank, 0.0);
+			m_bias_gradient.assign(output::rank, 0.0);
+			m_input_sum.assign(input::rank, 0.0);
+
+			for (size_t row = 0; row < output::rank; ++row)
+			{
+				value_type* pG = m_gradient.data() + row * input::rank;
+
+				for (size_t sample = 0; sample < batch; ++sample)
+				{
+					const value_type d = m_batch_delta[sample * output::rank + row];
+					const value_type* pIn = data + sample * input::rank;
+
+					for (size_t col = 0; col < input::rank; ++col)
+					{
+						pG[col] += d * pIn[col];
+					}
+
+					m_bias_gradient[row] += d;
+				}
+			}
+
+			for (size_t sample = 0; sample < batch; ++sample)
+			{
+				const value_type* pIn = data + sample * input::rank;
+				for (size_t col = 0; col < input::rank; ++col)
+				{
+					m_input_sum[col] += pIn[col];
+				}
+			}
+		}
+
+		// Adds the gradient sums of another layer, accumulated for other
+		// samples with the same weights.
+		void add_gradient(
+			const _Self& other)
+		{
+			std::transform(
+				m_gradient.cbegin(), m_gradient.cend(),
+				other.m_gradient.cbegin(),
+				m_gradient.begin(),
+				[](const value_type& g1, const value_type& g2) { return g1 + g2; });
+
+			std::transform(
+				m_bias_gradient.cbegin(), m_bias_gradient.cend(),
+				other.m_bias_gradient.cbegin(),
+				m_bias_gradient.begin(),
+				[](const value_type& g1, const value_type& g2) { return g1 + g2; });
+
+			std::transform(
+				m_input_sum.cbegin(), m_input_sum.cend(),
+				other.m_input_sum.cbegin(),
+				m_input_sum.begin(),
+				[](const value_type& x1, const value_type& x2) { return x1 + x2; });
+		}
+
+		// Updates the weights with the average of the accumulated
+		// gradients of the given number of samples.
+		void apply_gradient_batch(
+			const size_t batch,
+			value_type rate,
+			value_type regularization)
+		{
+			const value_type scale = 1.0 / batch;
+
+			for (size_t row = 0; row < output::rank; ++row)
+			{
+				_ApplyGradient(row, scale, rate, regularization);
+			}
+		}
+
+		const value_type* batch_output() const
+		{
+			return m_batch_output.data();
+		}
+
+		const value_type* batch_delta() const
+		{
+			return m_batch_delta.data();
+		}
+
+		// Parameters of the layer in place: the row-major weight matrix
+		// followed by the bias column.
+		const value_type* parameters() const
+		{
+			return m_pWeights;
+		}
+
+		const value_type* batch_weights() const
+		{
+			return m_pWeights;
+		}
+
+	private:
+		void _Bind(value_type* pParameters)
+		{
+			m_pWeights = pParameters;
+			m_pBias = pParameters + weights::row_rank * weights::column_rank;
+		}
+
+		// Computes the output for the given data.
+		void _Forward(
+			const input& data,
+			value_type* pResult) const
+		{
+			_ForwardKernel(m_pWeights, m_pBias, _Data(data), 1, pResult);
+		}
+
+		// Fused forward kernel: out = F(in * W' + bias) for a batch of
+		// samples in row-major order, written straight to pOut. Each
+		// element is a dot product of a sample row and a weight row, with
+		// the bias added while the sum is still in a register. Four
+		// samples are processed together, so every weight row is loaded
+		// once for all four, and the activation function is applied to
+		// their outputs while they are still in cache. Parameters are read
+		// through _Access.
+		template <class _Access = _exclusive_parameters>
+		static void _ForwardKernel(
+			const value_type* pWeights,
+			const value_type* pBias,
+			const value_type* pIn,
+			const size_t batch,
+			value_type* pOut)
+		{
+			size_t sample = 0;
+
+			for (; sample + 4 <= batch; sample += 4)
+			{
+				const value_type* pIn0 = pIn + sample * input::rank;
+				const value_type* pIn1 = pIn0 + input::rank;
+				const value_type* pIn2 = pIn1 + input::rank;
+				const value_type* pIn3 = pIn2 + input::rank;
+
+				value_type* pOut0 = pOut + sample * output::rank;
+				value_type* pOut1 = pOut0 + output::rank;
+				value_type* pOut2 = pOut1 + output::rank;
+				value_type* pOut3 = pOut2 + output::rank;
+
+				for (size_t row = 0; row < output::rank; ++row)
+				{
+					const value_type* pW = pWeights + row * input::rank;
+					value_type sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+					for (size_t col = 0; col < input::rank; ++col)
+					{
+						const value_type w = _Access::load(pW + col);
+						sum0 += pIn0[col] * w;
+						sum1 += pIn1[col] * w;
+						sum2 += pIn2[col] * w;
+						sum3 += pIn3[col] * w;
+					}
+
+					const value_type bias = _Access::load(pBias + row);
+					pOut0[row] = sum0 + bias;
+					pOut1[row] = sum1 + bias;
+					pOut2[row] = sum2 + bias;
+					pOut3[row] = sum3 + bias;
+				}
+
+				activation::apply(pOut0, output::rank);
+				activation::apply(pOut1, output::rank);
+				activation::apply(pOut2, output::rank);
+				activation::apply(pOut3, output::rank);
+			}
+
+			for (; sample < batch; ++sample)
+			{
+				const value_type* pX = pIn + sample * input::rank;
+				value_type* pY = pOut + sample * output::rank;
+
+				for (size_t row = 0; row < output::rank; ++row)
+				{
+					const value_type* pW = pWeights + row * input::rank;
+					value_type sum = 0;
+
+					for (size_t col = 0; col < input::rank; ++col)
+					{
+						sum += _Access::load(pW + col) * pX[col];
+					}
+
+					pY[row] = sum + _Access::load(pBias + row);
+				}
+
+				activation::apply(pY, output::rank);
+			}
+		}
+
+		// Fused backward kernel for one sample. In a single row-major pass
+		// over the weights, adds the transposed product W' * delta to the
+		// error of the previous layer in pBack, unless it is nullptr, and
+		// applies the weight update of train(). Every weight is read once
+		// for both, before it is updated. When pGradient is not nullptr,
+		// the gradient is written there instead of updating the weights.
+		// Parameters are accessed through _Access. Shared parameters of
+		// zero inputs are left alone.
+		template <class _Access>
+		void _BackwardKernel(
+			const value_type* pIn,
+			const value_type* pDelta,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type rate,
+			value_type regularization)
+		{
+			if (nullptr != pBack)
+			{
+				std::fill(pBack, pBack + input::rank, 0.0);
+			}
+
+			const bool skip = std::is_same<_Access, _shared_parameters>::value;
+
+			for (size_t row = 0; row < output::rank; ++row)
+			{
+				const value_type d = pDelta[row];
+				value_type* pW = m_pWeights + row * input::rank;
+
+				if (nullptr != pBack)
+				{
+					for (size_t col = 0; col < input::rank; ++col)
+					{
+						pBack[col] += d * _Access::load(pW + col);
+					}
+				}
+
+				if (nullptr != pGradient)
+				{
+					value_type* pG = pGradient + row * input::rank;
+
+					for (size_t col = 0; col < input::rank; ++col)
+					{
+						pG[col] = (d + regularization * _Access::load(pW + col)) * pIn[col];
+					}
+
+					pGradient[output::rank * input::rank + row] = d + regularization * _Access::load(m_pBias + row);
+				}
+				else
+				{
+					for (size_t col = 0; col < input::rank; ++col)
+					{
+						if (false == skip || 0.0 != pIn[col])
+						{
+							const value_type w = _Access::load(pW + col);
+							_Access::store(pW + col, w + (d + regularization * w) * pIn[col] * rate);
+						}
+					}
+
+					const value_type bias = _Access::load(m_pBias + row);
+					_Access::store(m_pBias + row, bias + (d + regularization * bias) * rate);
+				}
+			}
+		}
+
+		// Batch counterpart of _BackwardKernel(): each weight row is used
+		// for the errors of all samples and then updated in one pass, or
+		// its gradient is written to pGradient.
+		void _BackwardBatch(
+			const value_type* data,
+			const size_t batch,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type rate,
+			value_type regularization)
+		{
+			accumulate_gradient_batch(data, batch);
+
+			if (nullptr != pBack)
+			{
+				std::fill(pBack, pBack + batch * input::rank, 0.0);
+			}
+
+			const value_type scale = 1.0 / batch;
+
+			for (size_t row = 0; row < output::rank; ++row)
+			{
+				if (nullptr != pBack)
+				{
+					const value_type* pW = m_pWeights + row * input::rank;
+
+					for (size_t sample = 0; sample < batch; ++sample)
+					{
+						const value_type d = m_batch_delta[sample * output::rank + row];
+						value_type* pB = pBack + sample * input::rank;
+
+						for (size_t col = 0; col < input::rank; ++col)
+						{
+							pB[col] += d * pW[col];
+						}
+					}
+				}
+
+				if (nullptr != pGradient)
+				{
+					_StoreGradient(row, scale, regularization, pGradient);
+				}
+				else
+				{
+					_ApplyGradient(row, scale, rate, regularization);
+				}
+			}
+		}
+
+		// Writes the average gradient of one weight row and its bias to
+		// pGradient, in the layout of the parameters.
+		void _StoreGradient(
+			const size_t row,
+			const value_type scale,
+			const value_type regularization,
+			value_type* pGradient) const
+		{
+			const value_type* pW = m_pWeights + row * input::rank;
+			const value_type* pG = m_gradient.data() + row * input::rank;
+			value_type* pOut = pGradient + row * input::rank;
+
+			for (size_t col = 0; col < input::rank; ++col)
+			{
+				pOut[col] = (pG[col] + regularization * pW[col] * m_input_sum[col]) * scale;
+			}
+
+			pGradient[output::rank * input::rank + row] = m_bias_gradient[row] * scale + regularization * m_pBias[row];
+		}
+
+		// Updates one weight row and its bias with the average of the
+		// accumulated gradients.
+		void _ApplyGradient(
+			const size_t row,
+			const value_type scale,
+			const value_type rate,
+			const value_type regularization)
+		{
+			value_type* pW = m_pWeights + row * input::rank;
+			const value_type* pG = m_gradient.data() + row * input::rank;
+
+			for (size_t col = 0; col < input::rank; ++col)
+			{
+				pW[col] += (pG[col] + regularization * pW[col] * m_input_sum[col]) * scale * rate;
+			}
+
+			m_pBias[row] += (m_bias_gradient[row] * scale + regularization * m_pBias[row]) * rate;
+		}
+
+		// Values of a vector in contiguous memory. Empty vectors hold zeros.
+		template <class D>
+		static const value_type* _Data(const algebra::vector<D>& v)
+		{
+			static const std::vector<value_type> zeros(D::rank, 0.0);
+			return v.empty() ? zeros.data() : std::addressof(v(0));
+		}
+
+	private:
+		std::unique_ptr<parameter_arena> m_pOwned;
+		value_type* m_pWeights;
+		value_type* m_pBias;
+		output m_output;
+		output m_delta;
+
+		std::vector<value_type> m_batch_output;
+		std::vector<value_type> m_batch_delta;
+		std::vector<value_type> m_gradient;
+		std::vector<value_type> m_bias_gradient;
+		std::vector<value_type> m_input_sum;
+	};
+
+	// Implementation of an input or hidden layer in a neural network.
+	// Next layer in the network is represented by the base class.
+	// Hidden layers use the _Activation function, the output layer uses
+	// the _OutputActivation function.
+	template <class _Activation, class _OutputActivation, class _L1, class _L2, class... _Args>
+	class _network_impl : public _network_impl<_Activation, _OutputActivation, _L2, _Args...>
+	{
+	public:
+		typedef typename _network_impl<_Activation, _OutputActivation, _L1, _L2, _Args...> _Self;
+		typedef typename _network_impl<_Activation, _OutputActivation, _L2, _Args...> _Base;
+		typedef typename neuron_layer<_L1, _L2, _Activation> this_layer;
+		typedef typename this_layer::input input;
+		typedef typename _Base::output output;
+		typedef typename _Base::value_type value_type;
+
+		static const size_t parameter_count = this_layer::parameter_count + _Base::parameter_count;
+
+		// Outputs of all layers for one inference call.
+		struct workspace
+		{
+			typename this_layer::output values;
+			typename _Base::workspace next;
+		};
+
+		// Intermediate values of all layers for one training step.
+		struct training_workspace
+		{
+			typename this_layer::state values;
+			typename _Base::training_workspace next;
+		};
+
+		_network_impl()
+			: _Base(), m_hidden(typename this_layer::unbound())
+		{}
+
+		const output& process(
+			const input& data,
+			bool training)
+		{
+			// Feed forward results from this layer into the next layer
+			return _Base::process(
+				m_hidden.process(data, training),
+				training);
+		}
+
+		const output& process(
+			const input& data,
+			workspace& context) const
+		{
+			return _Base::process(
+				m_hidden.process(data, context.values),
+				context.next);
+		}
+
+		const output& process(
+			const input& data,
+			training_workspace& context) const
+		{
+			return _Base::process(
+				m_hidden.process(data, context.values),
+				context.next);
+		}
+
+		// Backpropagation fused with the weight update. Starting from the
+		// output layer, every layer computes its delta, propagates it to
+		// the error of the previous layer and updates its weights, in one
+		// pass over its weights.
+		void backward(
+			const input& data,
+			const output& target,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			_Base::backward(m_hidden.last_output(), target, m_hidden.error(), rate, regularization);
+			m_hidden.compute_inner_delta();
+			m_hidden.backward(data, pBack, rate, regularization);
+		}
+
+		void backward(
+			const input& data,
+			const output& target,
+			training_workspace& context,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			_Base::backward(
+				context.values.values,
+				target,
+				context.next,
+				std::addressof(context.values.delta(0)),
+				rate,
+				regularization);
+
+			m_hidden.compute_inner_delta(context.values);
+			m_hidden.backward(data, context.values, pBack, rate, regularization);
+		}
+
+		// Same as backward(), but writes the gradient of all layers to
+		// pGradient, in the layout of the parameter arena.
+		void gradient(
+			const input& data,
+			const output& target,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type regularization)
+		{
+			_Base::gradient(m_hidden.last_output(), target, m_hidden.error(), pGradient + this_layer::parameter_count, regularization);
+			m_hidden.compute_inner_delta();
+			m_hidden.gradient(data, pBack, pGradient, regularization);
+		}
+
+		const value_type* process_batch(
+			const value_type* data,
+			const size_t batch)
+		{
+			return _Base::process_batch(
+				m_hidden.process_batch(data, batch),
+				batch);
+		}
+
+		void compute_delta_batch(
+			const value_type* target,
+			const size_t batch)
+		{
+			_Base::compute_delta_batch(target, batch);
+			m_hidden.compute_inner_delta_batch(_Base::get_layer(), batch);
+		}
+
+		void backward_batch(
+			const value_type* data,
+			const value_type* target,
+			const size_t batch,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			_Base::backward_batch(m_hidden.batch_output(), target, batch, m_hidden.batch_error(), rate, regularization);
+			m_hidden.compute_inner_delta_batch(batch);
+			m_hidden.backward_batch(data, batch, pBack, rate, regularization);
+		}
+
+		void gradient_batch(
+			const value_type* data,
+			const value_type* target,
+			const size_t batch,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type regularization)
+		{
+			_Base::gradient_batch(m_hidden.batch_output(), target, batch, m_hidden.batch_error(), pGradient + this_layer::parameter_count, regularization);
+			m_hidden.compute_inner_delta_batch(batch);
+			m_hidden.gradient_batch(data, batch, pBack, pGradient, regularization);
+		}
+
+		void accumulate_gradient_batch(
+			const value_type* data,
+			const size_t batch)
+		{
+			_Base::accumulate_gradient_batch(m_hidden.batch_output(), batch);
+			m_hidden.accumulate_gradient_batch(data, batch);
+		}
+
+		void add_gradient(
+			const _Self& other)
+		{
+			_Base::add_gradient(other);
+			m_hidden.add_gradient(other.m_hidden);
+		}
+
+		void apply_gradient_batch(
+			const size_t batch,
+			value_type rate,
+			value_type regularization)
+		{
+			_Base::apply_gradient_batch(batch, rate, regularization);
+			m_hidden.apply_gradient_batch(batch, rate, regularization);
+		}
+
+		// Binds all layers to consecutive ranges of a parameter arena,
+		// starting with this layer.
+		void bind(value_type* pParameters)
+		{
+			m_hidden.bind(pParameters);
+			_Base::bind(pParameters + this_layer::parameter_count);
+		}
+
+		void initialize()
+		{
+			m_hidden.initialize();
+			_Base::initialize();
+		}
+
+		const this_layer& get_layer() const
+		{
+			return m_hidden;
+		}
+
+	private:
+		this_layer m_hidden;
+	};
+
+	// Explicit instantiation for the final (output) layer in a neural network.
+	// This implementation acts as exit point from recursion.
+	template <class _Activation, class _OutputActivation, class _L1, class _L2>
+	class _network_impl<_Activation, _OutputActivation, _L1, _L2>
+	{
+	public:
+		typedef typename _network_impl<_Activation, _OutputActivation, _L1, _L2> _Self;
+		typedef typename neuron_layer<_L1, _L2, _OutputActivation> this_layer;
+		typedef typename this_layer::input input;
+		typedef typename this_layer::output output;
+		typedef typename this_layer::value_type value_type;
+
+		static const size_t parameter_count = this_layer::parameter_count;
+
+		struct workspace
+		{
+			output values;
+		};
+
+		struct training_workspace
+		{
+			typename this_layer::state values;
+		};
+
+		_network_impl()
+			: m_output(typename this_layer::unbound())
+		{}
+
+		const output& process(
+			const input& data,
+			bool training)
+		{
+			return m_output.process(data, training);
+		}
+
+		const output& process(
+			const input& data,
+			workspace& context) const
+		{
+			return m_output.process(data, context.values);
+		}
+
+		const output& process(
+			const input& data,
+			training_workspace& context) const
+		{
+			return m_output.process(data, context.values);
+		}
+
+		void backward(
+			const input& data,
+			const output& target,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			m_output.compute_output_delta(target);
+			m_output.backward(data, pBack, rate, regularization);
+		}
+
+		void backward(
+			const input& data,
+			const output& target,
+			training_workspace& context,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			m_output.compute_output_delta(target, context.values);
+			m_output.backward(data, context.values, pBack, rate, regularization);
+		}
+
+		void gradient(
+			const input& data,
+			const output& target,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type regularization)
+		{
+			m_output.compute_output_delta(target);
+			m_output.gradient(data, pBack, pGradient, regularization);
+		}
+
+		const value_type* process_batch(
+			const value_type* data,
+			const size_t batch)
+		{
+			return m_output.process_batch(data, batch);
+		}
+
+		void compute_delta_batch(
+			const value_type* target,
+			const size_t batch)
+		{
+			m_output.compute_output_delta_batch(target, batch);
+		}
+
+		void backward_batch(
+			const value_type* data,
+			const value_type* target,
+			const size_t batch,
+			value_type* pBack,
+			value_type rate,
+			value_type regularization)
+		{
+			m_output.compute_output_delta_batch(target, batch);
+			m_output.backward_batch(data, batch, pBack, rate, regularization);
+		}
+
+		void gradient_batch(
+			const value_type* data,
+			const value_type* target,
+			const size_t batch,
+			value_type* pBack,
+			value_type* pGradient,
+			value_type regularization)
+		{
+			m_output.compute_output_delta_batch(target, batch);
+			m_output.gradient_batch(data, batch, pBack, pGradient, regularization);
+		}
+
+		void accumulate_gradient_batch(
+			const value_type* data,
+			const size_t batch)
+		{
+			m_output.accumulate_gradient_batch(data, batch);
+		}
+
+		void add_gradient(
+			const _Self& other)
+		{
+			m_output.add_gradient(other.m_output);
+		}
+
+		void apply_gradient_batch(
+			const size_t batch,
+			value_type rate,
+			value_type regularization)
+		{
+			m_output.apply_gradient_batch(batch, rate, regularization);
+		}
+
+		void bind(value_type* pParameters)
+		{
+			m_output.bind(pParameters);
+		}
+
+		void initialize()
+		{
+			m_output.initialize();
+		}
+
+		const this_layer& get_layer() const
+		{
+			return m_output;
+		}
+
+	private:
+		this_layer m_output;
+	};
+
+	// Variadic template for a feed-forward neural network
+	// that is trained using backpropagation algorithm, with the
+	// activation functions of the hidden layers and of the output
+	// layer selected at compile time.
+	//
+	// Weights and biases of all layers are kept in one parameter arena,
+	// layer after layer. Snapshots of the parameters, copies of networks
+	// and passes over all parameters work on a single block of memory.
+	//
+	// Sample usage:
+	//		machine_learning::basic_neural_network<
+	//			machine_learning::hyperbolic_tangent,
+	//			machine_learning::logistic,
+	//			D3, D6, D1> network;
+	//
+	template <class _Activation, class _OutputActivation, class _L1, class _L2, class... _Args>
+	class basic_neural_network : protected _network_impl<_Activation, _OutputActivation, _L1, _L2, _Args...>
+	{
+	public:
+		typedef typename basic_neural_network<_Activation, _OutputActivation, _L1, _L2, _Args...> _Self;
+		typedef typename _network_impl<_Activation, _OutputActivation, _L1, _L2, _Args...> _Base;
+		typedef typename _Base::input input;
+		typedef typename _Base::output output;
+		typedef typename _Base::value_type value_type;
+
+		// Number of values in the parameter arena, including padding
+		// between the layers.
+		static const size_t parameter_count = _Base::parameter_count;
+
+		basic_neural_network()
+			: _Base(), m_parameters(parameter_count), m_batch_input(), m_batch_target()
+		{
+			_Base::bind(m_parameters.data());
+			_Base::initialize();
+		}
+
+		basic_neural_network(const _Self& other)
+			: _Base(other), m_parameters(other.m_parameters), m_batch_input(other.m_batch_input), m_batch_target(other.m_batch_target)
+		{
+			_Base::bind(m_parameters.data());
+		}
+
+		basic_neural_network(_Self&& other)
+			: _Base(std::move(other)), m_parameters(std::move(other.m_parameters)), m_batch_input(std::move(other.m_batch_input)), m_batch_target(std::move(other.m_batch_target))
+		{
+			_Base::bind(m_parameters.data());
+		}
+
+		_Self& operator=(const _Self& other)
+		{
+			if (this != std::addressof(other))
+			{
+				_Base::operator=(other);
+				m_parameters = other.m_parameters;
+				m_batch_input = other.m_batch_input;
+				m_batch_target = other.m_batch_target;
+
+				_Base::bind(m_parameters.data());
+			}
+
+			return (*this);
+		}
+
+		_Self& operator=(_Self&& other)
+		{
+			if (this != std::addressof(other))
+			{
+				_Base::operator=(std::move(other));
+				m_parameters = std::move(other.m_parameters);
+				m_batch_input = std::move(other.m_batch_input);
+				m_batch_target = std::move(other.m_batch_target);
+
+				_Base::bind(m_parameters.data());
+			}
+
+			return (*this);
+		}
+
+		// All weights and biases of the network, see parameter_count.
+		// The values can be copied to take a snapshot of the network,
+		// and copied back to restore it.
+		value_type* parameters()
+		{
+			return m_parameters.data();
+		}
+
+		const value_type* parameters() const
+		{
+			return m_parameters.data();
+		}
+
+		// Per-thread storage for the intermediate results of the const
+		// process() overload. A workspace is allocated on first use and
+		// reused by later calls, so inference does not allocate memory.
+		typedef typename _Base::workspace workspace;
+
+		// Per-thread storage for the intermediate results of a training
+		// step of the reentrant train() overload.
+		typedef typename _Base::training_workspace training_workspace;
+
+		const output& process(
+			const input& data)
+		{
+			return _Base::process(data, false);
+		}
+
+		// Reentrant inference. The network is not modified, so threads
+		// may share one network without locking, as long as every thread
+		// uses its own workspace and no thread trains the network.
+		//
+		// Sample usage:
+		//		machine_learning::neural_network<D3, D6, D1>::workspace context;
+		//		auto& out = network.process(data, context);
+		//
+		const output& process(
+			const input& data,
+			workspace& context) const
+		{
+			return _Base::process(data, context);
+		}
+
+		void train(const input& data,
+			const output& target,
+			value_type rate,
+			value_type regularization = 0.000001)
+		{
+			// First, recursively process input through all layers.
+			// Training mode enables caching of important intermediate
+			// values which are used late.
+			_Base::process(data, true);
+
+			// Then recursively compute gradient, propagate it in backward
+			// direction and update the costs of all layers on the way.
+			// Make sure that correct learning and regularization rate values are used.
+			rate = -std::abs(rate);
+			regularization = std::abs(regularization);
+			_Base::backward(data, target, nullptr, rate, regularization);
+		}
+
+		// Reentrant training step for asynchronous stochastic gradient
+		// descent. Threads may call it concurrently on one network, each
+		// with its own workspace. Weights are updated without locking,
+		// so concurrent updates of a weight may be lost or may use
+		// slightly stale weights; see hogwild_trainer.
+		void train(const input& data,
+			const output& target,
+			training_workspace& context,
+			value_type rate,
+			value_type regularization = 0.000001)
+		{
+			_Base::process(data, context);
+
+			rate = -std::abs(rate);
+			regularization = std::abs(regularization);
+			_Base::backward(data, target, context, nullptr, rate, regularization);
+		}
+
+		// Processes a batch of inputs with one sample per row, and writes
+		// the outputs to the rows of result. All layers use the fused
+		// forward kernel on buffers that are allocated once and reused.
+		template <class _Batch>
+		const algebra::matrix<_Batch, typename output::dimension>& process(
+			const algebra::matrix<_Batch, typename input::dimension>& data,
+			algebra::matrix<_Batch, typename output::dimension>& result)
+		{
+			_Copy(data, m_batch_input);
+
+			const value_type* pOutput = _Base::process_batch(m_batch_input.data(), _Batch::rank);
+
+			for (size_t row = 0; row < _Batch::rank; ++row)
+			{
+				for (size_t col = 0; col < output::rank; ++col)
+				{
+					result(row, col) = pOutput[row * output::rank + col];
+				}
+			}
+
+			return result;
+		}
+
+		// Trains the network on a mini-batch with one sample per row of
+		// data and target. The weights are updated once per batch with
+		// the average of the updates train() would compute for every
+		// sample using the weights from before the batch.
+		template <class _Batch>
+		void train_batch(
+			const algebra::matrix<_Batch, typename input::dimension>& data,
+			const algebra::matrix<_Batch, typename output::dimension>& target,
+			value_type rate,
+			value_type regularization = 0.000001)
+		{
+			_Copy(data, m_batch_input);
+			_Copy(target, m_batch_target);
+
+			_Base::process_batch(m_batch_input.data(), _Batch::rank);
+
+			rate = -std::abs(rate);
+			regularization = std::abs(regularization);
+			_Base::backward_batch(m_batch_input.data(), m_batch_target.data(), _Batch::rank, nullptr, rate, regularization);
+		}
+
+		// Computes the gradient of the cost function for one sample with
+		// respect to all weights and biases, without changing them. The
+		// gradient is written to pGradient in the layout of parameters(),
+		// which must hold parameter_count values. Padding is not written.
+		// train() is equivalent to subtracting rate times the gradient.
+		void gradient(const input& data,
+			const output& target,
+			value_type* pGradient,
+			value_type regularization = 0.000001)
+		{
+			_Base::process(data, true);
+			_Base::gradient(data, target, nullptr, pGradient, std::abs(regularization));
+		}
+
+		// Computes the average gradient of a mini-batch, see gradient()
+		// and train_batch().
+		template <class _Batch>
+		void gradient_batch(
+			const algebra::matrix<_Batch, typename input::dimension>& data,
+			const algebra::matrix<_Batch, typename output::dimension>& target,
+			value_type* pGradient,
+			value_type regularization = 0.000001)
+		{
+			_Copy(data, m_batch_input);
+			_Copy(target, m_batch_target);
+
+			_Base::process_batch(m_batch_input.data(), _Batch::rank);
+			_Base::gradient_batch(m_batch_input.data(), m_batch_target.data(), _Batch::rank, nullptr, pGradient, std::abs(regularization));
+		}
+
+	private:
+		template <class M, class N>
+		static void _Copy(
+			const algebra::matrix<M, N>& m,
+			std::vector<value_type>& dest)
+		{
+			dest.resize(M::rank * N::rank);
+
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t col = 0; col < N::rank; ++col)
+				{
+					dest[row * N::rank + col] = m(row, col);
+				}
+			}
+		}
+
+	private:
+		template <class _Network>
+		friend class data_parallel_trainer;
+
+		parameter_arena m_parameters;
+		std::vector<value_type> m_batch_input;
+		std::vector<value_type> m_batch_target;
+	};
+
+	// Feed-forward neural network with the logistic activation function
+	// in all layers.
+	template <class _L1, class _L2, class... _Args>
+	class neural_network : public basic_neural_network<logistic, logistic, _L1, _L2, _Args...>
+	{
+	};
+
+	// Feed-forward neural network for classification, with logistic
+	// hidden layers and a softmax output layer trained with the
+	// cross-entropy cost. Outputs are probabilities of the classes and
+	// targets are one-hot vectors or other probability distributions.
+	//
+	// Sample usage:
+	//		machine_learning::classification_network<D784, D49, D10> network;
+	//		network.train(digit, one_hot, 0.05);
+	//
+	template <class _L1, class _L2, class... _Args>
+	class classification_network : public basic_neural_network<logistic, softmax_cross_entropy, _L1, _L2, _Args...>
+	{
+	};
+
+	// Runs func(0), ..., func(count - 1) on the pool and waits for all of
+	// them. Calls from a worker of the pool run inline, since waiting there
+	// could block the worker which has to run them. If calls throw, all
+	// calls still finish and the first exception is rethrown on the
+	// calling thread.
+	template <class _Func>
+	void _parallel_for(
+		algebra::thread_pool& pool,
+		const size_t count,
+		const _Func& func)
+	{
+		if (count < 2 || pool.is_worker())
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				func(i);
+			}
+
+			return;
+		}
+
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t remaining = count;
+		std::exception_ptr error;
+
+		// Counts a call as finished however it ends, so the waiting
+		// thread is always woken up.
+		struct _finish
+		{
+			std::mutex& mutex;
+			std::condition_variable& done;
+			size_t& remaining;
+			const size_t calls;
+
+			~_finish()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				remaining -= calls;
+				if (0 == remaining)
+				{
+					done.notify_one();
+				}
+			}
+		};
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			try
+			{
+				pool.submit([&, i]()
+				{
+					_finish finish = { mutex, done, remaining, 1 };
+
+					try
+					{
+						func(i);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						if (nullptr == error)
+						{
+							error = std::current_exception();
+						}
+					}
+				});
+			}
+			catch (...)
+			{
+				// Calls which were not submitted are finished, but the
+				// submitted ones still use the state of this frame.
+				{
+					_finish finish = { mutex, done, remaining, count - i };
+				}
+
+				std::unique_lock<std::mutex> lock(mutex);
+				done.wait(lock, [&remaining]() { return 0 == remaining; });
+				throw;
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&remaining]() { return 0 == remaining; });
+
+		if (nullptr != error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Synchronous data-parallel training of a neural network.
+	//
+	// Every mini-batch is split into chunks of consecutive samples. Each
+	// chunk is processed by a replica of the network on a worker of the
+	// thread pool, which computes the gradients of its samples. Replicas
+	// copy the parameter arena of the network before every batch. The
+	// gradients of the replicas are summed pairwise in a binary tree and
+	// applied to the network with a single update, which is equal to
+	// train_batch() on the whole batch up to rounding.
+	//
+	// By default a batch is split into one chunk per worker, so the
+	// rounding depends on the size of the pool. A fixed number of chunks
+	// makes the order of all sums fixed, and the results are reproducible
+	// for any number of threads.
+	//
+	// Sample usage:
+	//		machine_learning::neural_network<D3, D6, D1> network;
+	//		machine_learning::data_parallel_trainer<decltype(network)> trainer(network);
+	//		trainer.train(data, target, 0.05);
+	//
+	template <class _Network>
+	class data_parallel_trainer
+	{
+	public:
+		typedef data_parallel_trainer<_Network> _Self;
+		typedef typename _Network::_Base _Impl;
+		typedef typename _Network::input input;
+		typedef typename _Network::output output;
+		typedef typename _Network::value_type value_type;
+
+		explicit data_parallel_trainer(
+			_Network& network,
+			algebra::thread_pool& pool = algebra::default_pool(),
+			const size_t chunks = 0)
+			: m_network(network), m_pool(pool), m_chunks(chunks), m_replicas()
+		{}
+
+		data_parallel_trainer(const _Self&) = delete;
+		_Self& operator=(const _Self&) = delete;
+
+		template <class _Batch>
+		void train(
+			const algebra::matrix<_Batch, typename input::dimension>& data,
+			const algebra::matrix<_Batch, typename output::dimension>& target,
+			value_type rate,
+			value_type regularization = 0.000001)
+		{
+			_Network::_Copy(data, m_input);
+			_Network::_Copy(target, m_target);
+
+			const size_t batch = _Batch::rank;
+			const size_t requested = (0 < m_chunks) ? m_chunks : m_pool.size();
+			const size_t chunks = (requested < batch) ? requested : batch;
+
+			while (m_replicas.size() < chunks)
+			{
+				m_replicas.push_back(m_network);
+			}
+
+			// Every replica starts from the current weights and computes
+			// the gradient sums of its own samples.
+			_parallel_for(m_pool, chunks, [&](const size_t chunk)
+			{
+				const size_t first = chunk * batch / chunks;
+				const size_t count = (chunk + 1) * batch / chunks - first;
+
+				const value_type* pData = m_input.data() + first * input::rank;
+				const value_type* pTarget = m_target.data() + first * output::rank;
+
+				// Parameters of a network are contiguous, so a replica is
+				// brought up to date with a single copy.
+				std::memcpy(
+					m_replicas[chunk].parameters(),
+					m_network.parameters(),
+					_Network::parameter_count * sizeof(value_type));
+
+				_Impl& replica = m_replicas[chunk];
+				replica.process_batch(pData, count);
+				replica.compute_delta_batch(pTarget, count);
+				replica.accumulate_gradient_batch(pData, count);
+			});
+
+			// Tree reduction: on every level, replica i adds the sums of
+			// replica i + step. The pairs of a level are independent.
+			for (size_t step = 1; step < chunks; step *= 2)
+			{
+				const size_t pairs = (chunks - step + 2 * step - 1) / (2 * step);
+
+				_parallel_for(m_pool, pairs, [&](const size_t pair)
+				{
+					const size_t index = pair * 2 * step;
+					static_cast<_Impl&>(m_replicas[index]).add_gradient(m_replicas[index + step]);
+				});
+			}
+
+			// The first replica holds the sums of the whole batch.
+			rate = -std::abs(rate);
+			regularization = std::abs(regularization);
+			_Impl& first = m_replicas[0];
+			first.apply_gradient_batch(batch, rate, regularization);
+
+			std::memcpy(
+				m_network.parameters(),
+				m_replicas[0].parameters(),
+				_Network::parameter_count * sizeof(value_type));
+		}
+
+	private:
+		_Network& m_network;
+		algebra::thread_pool& m_pool;
+		size_t m_chunks;
+		std::vector<_Network> m_replicas;
+		std::vector<value_type> m_input;
+		std::vector<value_type> m_target;
+	};
+
+	// Asynchronous (Hogwild) stochastic gradient descent.
+	//
+	// The samples of an epoch are split into one range per worker of the
+	// thread pool. Every worker trains the shared network on its samples
+	// one at a time, with its own workspace and without any locking or
+	// barriers. Updates of different threads may overlap and overwrite
+	// each other. This is tolerated well when most updates are sparse,
+	// e.g. with one-hot encoded inputs, where only weights of non-zero
+	// inputs are written.
+	//
+	// Sample usage:
+	//		machine_learning::neural_network<D8, D7, D3> network;
+	//		machine_learning::hogwild_trainer<decltype(network)> trainer(network);
+	//		trainer.train(inputs, targets, 0.6);
+	//
+	template <class _Network>
+	class hogwild_trainer
+	{
+	public:
+		typedef hogwild_trainer<_Network> _Self;
+		typedef typename _Network::input input;
+		typedef typename _Network::output output;
+		typedef typename _Network::value_type value_type;
+		typedef typename _Network::training_workspace training_workspace;
+
+		explicit hogwild_trainer(
+			_Network& network,
+			algebra::thread_pool& pool = algebra::default_pool())
+			: m_network(network), m_pool(pool), m_workspaces()
+		{}
+
+		hogwild_trainer(const _Self&) = delete;
+		_Self& operator=(const _Self&) = delete;
+
+		// Trains the network once on every sample.
+		void train(
+			const std::vector<input>& data,
+			const std::vector<output>& target,
+			const value_type rate,
+			const value_type regularization = 0.000001)
+		{
+			if (data.size() != target.size())
+				throw std::invalid_argument("Number of targets does not match number of samples.");
+
+			const size_t count = data.size();
+			const size_t threads = (m_pool.size() < count) ? m_pool.size() : count;
+
+			if (m_workspaces.size() < threads)
+			{
+				m_workspaces.resize(threads);
+			}
+
+			_parallel_for(m_pool, threads, [&](const size_t thread)
+			{
+				training_workspace& context = m_workspaces[thread];
+
+				const size_t last = (thread + 1) * count / threads;
+				for (size_t i = thread * count / threads; i < last; ++i)
+				{
+					m_network.train(data[i], target[i], context, rate, regularization);
+				}
+			});
+		}
+
+	private:
+		_Network& m_network;
+		algebra::thread_pool& m_pool;
+		std::vector<training_workspace> m_workspaces;
+	};
+
+	// Optimizers update all parameters of a network from a gradient in
+	// the layout of the parameter arena, see basic_neural_network::gradient().
+	// Their state is kept in arenas of the same layout, so every update is
+	// a single sequential pass over the parameters, the gradient and the
+	// state. Padding between the layers has zero gradient and stays zero.
+	//
+	// An optimizer is used by one network at a time, see optimizing_trainer.
+
+	// Plain stochastic gradient descent, the update of train().
+	class gradient_descent
+	{
+	public:
+		typedef double value_type;
+
+		explicit gradient_descent(
+			const value_type rate = 0.05)
+			: m_rate(rate)
+		{}
+
+		value_type rate() const
+		{
+			return m_rate;
+		}
+
+		void set_rate(const value_type rate)
+		{
+			m_rate = rate;
+		}
+
+		void update(
+			value_type* pParameters,
+			const value_type* pGradient,
+			const size_t count)
+		{
+			const value_type rate = m_rate;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				pParameters[i] -= pGradient[i] * rate;
+			}
+		}
+
+	private:
+		value_type m_rate;
+	};
+
+	// Gradient descent with momentum. The velocity accumulates past
+	// updates, which speeds up progress along directions of consistent
+	// gradient and damps oscillations.
+	class momentum
+	{
+	public:
+		typedef double value_type;
+
+		explicit momentum(
+			const value_type rate = 0.05,
+			const value_type coefficient = 0.9)
+			: m_rate(rate), m_coefficient(coefficient), m_velocity(0)
+		{}
+
+		value_type rate() const
+		{
+			return m_rate;
+		}
+
+		void set_rate(const value_type rate)
+		{
+			m_rate = rate;
+		}
+
+		void update(
+			value_type* pParameters,
+			const value_type* pGradient,
+			const size_t count)
+		{
+			if (m_velocity.size() != count)
+			{
+				m_velocity = parameter_arena(count);
+			}
+
+			const value_type rate = m_rate;
+			const value_type mu = m_coefficient;
+			value_type* pVelocity = m_velocity.data();
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				pVelocity[i] = mu * pVelocity[i] - rate * pGradient[i];
+				pParameters[i] += pVelocity[i];
+			}
+		}
+
+	private:
+		value_type m_rate;
+		value_type m_coefficient;
+		parameter_arena m_velocity;
+	};
+
+	// Nesterov accelerated gradient. Same as momentum, but the step is
+	// corrected by the change of the velocity, which approximates the
+	// gradient at the point the momentum is about to move to.
+	class nesterov_momentum
+	{
+	public:
+		typedef double value_type;
+
+		explicit nesterov_momentum(
+			const value_type rate = 0.05,
+			const value_type coefficient = 0.9)
+			: m_rate(rate), m_coefficient(coefficient), m_velocity(0)
+		{}
+
+		value_type rate() const
+		{
+			return m_rate;
+		}
+
+		void set_rate(const value_type rate)
+		{
+			m_rate = rate;
+		}
+
+		void update(
+			value_type* pParameters,
+			const value_type* pGradient,
+			const size_t count)
+		{
+			if (m_velocity.size() != count)
+			{
+				m_velocity = parameter_arena(count);
+			}
+
+			const value_type rate = m_rate;
+			const value_type mu = m_coefficient;
+			value_type* pVelocity = m_velocity.data();
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const value_type previous = pVelocity[i];
+				pVelocity[i] = mu * previous - rate * pGradient[i];
+				pParameters[i] += (1.0 + mu) * pVelocity[i] - mu * previous;
+			}
+		}
+
+	private:
+		value_type m_rate;
+		value_type m_coefficient;
+		parameter_arena m_velocity;
+	};
+
+	// RMSProp. Every parameter has its own step size, the rate divided
+	// by a running average of the magnitude of its recent gradients.
+	class rmsprop
+	{
+	public:
+		typedef double value_type;
+
+		explicit rmsprop(
+			const value_type rate = 0.001,
+			const value_type decay = 0.9,
+			const value_type epsilon = 1e-8)
+			: m_rate(rate), m_decay(decay), m_epsilon(epsilon), m_square(0)
+		{}
+
+		value_type rate() const
+		{
+			return m_rate;
+		}
+
+		void set_rate(const value_type rate)
+		{
+			m_rate = rate;
+		}
+
+		void update(
+			value_type* pParameters,
+			const value_type* pGradient,
+			const size_t count)
+		{
+			if (m_square.size() != count)
+			{
+				m_square = parameter_arena(count);
+			}
+
+			const value_type rate = m_rate;
+			const value_type decay = m_decay;
+			const value_type epsilon = m_epsilon;
+			value_type* pSquare = m_square.data();
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const value_type g = pGradient[i];
+				pSquare[i] = decay * pSquare[i] + (1.0 - decay) * g * g;
+				pParameters[i] -= rate * g / (std::sqrt(pSquare[i]) + epsilon);
+			}
+		}
+
+	private:
+		value_type m_rate;
+		value_type m_decay;
+		value_type m_epsilon;
+		parameter_arena m_square;
+	};
+
+	// Adam. Combines momentum with the per-parameter step sizes of
+	// RMSProp, with bias correction of both running averages, which
+	// start at zero.
+	class adam
+	{
+	public:
+		typedef double value_type;
+
+		explicit adam(
+			const value_type rate = 0.001,
+			const value_type beta1 = 0.9,
+			const value_type beta2 = 0.999,
+			const value_type epsilon = 1e-8)
+			: m_rate(rate), m_beta1(beta1), m_beta2(beta2), m_epsilon(epsilon), m_step(0), m_mean(0), m_square(0)
+		{}
+
+		value_type rate() const
+		{
+			return m_rate;
+		}
+
+		void set_rate(const value_type rate)
+		{
+			m_rate = rate;
+		}
+
+		void update(
+			value_type* pParameters,
+			const value_type* pGradient,
+			const size_t count)
+		{
+			if (m_mean.size() != count)
+			{
+				m_mean = parameter_arena(count);
+				m_square = parameter_arena(count);
+				m_step = 0;
+			}
+
+			++m_step;
+
+			// Bias correction is the same for all parameters, so it is
+			// folded into the step size once per update.
+			const value_type beta1 = m_beta1;
+			const value_type beta2 = m_beta2;
+			const value_type epsilon = m_epsilon;
+			const value_type step = m_rate
+				* std::sqrt(1.0 - std::pow(beta2, (value_type)m_step))
+				/ (1.0 - std::pow(beta1, (value_type)m_step));
+
+			value_type* pMean = m_mean.data();
+			value_type* pSquare = m_square.data();
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const value_type g = pGradient[i];
+				pMean[i] = beta1 * pMean[i] + (1.0 - beta1) * g;
+				pSquare[i] = beta2 * pSquare[i] + (1.0 - beta2) * g * g;
+				pParameters[i] -= step * pMean[i] / (std::sqrt(pSquare[i]) + epsilon);
+			}
+		}
+
+	private:
+		value_type m_rate;
+		value_type m_beta1;
+		value_type m_beta2;
+		value_type m_epsilon;
+		size_t m_step;
+		parameter_arena m_mean;
+		parameter_arena m_square;
+	};
+
+	// Trains a network with an optimizer. Every training step computes
+	// the gradient of a sample or a mini-batch into an arena with the
+	// layout of the parameters, and lets the optimizer update all
+	// parameters in one pass.
+	//
+	// Sample usage:
+	//		machine_learning::neural_network<D3, D6, D1> network;
+	//		machine_learning::optimizing_trainer<decltype(network), machine_learning::adam> trainer(
+	//			network, machine_learning::adam(0.01));
+	//		trainer.train(data, target);
+	//
+	template <class _Network, class _Optimizer>
+	class optimizing_trainer
+	{
+	public:
+		typedef optimizing_trainer<_Network, _Optimizer> _Self;
+		typedef typename _Network::input input;
+		typedef typename _Network::output output;
+		typedef typename _Network::value_type value_type;
+
+		explicit optimizing_trainer(
+			_Network& network,
+			const _Optimizer& optimizer = _Optimizer())
+			: m_network(network), m_optimizer(optimizer), m_gradient(_Network::parameter_count)
+		{}
+
+		optimizing_trainer(const _Self&) = delete;
+		_Self& operator=(const _Self&) = delete;
+
+		_Optimizer& optimizer()
+		{
+			return m_optimizer;
+		}
+
+		void train(const input& data,
+			const output& target,
+			value_type regularization = 0.000001)
+		{
+			m_network.gradient(data, target, m_gradient.data(), regularization);
+			m_optimizer.update(m_network.parameters(), m_gradient.data(), _Network::parameter_count);
+		}
+
+		template <class _Batch>
+		void train(
+			const algebra::matrix<_Batch, typename input::dimension>& data,
+			const algebra::matrix<_Batch, typename output::dimension>& target,
+			value_type regularization = 0.000001)
+		{
+			m_network.gradient_batch(data, target, m_gradient.data(), regularization);
+			m_optimizer.update(m_network.parameters(), m_gradient.data(), _Network::parameter_count);
+		}
+
+	private:
+		_Network& m_network;
+		_Optimizer m_optimizer;
+		parameter_arena m_gradient;
 	};
 
 	// Utility template for a view projection of a vector into a 2D grid of values.
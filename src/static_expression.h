@@ -0,0 +1,250 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "expression.h"
+
+namespace algebra
+{
+namespace static_expressions
+{
+	// Static expressions encode the whole expression tree in its type.
+	// Nodes are held by value, so evaluation is a chain of direct calls
+	// the compiler can inline, without heap allocated evaluators.
+	//
+	// Sample usage:
+	//		auto v1 = algebra::expressions::declare<double>();
+	//		auto v2 = algebra::expressions::declare<double>();
+	//
+	//		auto e = 2.0 * (ref(v1) + v2);
+	//		double r = e.evaluate();
+	//
+	//		algebra::expressions::expression<double> dynamic = erase(e);
+	//
+	struct _node_base
+	{
+	};
+
+	template <class T>
+	struct is_node
+		: public std::is_base_of<_node_base, T>
+	{
+	};
+
+	// Leaf node reading the current value of a variable.
+	template <class T>
+	class terminal : public _node_base
+	{
+	public:
+		typedef T value_type;
+		typedef terminal<T> _Self;
+
+		explicit terminal(const expressions::variable<T>& var)
+			: m_variable(var)
+		{
+		}
+
+		const value_type& evaluate() const
+		{
+			return m_variable.value();
+		}
+
+	private:
+		expressions::variable<T> m_variable;
+	};
+
+	// Leaf node holding a value captured when the expression is built.
+	template <class T>
+	class constant : public _node_base
+	{
+	public:
+		typedef T value_type;
+		typedef constant<T> _Self;
+
+		explicit constant(const value_type& value)
+			: m_value(value)
+		{
+		}
+
+		const value_type& evaluate() const
+		{
+			return m_value;
+		}
+
+	private:
+		value_type m_value;
+	};
+
+	template <class _Op, class _Arg>
+	class unary_node : public _node_base
+	{
+	public:
+		typedef typename std::decay<decltype(
+			std::declval<_Op>()(std::declval<const typename _Arg::value_type&>()))>::type value_type;
+		typedef unary_node<_Op, _Arg> _Self;
+
+		explicit unary_node(const _Arg& arg)
+			: m_arg(arg)
+		{
+		}
+
+		value_type evaluate() const
+		{
+			return _Op()(m_arg.evaluate());
+		}
+
+		const _Arg& arg() const
+		{
+			return m_arg;
+		}
+
+	private:
+		_Arg m_arg;
+	};
+
+	template <class _Op, class _Left, class _Right>
+	class binary_node : public _node_base
+	{
+	public:
+		typedef typename std::decay<decltype(
+			std::declval<_Op>()(
+				std::declval<const typename _Left::value_type&>(),
+				std::declval<const typename _Right::value_type&>()))>::type value_type;
+		typedef binary_node<_Op, _Left, _Right> _Self;
+
+		binary_node(const _Left& left, const _Right& right)
+			: m_left(left), m_right(right)
+		{
+		}
+
+		value_type evaluate() const
+		{
+			return _Op()(m_left.evaluate(), m_right.evaluate());
+		}
+
+		const _Left& left() const
+		{
+			return m_left;
+		}
+
+		const _Right& right() const
+		{
+			return m_right;
+		}
+
+	private:
+		_Left m_left;
+		_Right m_right;
+	};
+
+	using expressions::_plus;
+	using expressions::_minus;
+	using expressions::_multiplies;
+	using expressions::_transpose;
+
+	// Maps an operand of a static expression operator to its node type:
+	// nodes are used as is, variables become terminals and arithmetic
+	// values become constants.
+	template <class T, class _Enable = void>
+	struct _operand
+	{
+	};
+
+	template <class T>
+	struct _operand<T, typename std::enable_if<is_node<T>::value>::type>
+	{
+		typedef T type;
+
+		static const type& wrap(const T& node)
+		{
+			return node;
+		}
+	};
+
+	template <class T>
+	struct _operand<expressions::variable<T>, void>
+	{
+		typedef terminal<T> type;
+
+		static type wrap(const expressions::variable<T>& var)
+		{
+			return type(var);
+		}
+	};
+
+	template <class T>
+	struct _operand<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+	{
+		typedef constant<T> type;
+
+		static type wrap(const T& value)
+		{
+			return type(value);
+		}
+	};
+
+	template <class _Op, class L, class R>
+	struct _binary_result
+	{
+		typedef binary_node<_Op, typename _operand<L>::type, typename _operand<R>::type> type;
+	};
+
+	template <class L, class R>
+	struct _is_operation
+		: public std::integral_constant<bool, is_node<L>::value || is_node<R>::value>
+	{
+	};
+
+	template <class T>
+	terminal<T> ref(const expressions::variable<T>& var)
+	{
+		return terminal<T>(var);
+	}
+
+	template <class L, class R>
+	typename std::enable_if<_is_operation<L, R>::value, typename _binary_result<_plus, L, R>::type>::type operator+ (
+		const L& left,
+		const R& right)
+	{
+		return typename _binary_result<_plus, L, R>::type(
+			_operand<L>::wrap(left), _operand<R>::wrap(right));
+	}
+
+	template <class L, class R>
+	typename std::enable_if<_is_operation<L, R>::value, typename _binary_result<_minus, L, R>::type>::type operator- (
+		const L& left,
+		const R& right)
+	{
+		return typename _binary_result<_minus, L, R>::type(
+			_operand<L>::wrap(left), _operand<R>::wrap(right));
+	}
+
+	template <class L, class R>
+	typename std::enable_if<_is_operation<L, R>::value, typename _binary_result<_multiplies, L, R>::type>::type operator* (
+		const L& left,
+		const R& right)
+	{
+		return typename _binary_result<_multiplies, L, R>::type(
+			_operand<L>::wrap(left), _operand<R>::wrap(right));
+	}
+
+	template <class _Arg>
+	typename std::enable_if<is_node<_Arg>::value, unary_node<_transpose, _Arg>>::type transpose(
+		const _Arg& arg)
+	{
+		return unary_node<_transpose, _Arg>(arg);
+	}
+
+	// Converts a static expression to the type erased expression<T>
+	// for use where runtime polymorphism is needed. The whole static
+	// tree becomes a single evaluator.
+	template <class _Node>
+	typename std::enable_if<is_node<_Node>::value, expressions::expression<typename _Node::value_type>>::type erase(
+		const _Node& node)
+	{
+		return expressions::expression<typename _Node::value_type>(
+			[node]() { return node.evaluate(); });
+	}
+}
+}
@@ -0,0 +1,971 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+#include "declaration.h"
+#include "matrix.h"
+
+namespace algebra
+{
+	// Square diagonal matrix, which keeps only values of the main diagonal.
+	template <class N>
+	class diagonal_matrix
+	{
+	public:
+		typedef diagonal_matrix<N> _Self;
+		typedef N row_dimension;
+		typedef N column_dimension;
+		static const size_t rank = N::rank;
+		static const size_t row_rank = N::rank;
+		static const size_t column_rank = N::rank;
+
+		static_assert(std::is_base_of<dimension<rank>, N>::value, "Type parameter N must be a dimension.");
+
+		typedef double value_type;
+
+		diagonal_matrix()
+			: m_values(_Self::rank, number_traits<value_type>::zero())
+		{
+		}
+
+		diagonal_matrix(std::initializer_list<value_type> data)
+			: m_values()
+		{
+			if (data.size() != _Self::rank)
+				throw std::invalid_argument("Initializer size does not match matrix rank.");
+
+			m_values.assign(data.begin(), data.end());
+		}
+
+		explicit diagonal_matrix(const vector<N>& diagonal)
+			: m_values(diagonal.cbegin(), diagonal.cend())
+		{
+		}
+
+		const value_type& operator() (
+			const size_t row,
+			const size_t column) const
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+
+			if (row != column)
+			{
+				static const value_type zero = number_traits<value_type>::zero();
+				return zero;
+			}
+
+			return m_values[row];
+		}
+
+		value_type& operator() (
+			const size_t row,
+			const size_t column)
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+			if (row != column)
+				throw std::invalid_argument("Element is outside of the matrix diagonal.");
+
+			return m_values[row];
+		}
+
+		matrix<N, N> dense() const
+		{
+			matrix<N, N> result;
+			for (size_t i = 0; i < _Self::rank; ++i)
+			{
+				result(i, i) = m_values[i];
+			}
+
+			return result;
+		}
+
+		const std::vector<value_type>& values() const
+		{
+			return m_values;
+		}
+
+	private:
+		std::vector<value_type> m_values;
+	};
+
+	// Square triangular matrix, which keeps only values of the upper or lower
+	// triangle packed row by row into a single buffer.
+	template <class N, const bool _Upper>
+	class triangular_matrix
+	{
+	public:
+		typedef triangular_matrix<N, _Upper> _Self;
+		typedef N row_dimension;
+		typedef N column_dimension;
+		static const size_t rank = N::rank;
+		static const size_t row_rank = N::rank;
+		static const size_t column_rank = N::rank;
+		static const bool upper = _Upper;
+
+		static_assert(std::is_base_of<dimension<rank>, N>::value, "Type parameter N must be a dimension.");
+
+		typedef double value_type;
+
+		triangular_matrix()
+			: m_values(_Self::rank * (_Self::rank + 1) / 2, number_traits<value_type>::zero())
+		{
+		}
+
+		// Initializes triangular matrix from the corresponding triangle of the dense matrix.
+		explicit triangular_matrix(const matrix<N, N>& m)
+			: m_values(_Self::rank * (_Self::rank + 1) / 2, number_traits<value_type>::zero())
+		{
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = _Self::first(row); col < _Self::last(row); ++col)
+				{
+					m_values[_Self::offset(row, col)] = m(row, col);
+				}
+			}
+		}
+
+		const value_type& operator() (
+			const size_t row,
+			const size_t column) const
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+
+			if (column < _Self::first(row) || column >= _Self::last(row))
+			{
+				static const value_type zero = number_traits<value_type>::zero();
+				return zero;
+			}
+
+			return m_values[_Self::offset(row, column)];
+		}
+
+		value_type& operator() (
+			const size_t row,
+			const size_t column)
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+			if (column < _Self::first(row) || column >= _Self::last(row))
+				throw std::invalid_argument("Element is outside of the matrix triangle.");
+
+			return m_values[_Self::offset(row, column)];
+		}
+
+		matrix<N, N> dense() const
+		{
+			matrix<N, N> result;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = _Self::first(row); col < _Self::last(row); ++col)
+				{
+					result(row, col) = m_values[_Self::offset(row, col)];
+				}
+			}
+
+			return result;
+		}
+
+		// First column of the stored part of the row.
+		static size_t first(const size_t row)
+		{
+			return _Upper ? row : 0;
+		}
+
+		// Column past the last one in the stored part of the row.
+		static size_t last(const size_t row)
+		{
+			return _Upper ? _Self::rank : row + 1;
+		}
+
+		// Pointer to the value of the first stored column of the row. Values
+		// of the same row are stored contiguously.
+		const value_type* row_data(const size_t row) const
+		{
+			return m_values.data() + _Self::offset(row, _Self::first(row));
+		}
+
+	private:
+		static size_t offset(
+			const size_t row,
+			const size_t column)
+		{
+			// Upper triangle stores (rank - i) values in row i, lower triangle stores (i + 1) values.
+			return _Upper
+				? row * _Self::rank - row * (row - 1) / 2 + (column - row)
+				: row * (row + 1) / 2 + column;
+		}
+
+		std::vector<value_type> m_values;
+	};
+
+	template <class N>
+	using upper_triangular_matrix = triangular_matrix<N, true>;
+
+	template <class N>
+	using lower_triangular_matrix = triangular_matrix<N, false>;
+
+	// Square symmetric matrix, which keeps only values of the upper triangle.
+	template <class N>
+	class symmetric_matrix
+	{
+	public:
+		typedef symmetric_matrix<N> _Self;
+		typedef N row_dimension;
+		typedef N column_dimension;
+		static const size_t rank = N::rank;
+		static const size_t row_rank = N::rank;
+		static const size_t column_rank = N::rank;
+
+		static_assert(std::is_base_of<dimension<rank>, N>::value, "Type parameter N must be a dimension.");
+
+		typedef double value_type;
+
+		symmetric_matrix()
+			: m_values(_Self::rank * (_Self::rank + 1) / 2, number_traits<value_type>::zero())
+		{
+		}
+
+		// Initializes symmetric matrix from the upper triangle of the dense matrix.
+		explicit symmetric_matrix(const matrix<N, N>& m)
+			: m_values(_Self::rank * (_Self::rank + 1) / 2, number_traits<value_type>::zero())
+		{
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = row; col < _Self::rank; ++col)
+				{
+					m_values[_Self::offset(row, col)] = m(row, col);
+				}
+			}
+		}
+
+		const value_type& operator() (
+			const size_t row,
+			const size_t column) const
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+
+			return m_values[_Self::offset(std::min(row, column), std::max(row, column))];
+		}
+
+		value_type& operator() (
+			const size_t row,
+			const size_t column)
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+
+			return m_values[_Self::offset(std::min(row, column), std::max(row, column))];
+		}
+
+		// Symmetric rank-k update (SYRK): C = alpha * A * A^T + beta * C.
+		// Rows of A are contiguous, so each value is a dot product of two rows.
+		template <class K>
+		_Self& rank_update(
+			const matrix<N, K>& a,
+			const value_type alpha = 1.0,
+			const value_type beta = 1.0)
+		{
+			std::vector<value_type> rows(_Self::rank * K::rank, number_traits<value_type>::zero());
+			if (false == a.empty())
+			{
+				for (size_t row = 0; row < _Self::rank; ++row)
+				{
+					std::copy(a.crow_begin(row), a.crow_end(row), rows.begin() + row * K::rank);
+				}
+			}
+
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				const value_type* pRow = rows.data() + row * K::rank;
+				for (size_t col = row; col < _Self::rank; ++col)
+				{
+					const value_type* pCol = rows.data() + col * K::rank;
+
+					value_type& value = m_values[_Self::offset(row, col)];
+					value = beta * value + alpha * std::inner_product(pRow, pRow + K::rank, pCol, number_traits<value_type>::zero());
+				}
+			}
+
+			return (*this);
+		}
+
+		// Symmetric rank-k update (SYRK) for transposed input: C = alpha * A^T * A + beta * C.
+		// Each row of A contributes a rank-1 update, so A is traversed once in memory order.
+		// This is the usual way to compute covariance from a matrix of samples.
+		template <class K>
+		_Self& rank_update_transposed(
+			const matrix<K, N>& a,
+			const value_type alpha = 1.0,
+			const value_type beta = 1.0)
+		{
+			std::transform(m_values.cbegin(), m_values.cend(), m_values.begin(),
+				[beta](const value_type& v) { return v * beta; });
+
+			if (a.empty())
+				return (*this);
+
+			std::vector<value_type> values(_Self::rank);
+			for (size_t k = 0; k < K::rank; ++k)
+			{
+				std::copy(a.crow_begin(k), a.crow_end(k), values.begin());
+
+				value_type* pValue = m_values.data();
+				for (size_t row = 0; row < _Self::rank; ++row)
+				{
+					const value_type factor = alpha * values[row];
+					for (size_t col = row; col < _Self::rank; ++col)
+					{
+						*(pValue++) += factor * values[col];
+					}
+				}
+			}
+
+			return (*this);
+		}
+
+		matrix<N, N> dense() const
+		{
+			matrix<N, N> result;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = row; col < _Self::rank; ++col)
+				{
+					result(row, col) = m_values[_Self::offset(row, col)];
+					result(col, row) = m_values[_Self::offset(row, col)];
+				}
+			}
+
+			return result;
+		}
+
+		// Pointer to the values of the row of upper triangle starting from the diagonal.
+		const value_type* row_data(const size_t row) const
+		{
+			return m_values.data() + _Self::offset(row, row);
+		}
+
+	private:
+		static size_t offset(
+			const size_t row,
+			const size_t column)
+		{
+			return row * _Self::rank - row * (row - 1) / 2 + (column - row);
+		}
+
+		std::vector<value_type> m_values;
+	};
+
+	// Utility function to compute symmetric matrix C = A * A^T.
+	template <class N, class K>
+	symmetric_matrix<N> syrk(const matrix<N, K>& a)
+	{
+		symmetric_matrix<N> result;
+		result.rank_update(a, 1.0, 0.0);
+		return result;
+	}
+
+	// Square band matrix with KL diagonals below and KU diagonals above the main diagonal.
+	// Values of each row are kept in a fixed size slot of (KL + KU + 1) values.
+	template <class N, const size_t KL, const size_t KU>
+	class banded_matrix
+	{
+	public:
+		typedef banded_matrix<N, KL, KU> _Self;
+		typedef N row_dimension;
+		typedef N column_dimension;
+		static const size_t rank = N::rank;
+		static const size_t row_rank = N::rank;
+		static const size_t column_rank = N::rank;
+		static const size_t lower_bandwidth = KL;
+		static const size_t upper_bandwidth = KU;
+		static const size_t width = KL + KU + 1;
+
+		static_assert(std::is_base_of<dimension<rank>, N>::value, "Type parameter N must be a dimension.");
+		// A matrix of rank one is accepted with any bandwidth, so that the
+		// degenerate tridiagonal matrix of a single value is valid.
+		static_assert((KL < N::rank && KU < N::rank) || 1 == N::rank, "Bandwidth must be smaller than the matrix rank.");
+
+		typedef double value_type;
+
+		banded_matrix()
+			: m_values(_Self::rank * _Self::width, number_traits<value_type>::zero())
+		{
+		}
+
+		// Initializes band matrix from the band of the dense matrix.
+		explicit banded_matrix(const matrix<N, N>& m)
+			: m_values(_Self::rank * _Self::width, number_traits<value_type>::zero())
+		{
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = _Self::first(row); col < _Self::last(row); ++col)
+				{
+					m_values[_Self::offset(row, col)] = m(row, col);
+				}
+			}
+		}
+
+		const value_type& operator() (
+			const size_t row,
+			const size_t column) const
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+
+			if (column < _Self::first(row) || column >= _Self::last(row))
+			{
+				static const value_type zero = number_traits<value_type>::zero();
+				return zero;
+			}
+
+			return m_values[_Self::offset(row, column)];
+		}
+
+		value_type& operator() (
+			const size_t row,
+			const size_t column)
+		{
+			if (column >= _Self::rank)
+				throw std::invalid_argument("Column index out of range.");
+			if (row >= _Self::rank)
+				throw std::invalid_argument("Row index out of range.");
+			if (column < _Self::first(row) || column >= _Self::last(row))
+				throw std::invalid_argument("Element is outside of the matrix band.");
+
+			return m_values[_Self::offset(row, column)];
+		}
+
+		matrix<N, N> dense() const
+		{
+			matrix<N, N> result;
+			for (size_t row = 0; row < _Self::rank; ++row)
+			{
+				for (size_t col = _Self::first(row); col < _Self::last(row); ++col)
+				{
+					result(row, col) = m_values[_Self::offset(row, col)];
+				}
+			}
+
+			return result;
+		}
+
+		// First column of the band in the row.
+		static size_t first(const size_t row)
+		{
+			return (row > KL) ? row - KL : 0;
+		}
+
+		// Column past the last one of the band in the row.
+		static size_t last(const size_t row)
+		{
+			// Rank is copied, since std::min takes its arguments by reference,
+			// which would require a definition of the static member.
+			const size_t end = row + KU + 1;
+			const size_t rank = _Self::rank;
+
+			return std::min(end, rank);
+		}
+
+		// Pointer to the value of the first column of the band in the row.
+		const value_type* row_data(const size_t row) const
+		{
+			return m_values.data() + _Self::offset(row, _Self::first(row));
+		}
+
+	private:
+		static size_t offset(
+			const size_t row,
+			const size_t column)
+		{
+			return row * _Self::width + KL + column - row;
+		}
+
+		std::vector<value_type> m_values;
+	};
+
+	// Square tridiagonal matrix.
+	template <class N>
+	class tridiagonal_matrix : public banded_matrix<N, 1, 1>
+	{
+	public:
+		typedef banded_matrix<N, 1, 1> _Base;
+		typedef tridiagonal_matrix<N> _Self;
+		typedef typename _Base::value_type value_type;
+
+		tridiagonal_matrix()
+			: _Base()
+		{
+		}
+
+		explicit tridiagonal_matrix(const matrix<N, N>& m)
+			: _Base(m)
+		{
+		}
+	};
+
+	template <class N, class P>
+	matrix<N, P> operator* (
+		const diagonal_matrix<N>& d,
+		const matrix<N, P>& m)
+	{
+		typedef typename matrix<N, P>::value_type value_type;
+
+		// Each row of the dense matrix is scaled by the diagonal value.
+		matrix<N, P> result;
+		if (false == m.empty())
+		{
+			const std::vector<value_type>& diagonal = d.values();
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				const value_type factor = diagonal[row];
+				std::transform(m.crow_begin(row), m.crow_end(row), result.row_begin(row),
+					[factor](const value_type& v) { return v * factor; });
+			}
+		}
+
+		return result;
+	}
+
+	template <class M, class N>
+	matrix<M, N> operator* (
+		const matrix<M, N>& m,
+		const diagonal_matrix<N>& d)
+	{
+		typedef typename matrix<M, N>::value_type value_type;
+
+		// Each column of the dense matrix is scaled by the diagonal value.
+		matrix<M, N> result;
+		if (false == m.empty())
+		{
+			const std::vector<value_type>& diagonal = d.values();
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				std::transform(m.crow_begin(row), m.crow_end(row), diagonal.cbegin(), result.row_begin(row),
+					[](const value_type& v, const value_type& factor) { return v * factor; });
+			}
+		}
+
+		return result;
+	}
+
+	template <class N>
+	vector<N> operator* (
+		const diagonal_matrix<N>& d,
+		const vector<N>& v)
+	{
+		typedef typename vector<N>::value_type value_type;
+
+		vector<N> result;
+		if (false == v.empty())
+		{
+			std::transform(v.cbegin(), v.cend(), d.values().cbegin(), result.begin(),
+				[](const value_type& x, const value_type& factor) { return x * factor; });
+		}
+
+		return result;
+	}
+
+	template <class N>
+	diagonal_matrix<N> operator* (
+		const diagonal_matrix<N>& d1,
+		const diagonal_matrix<N>& d2)
+	{
+		typedef typename diagonal_matrix<N>::value_type value_type;
+
+		vector<N> result;
+		std::transform(d1.values().cbegin(), d1.values().cend(), d2.values().cbegin(), result.begin(),
+			[](const value_type& x1, const value_type& x2) { return x1 * x2; });
+
+		return diagonal_matrix<N>(result);
+	}
+
+	// Triangular matrix-vector product (TRMV), which skips values outside of the triangle.
+	template <class N, const bool _Upper>
+	vector<N> operator* (
+		const triangular_matrix<N, _Upper>& t,
+		const vector<N>& v)
+	{
+		typedef triangular_matrix<N, _Upper> _Triangular;
+		typedef typename _Triangular::value_type value_type;
+
+		vector<N> result;
+		if (false == v.empty())
+		{
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				const value_type* pRow = t.row_data(row);
+				const size_t first = _Triangular::first(row);
+				const size_t last = _Triangular::last(row);
+
+				result(row) = std::inner_product(pRow, pRow + (last - first), v.cbegin() + first, number_traits<value_type>::zero());
+			}
+		}
+
+		return result;
+	}
+
+	// Triangular matrix-matrix product (TRMM), which skips values outside of the triangle.
+	template <class N, class P, const bool _Upper>
+	matrix<N, P> operator* (
+		const triangular_matrix<N, _Upper>& t,
+		const matrix<N, P>& m)
+	{
+		typedef triangular_matrix<N, _Upper> _Triangular;
+		typedef typename _Triangular::value_type value_type;
+
+		matrix<N, P> result;
+		if (false == m.empty())
+		{
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				const value_type* pRow = t.row_data(row);
+				for (size_t i = _Triangular::first(row); i < _Triangular::last(row); ++i)
+				{
+					const value_type factor = *(pRow++);
+					std::transform(m.crow_begin(i), m.crow_end(i), result.crow_begin(row), result.row_begin(row),
+						[factor](const value_type& v, const value_type& sum) { return sum + v * factor; });
+				}
+			}
+		}
+
+		return result;
+	}
+
+	template <class M, class N, const bool _Upper>
+	matrix<M, N> operator* (
+		const matrix<M, N>& m,
+		const triangular_matrix<N, _Upper>& t)
+	{
+		typedef triangular_matrix<N, _Upper> _Triangular;
+		typedef typename _Triangular::value_type value_type;
+
+		matrix<M, N> result;
+		if (false == m.empty())
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t i = 0; i < N::rank; ++i)
+				{
+					const value_type factor = m(row, i);
+					const value_type* pRow = t.row_data(i);
+					for (size_t col = _Triangular::first(i); col < _Triangular::last(i); ++col)
+					{
+						result(row, col) += factor * *(pRow++);
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// Triangular solve (TRSV) of T * x = B by forward or backward substitution.
+	// Returns false if the matrix is singular.
+	template <class N, const bool _Upper>
+	bool solve(
+		const triangular_matrix<N, _Upper>& t,
+		const vector<N>& b,
+		vector<N>& x)
+	{
+		typedef triangular_matrix<N, _Upper> _Triangular;
+		typedef typename _Triangular::value_type value_type;
+
+		for (size_t n = 0; n < N::rank; ++n)
+		{
+			const size_t row = _Upper ? N::rank - 1 - n : n;
+			const value_type diagonal = t(row, row);
+			if (number_traits<value_type>::zero() == diagonal)
+				return false;
+
+			value_type sum = b(row);
+			for (size_t col = _Triangular::first(row); col < _Triangular::last(row); ++col)
+			{
+				if (col != row)
+				{
+					sum -= t(row, col) * x(col);
+				}
+			}
+
+			x(row) = sum / diagonal;
+		}
+
+		return true;
+	}
+
+	// Triangular solve with multiple right hand sides (TRSM) of T * X = B.
+	// Substitution is applied to whole rows of B, so the right hand side
+	// matrix is traversed in memory order. Returns false if the matrix is singular.
+	template <class N, class P, const bool _Upper>
+	bool solve(
+		const triangular_matrix<N, _Upper>& t,
+		const matrix<N, P>& b,
+		matrix<N, P>& x)
+	{
+		typedef triangular_matrix<N, _Upper> _Triangular;
+		typedef typename _Triangular::value_type value_type;
+
+		std::vector<value_type> values(N::rank * P::rank, number_traits<value_type>::zero());
+		if (false == b.empty())
+		{
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				std::copy(b.crow_begin(row), b.crow_end(row), values.begin() + row * P::rank);
+			}
+		}
+
+		for (size_t n = 0; n < N::rank; ++n)
+		{
+			const size_t row = _Upper ? N::rank - 1 - n : n;
+			const value_type diagonal = t(row, row);
+			if (number_traits<value_type>::zero() == diagonal)
+				return false;
+
+			value_type* pRow = values.data() + row * P::rank;
+			const value_type* pT = t.row_data(row);
+			for (size_t col = _Triangular::first(row); col < _Triangular::last(row); ++col, ++pT)
+			{
+				if (col != row)
+				{
+					const value_type factor = *pT;
+					const value_type* pSolved = values.data() + col * P::rank;
+					for (size_t i = 0; i < P::rank; ++i)
+					{
+						pRow[i] -= factor * pSolved[i];
+					}
+				}
+			}
+
+			for (size_t i = 0; i < P::rank; ++i)
+			{
+				pRow[i] /= diagonal;
+			}
+		}
+
+		x = matrix<N, P>(values);
+
+		return true;
+	}
+
+	// Symmetric matrix-vector product (SYMV), which reads each stored value once.
+	template <class N>
+	vector<N> operator* (
+		const symmetric_matrix<N>& s,
+		const vector<N>& v)
+	{
+		typedef typename symmetric_matrix<N>::value_type value_type;
+
+		std::vector<value_type> result(N::rank, number_traits<value_type>::zero());
+		if (false == v.empty())
+		{
+			const std::vector<value_type> values(v.cbegin(), v.cend());
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				const value_type* pRow = s.row_data(row);
+
+				value_type sum = pRow[0] * values[row];
+				for (size_t col = row + 1; col < N::rank; ++col)
+				{
+					sum += pRow[col - row] * values[col];
+					result[col] += pRow[col - row] * values[row];
+				}
+
+				result[row] += sum;
+			}
+		}
+
+		return vector<N>(result);
+	}
+
+	// Symmetric matrix-matrix product (SYMM).
+	template <class N, class P>
+	matrix<N, P> operator* (
+		const symmetric_matrix<N>& s,
+		const matrix<N, P>& m)
+	{
+		typedef typename symmetric_matrix<N>::value_type value_type;
+
+		matrix<N, P> result;
+		if (false == m.empty())
+		{
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				for (size_t i = 0; i < N::rank; ++i)
+				{
+					const value_type factor = s(row, i);
+					std::transform(m.crow_begin(i), m.crow_end(i), result.crow_begin(row), result.row_begin(row),
+						[factor](const value_type& v, const value_type& sum) { return sum + v * factor; });
+				}
+			}
+		}
+
+		return result;
+	}
+
+	template <class M, class N>
+	matrix<M, N> operator* (
+		const matrix<M, N>& m,
+		const symmetric_matrix<N>& s)
+	{
+		typedef typename symmetric_matrix<N>::value_type value_type;
+
+		// Since S is symmetric, M * S == (S * M^T)^T, so each value
+		// is a dot product of a row of M with a row of S.
+		matrix<M, N> result;
+		if (false == m.empty())
+		{
+			std::vector<value_type> column(N::rank);
+			for (size_t col = 0; col < N::rank; ++col)
+			{
+				for (size_t i = 0; i < N::rank; ++i)
+				{
+					column[i] = s(col, i);
+				}
+
+				for (size_t row = 0; row < M::rank; ++row)
+				{
+					result(row, col) = std::inner_product(m.crow_begin(row), m.crow_end(row), column.cbegin(), number_traits<value_type>::zero());
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// Band matrix-vector product (GBMV), which costs O(n * (KL + KU)).
+	template <class N, const size_t KL, const size_t KU>
+	vector<N> operator* (
+		const banded_matrix<N, KL, KU>& b,
+		const vector<N>& v)
+	{
+		typedef banded_matrix<N, KL, KU> _Banded;
+		typedef typename _Banded::value_type value_type;
+
+		vector<N> result;
+		if (false == v.empty())
+		{
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				const value_type* pRow = b.row_data(row);
+				const size_t first = _Banded::first(row);
+				const size_t last = _Banded::last(row);
+
+				result(row) = std::inner_product(pRow, pRow + (last - first), v.cbegin() + first, number_traits<value_type>::zero());
+			}
+		}
+
+		return result;
+	}
+
+	template <class N, class P, const size_t KL, const size_t KU>
+	matrix<N, P> operator* (
+		const banded_matrix<N, KL, KU>& b,
+		const matrix<N, P>& m)
+	{
+		typedef banded_matrix<N, KL, KU> _Banded;
+		typedef typename _Banded::value_type value_type;
+
+		matrix<N, P> result;
+		if (false == m.empty())
+		{
+			for (size_t row = 0; row < N::rank; ++row)
+			{
+				const value_type* pRow = b.row_data(row);
+				for (size_t i = _Banded::first(row); i < _Banded::last(row); ++i)
+				{
+					const value_type factor = *(pRow++);
+					std::transform(m.crow_begin(i), m.crow_end(i), result.crow_begin(row), result.row_begin(row),
+						[factor](const value_type& v, const value_type& sum) { return sum + v * factor; });
+				}
+			}
+		}
+
+		return result;
+	}
+
+	template <class M, class N, const size_t KL, const size_t KU>
+	matrix<M, N> operator* (
+		const matrix<M, N>& m,
+		const banded_matrix<N, KL, KU>& b)
+	{
+		typedef banded_matrix<N, KL, KU> _Banded;
+		typedef typename _Banded::value_type value_type;
+
+		matrix<M, N> result;
+		if (false == m.empty())
+		{
+			for (size_t row = 0; row < M::rank; ++row)
+			{
+				for (size_t i = 0; i < N::rank; ++i)
+				{
+					const value_type factor = m(row, i);
+					const value_type* pRow = b.row_data(i);
+					for (size_t col = _Banded::first(i); col < _Banded::last(i); ++col)
+					{
+						result(row, col) += factor * *(pRow++);
+					}
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// Algorithm to solve a tridiagonal system of linear equations T * x = B
+	// in O(n) using Thomas algorithm. The algorithm does not pivot, so it is
+	// stable for diagonally dominant or symmetric positive definite matrices.
+	// Returns false if elimination encounters a zero pivot.
+	template <class N>
+	bool solve(
+		const tridiagonal_matrix<N>& t,
+		const vector<N>& b,
+		vector<N>& x)
+	{
+		typedef typename tridiagonal_matrix<N>::value_type value_type;
+
+		std::vector<value_type> upper(N::rank, number_traits<value_type>::zero());
+		std::vector<value_type> values(b.cbegin(), b.cend());
+
+		// Forward sweep eliminates the lower diagonal.
+		for (size_t row = 0; row < N::rank; ++row)
+		{
+			const value_type lower = (row > 0) ? t(row, row - 1) : number_traits<value_type>::zero();
+			const value_type pivot = t(row, row) - ((row > 0) ? lower * upper[row - 1] : number_traits<value_type>::zero());
+
+			if (number_traits<value_type>::zero() == pivot)
+				return false;
+
+			upper[row] = (row + 1 < N::rank) ? t(row, row + 1) / pivot : number_traits<value_type>::zero();
+			values[row] = (values[row] - ((row > 0) ? lower * values[row - 1] : number_traits<value_type>::zero())) / pivot;
+		}
+
+		// Backward substitution.
+		for (size_t row = N::rank - 1; row-- > 0;)
+		{
+			values[row] -= upper[row] * values[row + 1];
+		}
+
+		std::copy(values.cbegin(), values.cend(), x.begin());
+
+		return true;
+	}
+}
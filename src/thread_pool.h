@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace algebra
+{
+	// Fixed size pool of worker threads with work stealing.
+	//
+	// Every worker owns a queue. Tasks submitted from a worker go to its
+	// own queue and are taken back in LIFO order, which keeps recently
+	// produced data in cache. Tasks submitted from other threads are
+	// spread over the queues. Idle workers steal the oldest task of the
+	// other queues. Queued tasks are counted without a lock, and workers
+	// only wait on the shared mutex while there is nothing to run.
+	//
+	// Sample usage:
+	//		algebra::thread_pool pool(4);
+	//		pool.submit([]() { ... });
+	//
+	class thread_pool
+	{
+	public:
+		typedef thread_pool _Self;
+		typedef std::function<void()> task;
+
+		explicit thread_pool(const size_t threads = std::thread::hardware_concurrency())
+			: m_queues(0 < threads ? threads : 1), m_pending(0), m_sleeping(0), m_next(0), m_started(false), m_stopping(false)
+		{
+			for (size_t i = 0; i < m_queues.size(); ++i)
+			{
+				m_queues[i].reset(new _queue());
+			}
+
+			for (size_t i = 0; i < m_queues.size(); ++i)
+			{
+				m_workers.push_back(std::thread(&_Self::_Work, this, i));
+				m_ids.push_back(m_workers.back().get_id());
+			}
+
+			// Workers wait until the identities of all workers are known,
+			// which never change afterwards.
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_started = true;
+			}
+
+			m_wakeup.notify_all();
+		}
+
+		thread_pool(const _Self&) = delete;
+		_Self& operator=(const _Self&) = delete;
+
+		// Runs the tasks still queued and joins the workers.
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stopping = true;
+			}
+
+			m_wakeup.notify_all();
+
+			for (std::thread& worker : m_workers)
+			{
+				worker.join();
+			}
+		}
+
+		size_t size() const
+		{
+			return m_workers.size();
+		}
+
+		// Queues a task. Tasks must not throw.
+		void submit(task&& work)
+		{
+			const size_t current = _Current();
+			const size_t index = (_npos != current) ? current : (m_next++ % m_queues.size());
+
+			{
+				std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+				m_queues[index]->tasks.push_back(std::move(work));
+			}
+
+			// A worker about to sleep counts itself before it checks for
+			// pending tasks, so either it sees this task or it is seen
+			// here. Taking the mutex makes sure it waits before the
+			// notification.
+			m_pending.fetch_add(1);
+			if (0 < m_sleeping.load())
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_wakeup.notify_one();
+			}
+		}
+
+		// Checks if the calling thread is a worker of this pool.
+		bool is_worker() const
+		{
+			return _npos != _Current();
+		}
+
+	private:
+		static const size_t _npos = static_cast<size_t>(-1);
+
+		struct _queue
+		{
+			std::mutex mutex;
+			std::deque<task> tasks;
+		};
+
+		// Index of the calling worker in this pool, _npos for threads
+		// outside of it.
+		size_t _Current() const
+		{
+			const std::thread::id id = std::this_thread::get_id();
+
+			for (size_t i = 0; i < m_ids.size(); ++i)
+			{
+				if (id == m_ids[i])
+					return i;
+			}
+
+			return _npos;
+		}
+
+		void _Work(const size_t index)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wakeup.wait(lock, [this]() { return m_started; });
+			}
+
+			for (;;)
+			{
+				if (false == _Reserve())
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+
+					m_sleeping.fetch_add(1);
+					m_wakeup.wait(lock, [this]() { return m_stopping || 0 < m_pending.load(); });
+					m_sleeping.fetch_sub(1);
+
+					if (0 == m_pending.load())
+						return;
+
+					continue;
+				}
+
+				// A pending task is reserved above, so one of the queues
+				// holds a task until this worker takes it.
+				task work;
+				while (false == _Take(index, work))
+				{
+					std::this_thread::yield();
+				}
+
+				work();
+			}
+		}
+
+		// Reserves one of the pending tasks, if there is any.
+		bool _Reserve()
+		{
+			size_t pending = m_pending.load();
+			while (0 < pending)
+			{
+				if (m_pending.compare_exchange_weak(pending, pending - 1))
+					return true;
+			}
+
+			return false;
+		}
+
+		bool _Take(const size_t index, task& work)
+		{
+			{
+				_queue& own = *m_queues[index];
+				std::lock_guard<std::mutex> lock(own.mutex);
+
+				if (false == own.tasks.empty())
+				{
+					work = std::move(own.tasks.back());
+					own.tasks.pop_back();
+					return true;
+				}
+			}
+
+			for (size_t i = 1; i < m_queues.size(); ++i)
+			{
+				_queue& other = *m_queues[(index + i) % m_queues.size()];
+				std::lock_guard<std::mutex> lock(other.mutex);
+
+				if (false == other.tasks.empty())
+				{
+					work = std::move(other.tasks.front());
+					other.tasks.pop_front();
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+	private:
+		std::vector<std::unique_ptr<_queue>> m_queues;
+		std::vector<std::thread> m_workers;
+		std::vector<std::thread::id> m_ids;
+		std::mutex m_mutex;
+		std::condition_variable m_wakeup;
+		std::atomic<size_t> m_pending;
+		std::atomic<size_t> m_sleeping;
+		std::atomic<size_t> m_next;
+		bool m_started;
+		bool m_stopping;
+	};
+
+	// Instance of the default pool. A static data member is zero
+	// initialized before any code runs, unlike a function-local static,
+	// whose initialization is not thread-safe before VS2015.
+	template <class _Pool>
+	struct _default_pool
+	{
+		static std::atomic<_Pool*> instance;
+	};
+
+	template <class _Pool>
+	std::atomic<_Pool*> _default_pool<_Pool>::instance;
+
+	// Pool shared by callers which do not provide their own, with one
+	// worker per hardware thread. It is created by the first caller and
+	// lives until the process exits.
+	inline thread_pool& default_pool()
+	{
+		thread_pool* pool = _default_pool<thread_pool>::instance.load();
+		if (nullptr == pool)
+		{
+			// Threads racing to create the pool agree on one of them, and
+			// the others are destroyed again.
+			std::unique_ptr<thread_pool> created(new thread_pool());
+			if (_default_pool<thread_pool>::instance.compare_exchange_strong(pool, created.get()))
+			{
+				pool = created.release();
+			}
+		}
+
+		return *pool;
+	}
+}
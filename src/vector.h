@@ -573,12 +573,128 @@ namespace algebra
 
 	namespace expressions
 	{
+		// Vectors take part in matrix chains as single column matrices.
+		template <class D>
+		struct _chain_traits<vector<D>>
+		{
+			static const bool chainable = true;
+			static const size_t rows = D::rank;
+			static const size_t columns = 1;
+
+			static const double* data(const vector<D>& v)
+			{
+				return v.empty() ? nullptr : std::addressof(v(0));
+			}
+
+			static double* data(vector<D>& v)
+			{
+				return std::addressof(v(0));
+			}
+
+			static void write(const double* src, const double alpha, vector<D>& dest)
+			{
+				for (size_t i = 0; i < D::rank; ++i)
+				{
+					dest(i) = alpha * src[i];
+				}
+			}
+		};
+
+		template <class D>
+		void _apply(
+			const _plus&,
+			vector<D>& dest,
+			const vector<D>& v1,
+			const vector<D>& v2)
+		{
+			for (size_t i = 0; i < vector<D>::rank; ++i)
+			{
+				dest(i) = v1(i) + v2(i);
+			}
+		}
+
+		template <class D>
+		void _apply(
+			const _minus&,
+			vector<D>& dest,
+			const vector<D>& v1,
+			const vector<D>& v2)
+		{
+			for (size_t i = 0; i < vector<D>::rank; ++i)
+			{
+				dest(i) = v1(i) - v2(i);
+			}
+		}
+
+		template <class D>
+		void _apply(
+			const _multiplies&,
+			vector<D>& dest,
+			const vector<D>& v,
+			const double C)
+		{
+			for (size_t i = 0; i < vector<D>::rank; ++i)
+			{
+				dest(i) = v(i) * C;
+			}
+		}
+
+		template <class D>
+		void _apply(
+			const _multiplies& op,
+			vector<D>& dest,
+			const double C,
+			const vector<D>& v)
+		{
+			_apply(op, dest, v, C);
+		}
+
+		// Differentiation rules. The adjoint of a dot product flows to
+		// each vector as the other vector scaled by the adjoint.
+		template <class D>
+		void _backward(
+			const _multiplies&,
+			const double g,
+			const vector<D>& v1,
+			const vector<D>& v2,
+			_adjoint<vector<D>> d1,
+			_adjoint<vector<D>> d2)
+		{
+			d1.add(v2 * g);
+			d2.add(v1 * g);
+		}
+
+		template <class D>
+		void _backward(
+			const _multiplies&,
+			const vector<D>& g,
+			const vector<D>& v,
+			const double C,
+			_adjoint<vector<D>> dv,
+			_adjoint<double> dC)
+		{
+			dv.add(g * C);
+			dC.add(g * v);
+		}
+
+		template <class D>
+		void _backward(
+			const _multiplies&,
+			const vector<D>& g,
+			const double C,
+			const vector<D>& v,
+			_adjoint<double> dC,
+			_adjoint<vector<D>> dv)
+		{
+			_backward(_multiplies(), g, v, C, dv, dC);
+		}
+
 		template <class D>
 		expression<double> operator* (
 			const expression<vector<D>> e1,
 			const expression<vector<D>> e2)
 		{
-			return expression<double>([e1, e2]() { return e1.evaluate() * e2.evaluate(); });
+			return _binary<double, _multiplies, vector<D>, vector<D>>(e1, e2);
 		}
 
 		template <class D>
@@ -586,7 +702,7 @@ namespace algebra
 			const variable<vector<D>> v1,
 			const expression<vector<D>> e2)
 		{
-			return expression<double>([v1, e2]() { return v1.value() * e2.evaluate(); });
+			return _binary<double, _multiplies, vector<D>, vector<D>>(v1, e2);
 		}
 
 		template <class D>
@@ -594,7 +710,7 @@ namespace algebra
 			const expression<vector<D>> e1,
 			const variable<vector<D>> v2)
 		{
-			return expression<double>([e1, v2]() { return e1.evaluate() * v2.value(); });
+			return _binary<double, _multiplies, vector<D>, vector<D>>(e1, v2);
 		}
 
 		template <class D>
@@ -602,7 +718,7 @@ namespace algebra
 			const variable<vector<D>> v1,
 			const variable<vector<D>> v2)
 		{
-			return expression<double>([v1, v2]() { return v1.value() * v2.value(); });
+			return _binary<double, _multiplies, vector<D>, vector<D>>(v1, v2);
 		}
 
 		template <class D>
@@ -610,7 +726,7 @@ namespace algebra
 			const expression<double> _scalar,
 			const expression<vector<D>> _vector)
 		{
-			return expression<vector<D>>([_scalar, _vector]() { return _scalar.evaluate() * _vector.evaluate(); });
+			return _binary<vector<D>, _multiplies, double, vector<D>>(_scalar, _vector);
 		}
 
 		template <class D>
@@ -618,7 +734,7 @@ namespace algebra
 			const expression<vector<D>> _vector,
 			const expression<double> _scalar)
 		{
-			return expression<vector<D>>([_scalar, _vector]() { return _vector.evaluate() * _scalar.evaluate(); });
+			return _binary<vector<D>, _multiplies, vector<D>, double>(_vector, _scalar);
 		}
 
 		template <class D>
@@ -626,7 +742,7 @@ namespace algebra
 			const expression<double> _scalar,
 			const variable<vector<D>> _vector)
 		{
-			return expression<vector<D>>([_scalar, _vector]() { return _scalar.evaluate() * _vector.value(); });
+			return _binary<vector<D>, _multiplies, double, vector<D>>(_scalar, _vector);
 		}
 
 		template <class D>
@@ -634,7 +750,7 @@ namespace algebra
 			const variable<vector<D>> _vector,
 			const expression<double> _scalar)
 		{
-			return expression<vector<D>>([_scalar, _vector]() { return _vector.value() * _scalar.evaluate(); });
+			return _binary<vector<D>, _multiplies, vector<D>, double>(_vector, _scalar);
 		}
 	}
 }
\ No newline at end of file
@@ -19,4 +19,310 @@ void test_solve()
 	}
 
 	sc.pass();
-}
\ No newline at end of file
+}
+
+void test_solve_refined()
+{
+	scenario sc("Test for algebra::solve_refined");
+
+	for (int i = 0; i < 10; i++)
+	{
+		auto a = algebra::matrix<D6, D6>::random(0, 10);
+		algebra::vector<D6> b{ 10, 20, 30, 40, 50, 60 };
+		algebra::vector<D6> x;
+		algebra::vector<D6> expected;
+
+		if (algebra::solve(a, b, expected))
+		{
+			test::assert(algebra::solve_refined(a, b, x), "Test Failed: refined solution not found");
+			test::assert(a * x == b, "Test Failed: refined solution is incorrect");
+		}
+	}
+
+	{
+		test::verbose("Ill-conditioned matrix falls back to double precision");
+
+		// Hilbert matrix is too ill-conditioned for single precision refinement.
+		algebra::matrix<D6, D6> a;
+		for (size_t row = 0; row < D6::rank; ++row)
+		{
+			for (size_t col = 0; col < D6::rank; ++col)
+			{
+				a(row, col) = 1.0 / (row + col + 1);
+			}
+		}
+
+		algebra::vector<D6> b{ 1, 1, 1, 1, 1, 1 };
+		algebra::vector<D6> x;
+
+		test::assert(algebra::solve_refined(a, b, x), "Test Failed: solution of ill-conditioned system not found");
+		test::assert(a * x == b, "Test Failed: solution of ill-conditioned system is incorrect");
+	}
+
+	{
+		test::verbose("Singular matrix cannot be solved");
+
+		algebra::matrix<D4, D4> a;
+		algebra::vector<D4> b{ 10, 20, 30, 40 };
+		algebra::vector<D4> x;
+
+		test::assert(false == algebra::solve_refined(a, b, x), "Test Failed: singular matrix is solved");
+	}
+
+	sc.pass();
+}
+
+void test_least_squares()
+{
+	scenario sc("Test for algebra::least_squares");
+
+	{
+		test::verbose("QR decomposition with multiple blocks");
+
+		auto a = algebra::matrix<D10, D7>::random(-10, 10);
+		algebra::qr_decomposition<D10, D7, 3> qr(a);
+
+		auto q = qr.q();
+		auto r = qr.r();
+
+		test::assert(q * r == a, "Test Failed: Q * R does not match the input matrix");
+		test::assert(q.transpose() * q == algebra::matrix<D7, D7>::eye(), "Test Failed: Q is not orthonormal");
+
+		for (size_t row = 1; row < D7::rank; ++row)
+		{
+			for (size_t col = 0; col < row; ++col)
+			{
+				test::assert(r(row, col) == 0.0, "Test Failed: R is not upper triangular");
+			}
+		}
+	}
+
+	{
+		test::verbose("Least squares solution of a consistent system");
+
+		auto a = algebra::matrix<D10, D4>::random(0, 10);
+		algebra::vector<D4> expected{ 1, -2, 3, -4 };
+		algebra::vector<D10> b = a * expected;
+		algebra::vector<D4> x;
+
+		test::assert(algebra::least_squares(a, b, x), "Test Failed: solution not found");
+		test::assert(x == expected, "Test Failed: solution is incorrect");
+	}
+
+	{
+		test::verbose("Least squares residual is orthogonal to the column space");
+
+		auto a = algebra::matrix<D10, D4>::random(0, 10);
+		auto b = algebra::vector<D10>::random(0, 100);
+		algebra::vector<D4> x;
+
+		test::assert(algebra::least_squares(a, b, x), "Test Failed: solution not found");
+		test::assert(a.transpose() * (a * x - b) == algebra::vector<D4>(), "Test Failed: residual is not orthogonal");
+	}
+
+	{
+		test::verbose("Zero matrix cannot be solved");
+
+		algebra::vector<D5> b{ 1, 2, 3, 4, 5 };
+		algebra::vector<D2> x;
+
+		test::assert(false == algebra::least_squares(algebra::matrix<D5, D2>(), b, x), "Test Failed: zero matrix is solved");
+	}
+
+	{
+		test::verbose("Numerically singular matrix cannot be solved");
+
+		// The third column is a combination of the first two, which is only
+		// exact up to rounding, so R has a tiny but non-zero diagonal value.
+		auto a = algebra::matrix<D5, D3>::random(0, 10);
+		for (size_t row = 0; row < D5::rank; ++row)
+		{
+			a(row, 2) = 0.1 * a(row, 0) + 0.7 * a(row, 1);
+		}
+
+		algebra::vector<D5> b{ 1, 2, 3, 4, 5 };
+		algebra::vector<D3> x;
+
+		test::assert(false == algebra::least_squares(a, b, x), "Test Failed: numerically singular matrix is solved");
+	}
+
+	sc.pass();
+}
+
+void test_recursive_least_squares()
+{
+	scenario sc("Test for algebra::recursive_least_squares");
+
+	algebra::vector<D4> expected{ 1, -2, 3, -4 };
+
+	{
+		test::verbose("Rank-1 updates converge to the solution");
+
+		algebra::recursive_least_squares<D4> rls;
+		for (int i = 0; i < 100; ++i)
+		{
+			auto x = algebra::vector<D4>::random(-1, 1);
+			rls.update(x, x * expected);
+		}
+
+		test::assert(rls.observations() == 100, "Test Failed: observation count is incorrect");
+		test::assert(_approximately_equals(rls.coefficients(), expected, 1.0e-4), "Test Failed: solution is incorrect");
+
+		rls.refactorize();
+		test::assert(_approximately_equals(rls.coefficients(), expected, 1.0e-4), "Test Failed: solution is incorrect after refactorization");
+	}
+
+	{
+		test::verbose("Block updates match rank-1 updates");
+
+		algebra::recursive_least_squares<D4> rls(1.0, 0);
+		algebra::recursive_least_squares<D4> block(1.0, 0);
+
+		for (int i = 0; i < 10; ++i)
+		{
+			auto x = algebra::matrix<D3, D4>::random(-1, 1);
+			auto y = x * expected + algebra::vector<D3>::random(-0.1, 0.1);
+
+			block.update(x, y);
+			for (size_t k = 0; k < D3::rank; ++k)
+			{
+				algebra::vector<D4> row;
+				std::copy(x.crow_begin(k), x.crow_end(k), row.begin());
+
+				rls.update(row, y(k));
+			}
+		}
+
+		test::assert(rls.observations() == block.observations(), "Test Failed: observation count does not match");
+		test::assert(_approximately_equals(rls.coefficients(), block.coefficients(), 1.0e-8), "Test Failed: block solution does not match");
+	}
+
+	{
+		test::verbose("Forgetting factor tracks changing system");
+
+		algebra::recursive_least_squares<D4> rls(0.9, 7);
+		for (int i = 0; i < 100; ++i)
+		{
+			auto x = algebra::vector<D4>::random(-1, 1);
+			rls.update(x, x * (-1.0 * expected));
+		}
+
+		for (int i = 0; i < 200; ++i)
+		{
+			auto x = algebra::vector<D4>::random(-1, 1);
+			rls.update(x, x * expected);
+		}
+
+		test::assert(_approximately_equals(rls.coefficients(), expected, 1.0e-6), "Test Failed: solution did not follow system change");
+	}
+
+	{
+		test::verbose("Failed refactorization is reported");
+
+		// Without informative observations, the forgetting factor discounts
+		// the regularized information matrix until it becomes singular.
+		algebra::recursive_least_squares<D4> rls(0.5, 1);
+		const algebra::vector<D4> zero;
+
+		size_t updates = 0;
+		while (updates < 2000 && rls.update(zero, 0.0))
+		{
+			++updates;
+		}
+
+		test::assert(updates > 0 && updates < 2000, "Test Failed: failed refactorization was not reported");
+		test::assert(false == rls.refactorize(), "Test Failed: singular information matrix was refactorized");
+	}
+
+	sc.pass();
+}
+
+void test_truncated_svd()
+{
+	scenario sc("Test for algebra::truncated_svd");
+
+	// Build a matrix of rank 3 with known singular values from random orthonormal bases.
+	auto u = algebra::qr_decomposition<D10, D3>(algebra::matrix<D10, D3>::random(-1, 1)).q();
+	auto v = algebra::qr_decomposition<D8, D3>(algebra::matrix<D8, D3>::random(-1, 1)).q();
+	algebra::matrix<D3, D3> s{
+		5, 0, 0,
+		0, 3, 0,
+		0, 0, 1 };
+
+	auto a = u * s * v.transpose();
+
+	{
+		test::verbose("Decomposition of a low rank matrix");
+
+		algebra::truncated_svd<D10, D8, D3> svd(a);
+
+		test::assert(svd.singular_values() == algebra::vector<D3>({ 5, 3, 1 }), "Test Failed: singular values are incorrect");
+		test::assert(svd.u().transpose() * svd.u() == algebra::matrix<D3, D3>::eye(), "Test Failed: left singular vectors are not orthonormal");
+		test::assert(svd.v().transpose() * svd.v() == algebra::matrix<D3, D3>::eye(), "Test Failed: right singular vectors are not orthonormal");
+		test::assert(svd.u() * s * svd.v().transpose() == a, "Test Failed: decomposition does not match the input matrix");
+	}
+
+	{
+		test::verbose("Truncated decomposition keeps the largest singular values");
+
+		algebra::truncated_svd<D10, D8, D2> svd(a);
+
+		test::assert(svd.singular_values() == algebra::vector<D2>({ 5, 3 }), "Test Failed: singular values are incorrect");
+	}
+
+	{
+		test::verbose("Projection to principal components");
+
+		// Samples lie on a 2D plane shifted from the origin, so projection
+		// to 2 principal components preserves distances between samples.
+		auto data = algebra::matrix<D10, D2>::random(-10, 10) * v.resize<D8, D2>().transpose();
+		for (size_t row = 0; row < D10::rank; ++row)
+		{
+			for (size_t col = 0; col < D8::rank; ++col)
+			{
+				data(row, col) += 100.0 * col;
+			}
+		}
+
+		algebra::principal_components<D8, D2> pca(data);
+		auto projection = pca.project(data);
+
+		for (size_t row = 0; row < D10::rank; ++row)
+		{
+			algebra::vector<D8> sample;
+			std::copy(data.crow_begin(row), data.crow_end(row), sample.begin());
+
+			algebra::vector<D2> actual;
+			std::copy(projection.crow_begin(row), projection.crow_end(row), actual.begin());
+
+			test::assert(actual == pca.project(sample), "Test Failed: data set projection does not match sample projection");
+		}
+
+		for (size_t row = 1; row < D10::rank; ++row)
+		{
+			double original = 0.0;
+			for (size_t col = 0; col < D8::rank; ++col)
+			{
+				original += std::pow(data(row, col) - data(0, col), 2);
+			}
+
+			algebra::vector<D2> sample0;
+			algebra::vector<D2> sample;
+			for (size_t col = 0; col < D2::rank; ++col)
+			{
+				sample0(col) = projection(0, col);
+				sample(col) = projection(row, col);
+			}
+
+			const algebra::vector<D2> difference = sample - sample0;
+			test::assert(std::abs(difference * difference - original) < 1.0e-8, "Test Failed: projection does not preserve distances");
+		}
+
+		// Principal directions are defined up to a sign, so only
+		// the magnitude of projected values is compared.
+		auto other = algebra::pca_projection<D2>(data);
+		test::assert(other.abs() == projection.abs(), "Test Failed: projection does not match principal components");
+	}
+
+	sc.pass();
+}
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include <unittest.h>
 #include <expression.h>
+#include <matrix.h>
 
 void test_expressions()
 {
@@ -63,3 +64,618 @@ void test_expressions()
 
 	sc.pass();
 }
+
+void test_expression_cache()
+{
+	scenario sc("Expression Cache Test");
+
+	auto v1 = algebra::expressions::declare<int>();
+	auto v2 = algebra::expressions::declare<int>();
+	auto v3 = algebra::expressions::declare<int>();
+
+	v1.set(1);
+	v2.set(2);
+	v3.set(3);
+
+	// Four cached nodes: v1 + v2, (v1 + v2) * 2, v3 * 3 and the final sum.
+	auto e = (v1 + v2) * 2 + v3 * 3;
+
+	test::verbose("First evaluation computes every node");
+	test::assert(e.evaluate() == 15, "Test Failed: (v1 + v2) * 2 + v3 * 3");
+	test::assert(e.statistics().misses == 4 && e.statistics().hits == 0, "Test Failed: first evaluation statistics");
+
+	test::verbose("Evaluation without changes is served from cache");
+	e.reset_statistics();
+	test::assert(e.evaluate() == 15, "Test Failed: repeated evaluation");
+	test::assert(e.statistics().misses == 0 && e.statistics().hits == 4, "Test Failed: repeated evaluation statistics");
+
+	test::verbose("Only nodes downstream of a changed variable are recomputed");
+	const size_t version = v3.version();
+	v3.set(4);
+	test::assert(v3.version() > version, "Test Failed: variable version is not updated");
+
+	e.reset_statistics();
+	test::assert(e.evaluate() == 18, "Test Failed: evaluation after v3 update");
+	test::assert(e.statistics().misses == 2 && e.statistics().hits == 2, "Test Failed: evaluation after v3 update statistics");
+
+	e.reset_statistics();
+	v1.value() = 2;
+	test::assert(e.evaluate() == 20, "Test Failed: evaluation after v1 update");
+	test::assert(e.statistics().misses == 3 && e.statistics().hits == 1, "Test Failed: evaluation after v1 update statistics");
+
+	test::verbose("Nodes with unknown inputs are always recomputed");
+	int calls = 0;
+	algebra::expressions::expression<int> f([&calls]() { return ++calls; });
+	auto g = f + v1;
+
+	test::assert(g.evaluate() == 3 && g.evaluate() == 4, "Test Failed: f + v1");
+	test::assert(g.statistics().hits == 0, "Test Failed: f + v1 statistics");
+
+	test::verbose("Evaluation into a destination");
+	typedef algebra::matrix<D8, D8> M8;
+
+	auto a = algebra::expressions::declare<M8>();
+	auto b = algebra::expressions::declare<M8>();
+	a.set(M8::random(-1, 1));
+	b.set(M8::random(-1, 1));
+
+	// Non-const reads of variables mark them as changed, so the expected
+	// value is computed before evaluating.
+	auto m = (a + b) * a - b;
+	const M8 expected = (a.value() + b.value()) * a.value() - b.value();
+	M8 result;
+
+	m.evaluate_into(result);
+	test::assert(result == expected, "Test Failed: evaluate_into((a + b) * a - b)");
+	test::assert(m.statistics().misses == 3, "Test Failed: evaluate_into statistics");
+
+	// The root is computed into the destination and stays out of date.
+	m.reset_statistics();
+	test::assert(m.evaluate() == result, "Test Failed: evaluate after evaluate_into");
+	test::assert(m.statistics().misses == 1 && m.statistics().hits == 2, "Test Failed: evaluate after evaluate_into statistics");
+
+	M8 cached;
+	b.set(M8::random(-1, 1));
+	m.evaluate();
+	m.evaluate_into(cached);
+	test::assert(cached == (a.value() + b.value()) * a.value() - b.value(), "Test Failed: evaluate_into from cache");
+
+	sc.pass();
+}
+
+void test_compiled_expressions()
+{
+	scenario sc("Compiled Expressions Test");
+
+	{
+		test::verbose("Common subexpressions are computed once");
+
+		auto a = algebra::expressions::declare<algebra::matrix<D3, D3>>();
+		auto b = algebra::expressions::declare<algebra::matrix<D3, D3>>();
+		auto x = algebra::expressions::declare<algebra::vector<D3>>();
+		auto y = algebra::expressions::declare<algebra::vector<D3>>();
+
+		a.set(algebra::matrix<D3, D3>::random(-1, 1));
+		b.set(algebra::matrix<D3, D3>::random(-1, 1));
+		x.set(algebra::vector<D3>{ 1, 2, 3 });
+		y.set(algebra::vector<D3>{ -1, 0, 1 });
+
+		auto e = (a * b) * x + (a * b) * y;
+		auto plan = algebra::expressions::compile(e);
+
+		test::assert(plan.steps() == 4, "Test Failed: a * b is not shared");
+		test::assert(plan.run() == e.evaluate(), "Test Failed: (a * b) * x + (a * b) * y");
+
+		x.set(algebra::vector<D3>{ 0, 0, 1 });
+		test::assert(plan.run() == (a.value() * b.value()) * (x.value() + y.value()), "Test Failed: run after update");
+	}
+
+	{
+		test::verbose("Buffers are reused after their last use");
+
+		auto x = algebra::expressions::declare<algebra::vector<D2>>();
+		auto y = algebra::expressions::declare<algebra::vector<D2>>();
+
+		x.set(algebra::vector<D2>{ 1, 2 });
+		y.set(algebra::vector<D2>{ 3, 5 });
+
+		auto plan = algebra::expressions::compile(((x + y) + x) + y);
+
+		test::assert(plan.steps() == 3 && plan.buffers() == 2, "Test Failed: buffers are not reused");
+		test::assert(plan.run() == algebra::vector<D2>{ 8, 14 }, "Test Failed: ((x + y) + x) + y");
+		test::assert(plan.run() == algebra::vector<D2>{ 8, 14 }, "Test Failed: repeated run");
+	}
+
+	{
+		test::verbose("Equal scalar constants are shared");
+
+		auto v = algebra::expressions::declare<int>();
+		v.set(5);
+
+		auto plan = algebra::expressions::compile(v * 2 + v * 2);
+
+		test::assert(plan.steps() == 2, "Test Failed: v * 2 is not shared");
+		test::assert(plan.run() == 20, "Test Failed: v * 2 + v * 2");
+	}
+
+	sc.pass();
+}
+
+void test_expression_simplify()
+{
+	scenario sc("Expression Simplification Test");
+
+	using algebra::expressions::compile;
+	using algebra::expressions::simplify;
+
+	typedef algebra::matrix<D3, D3> M3;
+	typedef algebra::vector<D3> V3;
+
+	auto a = algebra::expressions::declare<M3>();
+	auto b = algebra::expressions::declare<M3>();
+	auto x = algebra::expressions::declare<V3>();
+	auto v = algebra::expressions::declare<double>();
+
+	a.set(M3::random(-1, 1));
+	b.set(M3::random(-1, 1));
+	x.set(V3{ 1, 2, 3 });
+	v.set(5);
+
+	{
+		test::verbose("Double transpose is removed");
+
+		algebra::expressions::expression<M3> e = a;
+		auto plan = compile(simplify(transpose(transpose(e))));
+
+		test::assert(plan.steps() == 0 && plan.run() == a.value(), "Test Failed: transpose(transpose(a))");
+	}
+
+	{
+		test::verbose("Scalar factors are folded");
+
+		auto plan = compile(simplify((v * 2.0) * 3.0));
+		test::assert(plan.steps() == 1 && plan.run() == 30, "Test Failed: (v * 2) * 3");
+
+		auto vectors = compile(simplify(2.0 * (x * 0.5)));
+		test::assert(vectors.steps() == 0 && vectors.run() == x.value(), "Test Failed: 2 * (x * 0.5)");
+
+		auto i = algebra::expressions::declare<int>();
+		i.set(5);
+
+		auto ints = compile(simplify((i * 0.5) * 2.0));
+		test::assert(ints.steps() == 2 && ints.run() == 4, "Test Failed: integer scaling is not rewritten");
+	}
+
+	{
+		test::verbose("Scalar factors move into products");
+
+		auto e = (a * 2.0) * (b * x);
+		auto plan = compile(simplify(e));
+
+		test::assert(plan.steps() == 1, "Test Failed: (a * 2) * (b * x) is not fused");
+		test::assert(plan.run() == e.evaluate(), "Test Failed: (a * 2) * (b * x)");
+
+		auto s = 3.0 * (a * b);
+		test::assert(compile(simplify(s)).steps() == 1 && simplify(s).evaluate() == s.evaluate(), "Test Failed: 3 * (a * b)");
+	}
+
+	{
+		test::verbose("Identity and constant subexpressions");
+
+		auto i = algebra::expressions::declare<M3>();
+		i.set(M3::eye());
+		i.set_constant();
+
+		auto plan = compile(simplify(i * x));
+		test::assert(plan.steps() == 0 && plan.run() == x.value(), "Test Failed: I * x");
+
+		auto c = algebra::expressions::declare<M3>();
+		c.set(M3::random(-1, 1));
+		c.set_constant();
+
+		auto e = (c * c) * x;
+		plan = compile(simplify(e));
+		test::assert(plan.steps() == 1 && plan.run() == e.evaluate(), "Test Failed: (c * c) * x");
+	}
+
+	sc.pass();
+}
+
+void test_expression_chains()
+{
+	scenario sc("Expression Matrix Chain Test");
+
+	typedef algebra::matrix<D8, D8> M8;
+	typedef algebra::vector<D8> V8;
+
+	auto a = algebra::expressions::declare<M8>();
+	auto b = algebra::expressions::declare<M8>();
+	auto c = algebra::expressions::declare<M8>();
+	auto x = algebra::expressions::declare<V8>();
+
+	a.set(M8::random(-1, 1));
+	b.set(M8::random(-1, 1));
+	c.set(M8::random(-1, 1));
+	x.set(V8::random(-1, 1));
+
+	{
+		test::verbose("Product of matrices and a vector is evaluated right to left");
+
+		auto e = a * b * c * x;
+		auto chain = dynamic_cast<const algebra::expressions::_chain_node<V8>*>(e.node().get());
+
+		test::assert(nullptr != chain, "Test Failed: a * b * c * x is not a chain");
+		test::assert(chain->cost() == 3 * 8 * 8, "Test Failed: a * b * c * x does not use matrix-vector products");
+		test::assert(e.evaluate() == a.value() * (b.value() * (c.value() * x.value())), "Test Failed: a * b * c * x");
+	}
+
+	{
+		test::verbose("Chains of different shapes");
+
+		auto p = algebra::expressions::declare<algebra::matrix<D2, D8>>();
+		auto q = algebra::expressions::declare<algebra::matrix<D8, D2>>();
+		p.set(algebra::matrix<D2, D8>::random(-1, 1));
+		q.set(algebra::matrix<D8, D2>::random(-1, 1));
+
+		auto e = (a * q) * (p * b);
+		auto chain = dynamic_cast<const algebra::expressions::_chain_node<M8>*>(e.node().get());
+
+		test::assert(nullptr != chain, "Test Failed: (a * q) * (p * b) is not a chain");
+		test::assert(chain->cost() == 3 * 8 * 2 * 8, "Test Failed: (a * q) * (p * b) order");
+		test::assert(e.evaluate() == algebra::multiply(a.value(), q.value(), p.value(), b.value()), "Test Failed: (a * q) * (p * b)");
+	}
+
+	{
+		test::verbose("Shared products are single factors of chains");
+
+		auto ab = a * b;
+		auto e = ab * c * x;
+		auto chain = dynamic_cast<const algebra::expressions::_chain_node<V8>*>(e.node().get());
+
+		test::assert(nullptr != chain && chain->arity() == 3 && chain->child(0) == ab.node().get(), "Test Failed: shared a * b is flattened");
+		test::assert(e.evaluate() == (a.value() * b.value()) * (c.value() * x.value()), "Test Failed: (a * b) * c * x");
+		test::assert(algebra::expressions::compile(a * b * c * x).steps() == 1, "Test Failed: compiled a * b * c * x is not a single chain");
+	}
+
+	{
+		test::verbose("Chains are cached and compiled");
+
+		auto e = 2.0 * (a * b) * c * x;
+		auto plan = algebra::expressions::compile(algebra::expressions::simplify(e));
+
+		test::assert(plan.steps() == 1, "Test Failed: 2 * (a * b) * c * x is not a single chain");
+		test::assert(plan.run() == e.evaluate() && e.evaluate() == 2.0 * (a.value() * b.value() * c.value() * x.value()), "Test Failed: 2 * (a * b) * c * x");
+
+		e.reset_statistics();
+		e.evaluate();
+		test::assert(e.statistics().misses == 0, "Test Failed: chain is not cached");
+
+		c.set(M8::random(-1, 1));
+		test::assert(plan.run() == e.evaluate(), "Test Failed: chain after update");
+
+		c.set(M8());
+		test::assert(plan.run() == V8() && e.evaluate() == V8(), "Test Failed: chain with a zero factor");
+
+		c.set(M8::random(-1, 1));
+		test::assert(plan.run() == e.evaluate() && e.evaluate() == 2.0 * (a.value() * b.value() * c.value() * x.value()), "Test Failed: chain after a zero factor");
+	}
+
+	sc.pass();
+}
+
+void test_parallel_expressions()
+{
+	scenario sc("Parallel Expression Evaluation Test");
+
+	typedef algebra::matrix<D8, D8> M8;
+	typedef algebra::vector<D8> V8;
+
+	auto a = algebra::expressions::declare<M8>();
+	auto b = algebra::expressions::declare<M8>();
+	auto c = algebra::expressions::declare<M8>();
+	auto x = algebra::expressions::declare<V8>();
+
+	a.set(M8::random(-1, 1));
+	b.set(M8::random(-1, 1));
+	c.set(M8::random(-1, 1));
+	x.set(V8::random(-1, 1));
+
+	algebra::thread_pool pool(4);
+
+	{
+		test::verbose("Parallel evaluation matches sequential evaluation");
+
+		auto ab = a * b;
+		auto e = (ab * x + transpose(algebra::expressions::expression<M8>(c)) * x) - (ab + c) * (b * x);
+		const V8 expected = e.evaluate();
+
+		auto parallel = (ab * x + transpose(algebra::expressions::expression<M8>(c)) * x) - (ab + c) * (b * x);
+		test::assert(parallel.evaluate(pool) == expected, "Test Failed: parallel evaluation");
+		test::assert(parallel.evaluate_async(pool).get() == expected, "Test Failed: asynchronous evaluation");
+
+		parallel.reset_statistics();
+		parallel.evaluate(pool);
+		test::assert(parallel.statistics().misses == 0 && parallel.statistics().hits == 0, "Test Failed: parallel evaluation uses node caches");
+
+		b.set(M8::random(-1, 1));
+		test::assert(parallel.evaluate(pool) == e.evaluate(), "Test Failed: parallel evaluation after update");
+	}
+
+	{
+		test::verbose("Concurrent evaluations of graphs sharing nodes");
+
+		auto ab = a * b;
+		auto e1 = ab * x + c * x;
+		auto e2 = ab * x - c * x;
+		const V8 expected1 = e1.evaluate();
+		const V8 expected2 = e2.evaluate();
+
+		std::vector<std::future<V8>> futures;
+		for (size_t i = 0; i < 16; ++i)
+		{
+			futures.push_back(e1.evaluate_async(pool));
+			futures.push_back(e2.evaluate_async(pool));
+		}
+
+		bool matching = true;
+		for (size_t i = 0; i < futures.size(); ++i)
+		{
+			matching = matching && futures[i].get() == ((0 == i % 2) ? expected1 : expected2);
+		}
+
+		test::assert(matching, "Test Failed: concurrent evaluations");
+	}
+
+	{
+		test::verbose("Cancelled evaluation reports evaluation_cancelled");
+
+		algebra::expressions::cancellation_token token;
+		token.cancel();
+
+		auto future = (a * b + c).evaluate_async(pool, token);
+
+		bool cancelled = false;
+		try
+		{
+			future.get();
+		}
+		catch (const algebra::expressions::evaluation_cancelled&)
+		{
+			cancelled = true;
+		}
+
+		test::assert(cancelled, "Test Failed: cancelled evaluation");
+	}
+
+	{
+		test::verbose("Exceptions of function expressions are reported by the future");
+
+		algebra::expressions::expression<double> failing([]() -> double { throw std::invalid_argument("failing"); });
+		auto y = algebra::expressions::declare<double>();
+		y.set(1);
+
+		auto future = (y + failing).evaluate_async(pool);
+
+		bool thrown = false;
+		try
+		{
+			future.get();
+		}
+		catch (const std::invalid_argument&)
+		{
+			thrown = true;
+		}
+
+		test::assert(thrown, "Test Failed: exception of function expression");
+		test::assert((y + y).evaluate_async().get() == 2, "Test Failed: evaluation on the default pool");
+	}
+
+	sc.pass();
+}
+
+template <class M, class N>
+algebra::matrix<M, N> _numerical_gradient(
+	const algebra::expressions::expression<double>& e,
+	algebra::expressions::variable<algebra::matrix<M, N>> var)
+{
+	const double step = 1.0e-6;
+	algebra::matrix<M, N> result;
+
+	for (size_t row = 0; row < M::rank; ++row)
+	{
+		for (size_t col = 0; col < N::rank; ++col)
+		{
+			const double original = static_cast<const algebra::matrix<M, N>&>(var.value())(row, col);
+
+			var.value()(row, col) = original + step;
+			const double above = e.evaluate();
+
+			var.value()(row, col) = original - step;
+			const double below = e.evaluate();
+
+			var.value()(row, col) = original;
+			result(row, col) = (above - below) / (2 * step);
+		}
+	}
+
+	return result;
+}
+
+void test_expression_gradient()
+{
+	scenario sc("Expression Gradient Test");
+
+	{
+		test::verbose("Gradient of scalar expressions");
+
+		auto x = algebra::expressions::declare<double>();
+		auto y = algebra::expressions::declare<double>();
+		auto z = algebra::expressions::declare<double>();
+		x.set(2);
+		y.set(5);
+
+		algebra::expressions::expression<double> ex(x);
+		algebra::expressions::expression<double> ey(y);
+
+		auto f = ex * ey + ex * 3 - ey;
+		auto g = algebra::expressions::gradient(f, x, y, z);
+
+		test::assert(std::get<0>(g) == 8, "Test Failed: d(x * y + 3 * x - y) / dx");
+		test::assert(std::get<1>(g) == 1, "Test Failed: d(x * y + 3 * x - y) / dy");
+		test::assert(std::get<2>(g) == 0, "Test Failed: gradient with respect to an unused variable");
+	}
+
+	typedef algebra::matrix<D4, D3> M43;
+	typedef algebra::matrix<D3, D3> M33;
+
+	auto a = algebra::expressions::declare<M43>();
+	auto b = algebra::expressions::declare<M33>();
+	auto x = algebra::expressions::declare<algebra::vector<D3>>();
+	auto y = algebra::expressions::declare<algebra::vector<D4>>();
+
+	a.set(M43::random(-1, 1));
+	b.set(M33::random(-1, 1));
+	x.set(algebra::vector<D3>::random(-1, 1));
+	y.set(algebra::vector<D4>::random(-1, 1));
+
+	{
+		test::verbose("Gradient of a least squares loss");
+
+		auto residual = a * x - y;
+		algebra::expressions::expression<double> loss = residual * residual;
+
+		auto g = algebra::expressions::gradient(loss, a, x);
+
+		const algebra::vector<D4> r = (a.value() * x.value()) - y.value();
+		test::assert(std::get<1>(g) == 2.0 * (a.value().transpose() * r), "Test Failed: d|a * x - y|^2 / dx");
+		test::assert(_approximately_equals(std::get<0>(g), _numerical_gradient(loss, a), 1.0e-6), "Test Failed: d|a * x - y|^2 / da");
+	}
+
+	{
+		test::verbose("Gradient through matrix chains, transposes and scaling");
+
+		auto product = a * b * transpose(algebra::expressions::expression<M33>(b)) * x;
+		test::assert(nullptr != dynamic_cast<const algebra::expressions::_chain_node<algebra::vector<D4>>*>(product.node().get()), "Test Failed: product is not a chain");
+
+		algebra::expressions::expression<double> e = y * (2.0 * product);
+
+		auto g = algebra::expressions::gradient(e, a, b);
+		test::assert(_approximately_equals(std::get<0>(g), _numerical_gradient(e, a), 1.0e-6), "Test Failed: chain gradient with respect to a");
+		test::assert(_approximately_equals(std::get<1>(g), _numerical_gradient(e, b), 1.0e-6), "Test Failed: chain gradient with respect to b");
+
+		auto simplified = algebra::expressions::simplify(e);
+		test::assert(_approximately_equals(std::get<1>(algebra::expressions::gradient(simplified, a, b)), std::get<1>(g), 1.0e-10), "Test Failed: gradient of simplified expression");
+		test::assert(algebra::expressions::gradient(e, a, b) == g, "Test Failed: repeated chain gradient");
+
+		const M43 value = a.value();
+		a.set(M43());
+
+		auto zero = algebra::expressions::gradient(e, a, b);
+		test::assert(_approximately_equals(std::get<0>(zero), _numerical_gradient(e, a), 1.0e-6), "Test Failed: chain gradient with respect to a zero factor");
+		test::assert(_approximately_equals(std::get<1>(zero), M33(), 0.0), "Test Failed: chain gradient past a zero factor");
+
+		a.set(value);
+	}
+
+	{
+		test::verbose("Function expressions are not differentiable");
+
+		algebra::expressions::expression<double> f([]() { return 1.0; });
+		auto v = algebra::expressions::declare<double>();
+		algebra::expressions::expression<double> ev(v);
+
+		bool thrown = false;
+		try
+		{
+			algebra::expressions::gradient(f * ev, v);
+		}
+		catch (const std::invalid_argument&)
+		{
+			thrown = true;
+		}
+
+		test::assert(thrown, "Test Failed: gradient through a function expression");
+	}
+
+	sc.pass();
+}
+
+void test_expression_arena()
+{
+	scenario sc("Expression Arena Test");
+
+	auto v1 = algebra::expressions::declare<double>();
+	auto v2 = algebra::expressions::declare<double>();
+	v1.set(1);
+	v2.set(2);
+
+	algebra::expressions::expression<double> e1(v1);
+	algebra::expressions::expression<double> e2(v2);
+
+	std::unique_ptr<algebra::expressions::expression<double>> e;
+
+	{
+		test::verbose("Nodes created in an arena scope are placed in the arena");
+
+		algebra::expressions::expression_arena arena;
+		{
+			algebra::expressions::arena_scope scope(arena);
+
+			e.reset(new algebra::expressions::expression<double>(e1 * 2.0));
+			for (int i = 0; i < 100; ++i)
+			{
+				*e = (*e + e2) * 0.5;
+			}
+		}
+
+		test::assert(arena.size() > 300 * sizeof(algebra::expressions::_node_base), "Test Failed: nodes are not placed in the arena");
+		test::assert(arena.blocks() < 300, "Test Failed: arena allocates every node separately");
+
+		const size_t size = arena.size();
+		auto outside = e1 + e2;
+		test::assert(arena.size() == size, "Test Failed: nodes created outside of the scope are placed in the arena");
+
+		test::verbose("Nested scopes");
+
+		algebra::expressions::expression_arena inner;
+		{
+			algebra::expressions::arena_scope scope(arena);
+			{
+				algebra::expressions::arena_scope nested(inner);
+				auto f = e1 + e2;
+			}
+
+			auto g = e1 - e2;
+		}
+
+		test::assert(inner.size() > 0 && arena.size() > size, "Test Failed: nested arena scopes");
+	}
+
+	{
+		test::verbose("Block size is validated");
+
+		test::check_exception<std::invalid_argument>(
+			[]() { algebra::expressions::expression_arena arena(8); },
+			"Block size is too small");
+
+		// The smallest block holds one node, so larger nodes take a block of their own.
+		algebra::expressions::expression_arena arena(2 * std::alignment_of<std::max_align_t>::value);
+		{
+			algebra::expressions::arena_scope scope(arena);
+
+			auto f = (e1 + e2) * 2.0 - e1;
+			test::assert(std::abs(f.evaluate() - 5.0) < 1.0e-10, "Test Failed: evaluation in an arena of small blocks");
+		}
+
+		test::assert(arena.blocks() >= 3, "Test Failed: nodes are not placed in separate blocks");
+	}
+
+	test::verbose("Expressions outlive their arena");
+	test::assert(std::abs(e->evaluate() - 2.0) < 1.0e-10, "Test Failed: evaluation after the arena is destroyed");
+
+	// The weight of v1 halves with every step, so the result follows v2.
+	v2.set(3);
+	test::assert(e->evaluate() == 3.0, "Test Failed: evaluation after update");
+
+	sc.pass();
+}
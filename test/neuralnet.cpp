@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include <unittest.h>
 #include <neuralnet.h>
+#include <thread>
 
 void test_neural_network()
 {
@@ -44,6 +45,721 @@ void test_neural_network()
 	sc.pass();
 }
 
+void test_reentrant_inference()
+{
+	scenario sc("Test for reentrant inference of machine_learning::neural_network");
+
+	machine_learning::neural_network<D3, D6, D5, D1> n;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+
+	test::verbose("Verifying reentrant inference from several threads");
+
+	const auto& shared = n;
+	const auto expected_positive = n.process(positive);
+	const auto expected_negative = n.process(negative);
+
+	std::vector<int> matches(4, 0);
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < matches.size(); ++t)
+	{
+		threads.push_back(std::thread([&, t]()
+		{
+			machine_learning::neural_network<D3, D6, D5, D1>::workspace context;
+			bool match = true;
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				match = match && (shared.process(positive, context) == expected_positive);
+				match = match && (shared.process(negative, context) == expected_negative);
+			}
+
+			matches[t] = match ? 1 : 0;
+		}));
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	test::assert(std::all_of(matches.cbegin(), matches.cend(), [](int m) { return 0 != m; }), "Different result of reentrant inference.");
+
+	sc.pass();
+}
+
+template <class _Activation>
+bool _check_derivative(const double x)
+{
+	const double h = 1e-6;
+	const double numerical = (_Activation::value(x + h) - _Activation::value(x - h)) / (2 * h);
+
+	return std::abs(numerical - _Activation::derivative(_Activation::value(x))) < 1e-6;
+}
+
+template <class _Activation, class D>
+void _train_activation(const char* name, const double rate)
+{
+	machine_learning::basic_neural_network<_Activation, machine_learning::logistic, D3, D, D1> n;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+	algebra::vector<D1> positive_target{ 1.0 };
+	algebra::vector<D1> negative_target{ 0.0 };
+
+	test::verbose(name);
+
+	for (int i = 0; i < 8000; ++i)
+	{
+		n.train(positive, positive_target, rate);
+		n.train(negative, negative_target, rate);
+	}
+
+	test::assert(n.process(positive)(0) > 0.9, "Test on positive input below expected confidence level");
+	test::assert(n.process(negative)(0) < 0.1, "Test on negative input above expected confidence level");
+}
+
+void test_activation_functions()
+{
+	scenario sc("Test for machine_learning activation functions");
+
+	test::verbose("Verifying derivatives computed from outputs");
+
+	const double points[] = { -2.0, -0.5, 0.3, 1.5 };
+	for (const double x : points)
+	{
+		test::assert(_check_derivative<machine_learning::logistic>(x), "Wrong derivative of logistic function.");
+		test::assert(_check_derivative<machine_learning::hyperbolic_tangent>(x), "Wrong derivative of hyperbolic tangent.");
+		test::assert(_check_derivative<machine_learning::relu>(x), "Wrong derivative of rectified linear unit.");
+		test::assert(_check_derivative<machine_learning::leaky_relu>(x), "Wrong derivative of leaky rectified linear unit.");
+	}
+
+	test::verbose("Verifying softmax");
+
+	double values[] = { 1.0, 2.0, 3.0 };
+	machine_learning::softmax::apply(values, 3);
+
+	test::assert(std::abs(values[0] + values[1] + values[2] - 1.0) < 1e-12, "Softmax outputs do not sum to one.");
+	test::assert(std::abs(values[1] / values[0] - std::exp(1.0)) < 1e-12, "Wrong ratio of softmax outputs.");
+
+	double overflow[] = { 1000.0, 1000.0 };
+	machine_learning::softmax::apply(overflow, 2);
+	test::assert(std::abs(overflow[0] - 0.5) < 1e-12, "Softmax overflows for large inputs.");
+
+	// Gradient of the squared error 0.5 * |softmax(net) - target|^2
+	// with respect to the net input, compared with finite differences.
+	const double net[] = { 0.2, -0.4, 0.9 };
+	const double target[] = { 0.0, 1.0, 0.0 };
+
+	auto error = [&target](const double* pNet)
+	{
+		double y[] = { pNet[0], pNet[1], pNet[2] };
+		machine_learning::softmax::apply(y, 3);
+
+		double sum = 0;
+		for (size_t i = 0; i < 3; ++i)
+		{
+			sum += 0.5 * (y[i] - target[i]) * (y[i] - target[i]);
+		}
+
+		return sum;
+	};
+
+	double output[] = { net[0], net[1], net[2] };
+	machine_learning::softmax::apply(output, 3);
+
+	double delta[3];
+	machine_learning::softmax::output_delta(output, target, delta, 3);
+
+	for (size_t i = 0; i < 3; ++i)
+	{
+		double plus[] = { net[0], net[1], net[2] };
+		double minus[] = { net[0], net[1], net[2] };
+		plus[i] += 1e-6;
+		minus[i] -= 1e-6;
+
+		const double numerical = (error(plus) - error(minus)) / 2e-6;
+		test::assert(std::abs(numerical - delta[i]) < 1e-6, "Wrong gradient of softmax output layer.");
+	}
+
+	test::verbose("Training networks with different activation functions");
+
+	_train_activation<machine_learning::hyperbolic_tangent, D6>("Hyperbolic tangent", 0.05);
+	_train_activation<machine_learning::leaky_relu, D6>("Leaky rectified linear unit", 0.1);
+
+	{
+		machine_learning::basic_neural_network<machine_learning::logistic, machine_learning::softmax, D3, D6, D2> n;
+
+		algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+		algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+		algebra::vector<D2> positive_target{ 1.0, 0.0 };
+		algebra::vector<D2> negative_target{ 0.0, 1.0 };
+
+		test::verbose("Softmax output layer");
+
+		for (int i = 0; i < 4000; ++i)
+		{
+			n.train(positive, positive_target, 0.1);
+			n.train(negative, negative_target, 0.1);
+		}
+
+		test::assert(n.process(positive)(0) > 0.9, "Test on positive input below expected confidence level");
+		test::assert(n.process(negative)(1) > 0.9, "Test on negative input below expected confidence level");
+	}
+
+	sc.pass();
+}
+
+void test_neural_network_batch()
+{
+	scenario sc("Test for machine_learning::neural_network::train_batch");
+
+	machine_learning::neural_network<D3, D6, D5, D1> n;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+	algebra::vector<D1> positive_target{ 1.0 };
+	algebra::vector<D1> negative_target{ 0.0 };
+
+	const double rate = 0.05;
+
+	test::verbose("Comparing batch of one sample with single sample training");
+
+	auto single = n;
+	auto batch = n;
+
+	single.train(positive, positive_target, rate);
+	batch.train_batch(
+		algebra::matrix<D1, D3>({ 0.5, 10.0, 0.5 }),
+		algebra::matrix<D1, D1>({ 1.0 }),
+		rate);
+
+	test::assert(single.process(positive) == batch.process(positive), "Different result of batch and single sample training.");
+	test::assert(single.process(negative) == batch.process(negative), "Different result of batch and single sample training.");
+	test::assert(n.process(positive) != batch.process(positive), "Identical processing result after batch training.");
+
+	test::verbose("Comparing batch processing with single sample processing");
+
+	{
+		const algebra::matrix<D5, D3> data({
+			0.5, 10.0, 0.5,
+			1.0, 1.0, 1.0,
+			-0.5, 2.0, 3.0,
+			0.0, 0.0, 0.0,
+			4.0, -1.0, 0.25 });
+
+		algebra::matrix<D5, D1> result;
+		n.process(data, result);
+
+		for (size_t row = 0; row < D5::rank; ++row)
+		{
+			algebra::vector<D3> sample{ data(row, 0), data(row, 1), data(row, 2) };
+			test::assert(algebra::number_traits<double>::equals(n.process(sample)(0), result(row, 0)), "Different result of batch and single sample processing.");
+		}
+	}
+
+	test::verbose("Comparing batch of repeated samples with batch of one sample");
+
+	auto repeated = n;
+	repeated.train_batch(
+		algebra::matrix<D2, D3>({ 0.5, 10.0, 0.5, 0.5, 10.0, 0.5 }),
+		algebra::matrix<D2, D1>({ 1.0, 1.0 }),
+		rate);
+
+	test::assert(repeated.process(positive) == batch.process(positive), "Repeated samples change the batch update.");
+
+	test::verbose("Training the neural network in batches");
+
+	const algebra::matrix<D6, D3> data({
+		0.5, 10.0, 0.5,
+		1.0, 1.0, 1.0,
+		0.5, 10.0, 0.5,
+		1.0, 1.0, 1.0,
+		0.5, 10.0, 0.5,
+		1.0, 1.0, 1.0 });
+	const algebra::matrix<D6, D1> target({ 1.0, 0.0, 1.0, 0.0, 1.0, 0.0 });
+
+	for (int i = 0; i < 8000; ++i)
+	{
+		n.train_batch(data, target, 2 * rate);
+	}
+
+	test::assert(n.process(positive)(0) > 0.9, "Test on positive input below expected confidence level");
+	test::assert(n.process(negative)(0) < 0.1, "Test on negative input above expected confidence level");
+
+	sc.pass();
+}
+
+void test_neural_network_parameters()
+{
+	scenario sc("Test for machine_learning::neural_network::parameters");
+
+	typedef machine_learning::neural_network<D3, D6, D5, D1> network;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D1> positive_target{ 1.0 };
+
+	network n;
+
+	test::assert(0 == reinterpret_cast<uintptr_t>(n.parameters()) % machine_learning::parameter_arena::alignment, "Parameter arena is not aligned.");
+	test::assert(network::parameter_count >= 6 * 3 + 6 + 5 * 6 + 5 + 1 * 5 + 1, "Parameter arena is too small.");
+
+	test::verbose("Verifying copies of the parameters");
+
+	auto copy = n;
+	test::assert(copy.parameters() != n.parameters(), "Copy shares parameters with the original network.");
+	test::assert(std::equal(n.parameters(), n.parameters() + network::parameter_count, copy.parameters()), "Different parameters after network copy constructor.");
+
+	const auto expected = n.process(positive);
+	copy.train(positive, positive_target, 0.05);
+	test::assert(n.process(positive) == expected, "Training a copy changed the original network.");
+
+	test::verbose("Restoring a snapshot of the parameters");
+
+	std::vector<double> snapshot(n.parameters(), n.parameters() + network::parameter_count);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		n.train(positive, positive_target, 0.05);
+	}
+
+	test::assert(n.process(positive) != expected, "Identical processing result after network training.");
+
+	std::copy(snapshot.cbegin(), snapshot.cend(), n.parameters());
+	test::assert(n.process(positive) == expected, "Different processing result after restoring a snapshot.");
+
+	test::verbose("Verifying moved networks");
+
+	network moved(std::move(n));
+	test::assert(moved.process(positive) == expected, "Different processing result after network move constructor.");
+
+	copy = moved;
+	test::assert(copy.process(positive) == expected, "Different processing result after network copy operator.");
+
+	test::verbose("Verifying layers which own their parameters");
+
+	machine_learning::neuron_layer<D3, D2> layer;
+	const auto output = layer.process(positive);
+
+	auto layer_copy = layer;
+	test::assert(layer_copy.parameters() != layer.parameters(), "Copy shares parameters with the original layer.");
+	test::assert(layer_copy.weight() == layer.weight() && layer_copy.process(positive) == output, "Different processing result after layer copy constructor.");
+
+	machine_learning::neuron_layer<D3, D2> layer_moved(std::move(layer_copy));
+	test::assert(layer_moved.process(positive) == output, "Different processing result after layer move constructor.");
+
+	sc.pass();
+}
+
+void test_data_parallel_training()
+{
+	scenario sc("Test for machine_learning::data_parallel_trainer");
+
+	typedef machine_learning::neural_network<D3, D6, D5, D1> network;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+
+	const algebra::matrix<D8, D3> data({
+		0.5, 10.0, 0.5,
+		1.0, 1.0, 1.0,
+		0.4, 9.0, 0.6,
+		1.0, 1.5, 1.0,
+		0.5, 11.0, 0.5,
+		1.2, 1.0, 0.8,
+		0.6, 10.0, 0.4,
+		1.0, 0.5, 1.0 });
+	const algebra::matrix<D8, D1> target({ 1.0, 0.0, 1.0, 0.0, 1.0, 0.0, 1.0, 0.0 });
+
+	const double rate = 0.1;
+
+	network n;
+
+	test::verbose("Comparing single chunk with batch training");
+
+	{
+		auto expected = n;
+		auto trained = n;
+
+		algebra::thread_pool pool(2);
+		machine_learning::data_parallel_trainer<network> trainer(trained, pool, 1);
+
+		for (int i = 0; i < 10; ++i)
+		{
+			expected.train_batch(data, target, rate);
+			trainer.train(data, target, rate);
+		}
+
+		test::assert(expected.process(positive)(0) == trained.process(positive)(0), "Different result of single chunk and batch training.");
+	}
+
+	test::verbose("Comparing gradient averaging across threads with batch training");
+
+	{
+		auto expected = n;
+		auto trained = n;
+
+		algebra::thread_pool pool(4);
+		machine_learning::data_parallel_trainer<network> trainer(trained, pool);
+
+		for (int i = 0; i < 10; ++i)
+		{
+			expected.train_batch(data, target, rate);
+			trainer.train(data, target, rate);
+		}
+
+		test::assert(expected.process(positive) == trained.process(positive), "Different result of parallel and batch training.");
+		test::assert(expected.process(negative) == trained.process(negative), "Different result of parallel and batch training.");
+	}
+
+	test::verbose("Verifying reproducible results for any number of threads");
+
+	{
+		std::vector<double> results;
+
+		for (size_t threads = 1; threads <= 4; ++threads)
+		{
+			auto trained = n;
+
+			algebra::thread_pool pool(threads);
+			machine_learning::data_parallel_trainer<network> trainer(trained, pool, 5);
+
+			for (int i = 0; i < 10; ++i)
+			{
+				trainer.train(data, target, rate);
+			}
+
+			results.push_back(trained.process(positive)(0));
+		}
+
+		test::assert(std::all_of(results.cbegin(), results.cend(), [&results](double r) { return r == results.front(); }), "Result depends on the number of threads.");
+	}
+
+	test::verbose("Training the neural network in parallel");
+
+	{
+		machine_learning::data_parallel_trainer<network> trainer(n);
+
+		for (int i = 0; i < 4000; ++i)
+		{
+			trainer.train(data, target, 2 * rate);
+		}
+
+		test::assert(n.process(positive)(0) > 0.9, "Test on positive input below expected confidence level");
+		test::assert(n.process(negative)(0) < 0.1, "Test on negative input above expected confidence level");
+	}
+
+	test::verbose("Verifying that failing tasks are waited for and reported");
+
+	{
+		algebra::thread_pool pool(4);
+		std::atomic<size_t> finished(0);
+
+		test::check_exception<std::runtime_error>([&]()
+			{
+				machine_learning::_parallel_for(pool, 16, [&](const size_t i)
+				{
+					if (0 == i % 5)
+						throw std::runtime_error("task failed");
+
+					++finished;
+				});
+			},
+			"Exception of a task is not rethrown.");
+
+		test::assert(finished == 12, "Tasks did not finish after an exception.");
+	}
+
+	sc.pass();
+}
+
+void test_hogwild_training()
+{
+	scenario sc("Test for machine_learning::hogwild_trainer");
+
+	typedef machine_learning::neural_network<D3, D6, D5, D1> network;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+	algebra::vector<D1> positive_target{ 1.0 };
+	algebra::vector<D1> negative_target{ 0.0 };
+
+	std::vector<algebra::vector<D3>> data;
+	std::vector<algebra::vector<D1>> target;
+
+	for (int i = 0; i < 32; ++i)
+	{
+		data.push_back(positive);
+		target.push_back(positive_target);
+		data.push_back(negative);
+		target.push_back(negative_target);
+	}
+
+	const double rate = 0.05;
+
+	network n;
+
+	test::verbose("Comparing reentrant training step with train");
+
+	{
+		auto expected = n;
+		auto trained = n;
+		network::training_workspace context;
+
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			expected.train(data[i], target[i], rate);
+			trained.train(data[i], target[i], context, rate);
+		}
+
+		test::assert(expected.process(positive) == trained.process(positive), "Different result of reentrant training step.");
+		test::assert(expected.process(negative) == trained.process(negative), "Different result of reentrant training step.");
+	}
+
+	test::verbose("Comparing single thread epoch with train");
+
+	{
+		auto expected = n;
+		auto trained = n;
+
+		algebra::thread_pool pool(1);
+		machine_learning::hogwild_trainer<network> trainer(trained, pool);
+
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			expected.train(data[i], target[i], rate);
+		}
+
+		trainer.train(data, target, rate);
+
+		test::assert(expected.process(positive) == trained.process(positive), "Different result of single thread epoch.");
+	}
+
+	test::check_exception<std::invalid_argument>([&]()
+	{
+		machine_learning::hogwild_trainer<network> trainer(n);
+		trainer.train(data, std::vector<algebra::vector<D1>>(1), rate);
+	}, "Invalid number of targets was not detected.");
+
+	test::verbose("Training the neural network asynchronously");
+
+	{
+		algebra::thread_pool pool(4);
+		machine_learning::hogwild_trainer<network> trainer(n, pool);
+
+		for (int i = 0; i < 250; ++i)
+		{
+			trainer.train(data, target, rate);
+		}
+
+		test::assert(n.process(positive)(0) > 0.9, "Test on positive input below expected confidence level");
+		test::assert(n.process(negative)(0) < 0.1, "Test on negative input above expected confidence level");
+	}
+
+	sc.pass();
+}
+
+template <class _Optimizer>
+bool _train_optimizer(
+	const _Optimizer& optimizer)
+{
+	typedef machine_learning::neural_network<D3, D6, D5, D1> network;
+
+	const algebra::matrix<D2, D3> data({
+		0.5, 10.0, 0.5,
+		1.0, 1.0, 1.0 });
+	const algebra::matrix<D2, D1> target({ 1.0, 0.0 });
+
+	network n;
+	machine_learning::optimizing_trainer<network, _Optimizer> trainer(n, optimizer);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		trainer.train(data, target);
+	}
+
+	return n.process(algebra::vector<D3>{ 0.5, 10.0, 0.5 })(0) > 0.9
+		&& n.process(algebra::vector<D3>{ 1.0, 1.0, 1.0 })(0) < 0.1;
+}
+
+void test_optimizers()
+{
+	scenario sc("Test for machine_learning optimizers");
+
+	typedef machine_learning::neural_network<D3, D6, D5, D1> network;
+
+	algebra::vector<D3> positive{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> negative{ 1.0, 1.0, 1.0 };
+	algebra::vector<D1> positive_target{ 1.0 };
+
+	const double rate = 0.05;
+
+	network n;
+
+	test::verbose("Comparing gradient with numerical derivatives of the cost function");
+
+	{
+		auto probe = n;
+		std::vector<double> gradient(network::parameter_count, 0.0);
+		probe.gradient(positive, positive_target, gradient.data(), 0.0);
+
+		const double h = 1e-6;
+		bool match = true;
+
+		for (size_t i = 0; i < network::parameter_count; ++i)
+		{
+			const double value = probe.parameters()[i];
+
+			probe.parameters()[i] = value + h;
+			const double upper = probe.process(positive)(0) - positive_target(0);
+			probe.parameters()[i] = value - h;
+			const double lower = probe.process(positive)(0) - positive_target(0);
+			probe.parameters()[i] = value;
+
+			const double numerical = (0.5 * upper * upper - 0.5 * lower * lower) / (2 * h);
+			match = match && std::abs(numerical - gradient[i]) < 1e-6;
+		}
+
+		test::assert(match, "Gradient does not match numerical derivatives.");
+	}
+
+	test::verbose("Comparing gradient descent with train");
+
+	{
+		auto expected = n;
+		auto trained = n;
+		machine_learning::optimizing_trainer<network, machine_learning::gradient_descent> trainer(
+			trained, machine_learning::gradient_descent(rate));
+
+		expected.train(positive, positive_target, rate);
+		trainer.train(positive, positive_target);
+
+		test::assert(expected.process(negative) == trained.process(negative), "Different result of gradient descent and train.");
+
+		const algebra::matrix<D2, D3> data({ 0.5, 10.0, 0.5, 1.0, 1.0, 1.0 });
+		const algebra::matrix<D2, D1> target({ 1.0, 0.0 });
+
+		expected.train_batch(data, target, rate);
+		trainer.train(data, target);
+
+		test::assert(expected.process(negative) == trained.process(negative), "Different result of gradient descent and train_batch.");
+		test::assert(n.process(negative) != trained.process(negative), "Identical processing result after training.");
+	}
+
+	test::verbose("Training the neural network with optimizers");
+
+	test::assert(_train_optimizer(machine_learning::momentum(0.1)), "Momentum: network was not trained.");
+	test::assert(_train_optimizer(machine_learning::nesterov_momentum(0.1)), "Nesterov momentum: network was not trained.");
+	test::assert(_train_optimizer(machine_learning::rmsprop(0.01)), "RMSProp: network was not trained.");
+	test::assert(_train_optimizer(machine_learning::adam(0.01)), "Adam: network was not trained.");
+
+	sc.pass();
+}
+
+void test_classification_network()
+{
+	scenario sc("Test for machine_learning::classification_network");
+
+	typedef machine_learning::softmax_cross_entropy cost;
+
+	test::verbose("Verifying gradient of the cross-entropy cost");
+
+	const double net[] = { 0.2, -0.4, 0.9 };
+	const double target[] = { 0.0, 1.0, 0.0 };
+
+	auto loss = [&target](const double* pNet)
+	{
+		double y[] = { pNet[0], pNet[1], pNet[2] };
+		cost::apply(y, 3);
+		return cost::loss(y, target, 3);
+	};
+
+	double output[] = { net[0], net[1], net[2] };
+	cost::apply(output, 3);
+
+	double delta[3];
+	cost::output_delta(output, target, delta, 3);
+
+	for (size_t i = 0; i < 3; ++i)
+	{
+		double plus[] = { net[0], net[1], net[2] };
+		double minus[] = { net[0], net[1], net[2] };
+		plus[i] += 1e-6;
+		minus[i] -= 1e-6;
+
+		const double numerical = (loss(plus) - loss(minus)) / 2e-6;
+		test::assert(std::abs(numerical - delta[i]) < 1e-6, "Wrong gradient of cross-entropy cost.");
+	}
+
+	double saturated[] = { 1000.0, -1000.0 };
+	const double saturated_target[] = { 0.0, 1.0 };
+	cost::apply(saturated, 2);
+	test::assert(std::isfinite(cost::loss(saturated, saturated_target, 2)), "Cross-entropy of saturated outputs is not finite.");
+
+	typedef machine_learning::classification_network<D3, D6, D3> network;
+
+	algebra::vector<D3> first{ 0.5, 10.0, 0.5 };
+	algebra::vector<D3> second{ 1.0, 1.0, 1.0 };
+	algebra::vector<D3> third{ 5.0, 0.0, -2.0 };
+	algebra::vector<D3> first_target{ 1.0, 0.0, 0.0 };
+	algebra::vector<D3> second_target{ 0.0, 1.0, 0.0 };
+	algebra::vector<D3> third_target{ 0.0, 0.0, 1.0 };
+
+	network n;
+
+	test::verbose("Comparing network gradient with numerical derivatives of the cost");
+
+	{
+		auto probe = n;
+		std::vector<double> gradient(network::parameter_count, 0.0);
+		probe.gradient(second, second_target, gradient.data(), 0.0);
+
+		auto cost_of = [&]()
+		{
+			const auto& out = probe.process(second);
+			return cost::loss(std::addressof(out(0)), std::addressof(second_target(0)), D3::rank);
+		};
+
+		const double h = 1e-6;
+		bool match = true;
+
+		for (size_t i = 0; i < network::parameter_count; ++i)
+		{
+			const double value = probe.parameters()[i];
+
+			probe.parameters()[i] = value + h;
+			const double upper = cost_of();
+			probe.parameters()[i] = value - h;
+			const double lower = cost_of();
+			probe.parameters()[i] = value;
+
+			match = match && std::abs((upper - lower) / (2 * h) - gradient[i]) < 1e-6;
+		}
+
+		test::assert(match, "Gradient does not match numerical derivatives.");
+	}
+
+	test::verbose("Training the classification network");
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		n.train(first, first_target, 0.1);
+		n.train(second, second_target, 0.1);
+		n.train(third, third_target, 0.1);
+	}
+
+	test::assert(n.process(first)(0) > 0.9, "Test on first class below expected confidence level");
+	test::assert(n.process(second)(1) > 0.9, "Test on second class below expected confidence level");
+	test::assert(n.process(third)(2) > 0.9, "Test on third class below expected confidence level");
+
+	const auto& out = n.process(third);
+	test::assert(std::abs(out(0) + out(1) + out(2) - 1.0) < 1e-12, "Outputs do not sum to one.");
+
+	sc.pass();
+}
+
 void test_composite_networks()
 {
 	{
@@ -0,0 +1,84 @@
+#include "stdafx.h"
+#include <unittest.h>
+#include <matrix.h>
+#include <static_expression.h>
+
+void test_static_expressions()
+{
+	scenario sc("Static Expressions Test");
+
+	using algebra::static_expressions::ref;
+
+	{
+		test::verbose("Scalar static expressions tests");
+
+		auto v1 = algebra::expressions::declare<int>();
+		auto v2 = algebra::expressions::declare<int>();
+
+		v1.set(10);
+		v2.set(20);
+
+		test::assert((ref(v1) + v2).evaluate() == 30, "Test Failed: v1 + v2");
+		test::assert((2 * ref(v1)).evaluate() == 20, "Test Failed: 2 * v1");
+		test::assert((ref(v1) * 3).evaluate() == 30, "Test Failed: v1 * 3");
+		test::assert((ref(v1) - v2).evaluate() == -10, "Test Failed: v1 - v2");
+		test::assert((2 * (ref(v1) + v2)).evaluate() == 60, "Test Failed: 2 * (v1 + v2)");
+		test::assert(((ref(v1) + v2) - (ref(v1) + v2)).evaluate() == 0, "Test Failed: (v1 + v2) - (v1 + v2)");
+		test::assert((v1 - (ref(v1) + v2)).evaluate() == -20, "Test Failed: v1 - (v1 + v2)");
+
+		// Static expressions read variables on evaluation, not on construction.
+		auto e = (ref(v1) + v2) * v1;
+		v1.set(1);
+		test::assert(e.evaluate() == 21, "Test Failed: (v1 + v2) * v1 after update");
+	}
+
+	{
+		test::verbose("Matrix static expressions tests");
+
+		auto a = algebra::expressions::declare<algebra::matrix<D2, D3>>();
+		auto b = algebra::expressions::declare<algebra::matrix<D3, D2>>();
+		auto x = algebra::expressions::declare<algebra::vector<D2>>();
+
+		a.set(algebra::matrix<D2, D3>{
+			1, 2, 3,
+			4, 5, 6 });
+		b.set(algebra::matrix<D3, D2>{
+			1, 0,
+			0, 1,
+			1, 1 });
+		x.set(algebra::vector<D2>{ 1, -1 });
+
+		auto product = ref(a) * b;
+		test::assert(product.evaluate() == a.value() * b.value(), "Test Failed: a * b");
+
+		auto sum = transpose(ref(a)) + b;
+		test::assert(sum.evaluate() == a.value().transpose() + b.value(), "Test Failed: transpose(a) + b");
+
+		auto scaled = 2.0 * (ref(a) * b) * x;
+		test::assert(scaled.evaluate() == algebra::vector<D2>{ -2, -2 }, "Test Failed: 2 * (a * b) * x");
+
+		test::assert((ref(x) * x).evaluate() == 2, "Test Failed: x * x");
+	}
+
+	{
+		test::verbose("Type erasure of static expressions tests");
+
+		auto v1 = algebra::expressions::declare<algebra::vector<D3>>();
+		auto v2 = algebra::expressions::declare<algebra::vector<D3>>();
+
+		v1.set(algebra::vector<D3>{ 1, 2, 3 });
+		v2.set(algebra::vector<D3>{ -3, -7, -9 });
+
+		algebra::expressions::expression<algebra::vector<D3>> e = algebra::static_expressions::erase(2 * (ref(v1) + v2));
+		test::assert(e.evaluate() == algebra::vector<D3>{ -4, -10, -12 }, "Test Failed: erase(2 * (v1 + v2))");
+
+		// Erased expressions compose with the dynamic expression operators.
+		algebra::expressions::expression<double> dot = e * v1;
+		test::assert(dot.evaluate() == -60, "Test Failed: erase(2 * (v1 + v2)) * v1");
+
+		v2.set(algebra::vector<D3>{ 0, 0, 0 });
+		test::assert(dot.evaluate() == 28, "Test Failed: erase(2 * (v1 + v2)) * v1 after update");
+	}
+
+	sc.pass();
+}
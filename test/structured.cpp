@@ -0,0 +1,132 @@
+#include "stdafx.h"
+#include <unittest.h>
+#include <structured.h>
+
+void test_structured_matrices()
+{
+	scenario sc("Structured Matrices Test");
+
+	auto dense = algebra::matrix<D5, D5>::random(-10, 10);
+	auto m = algebra::matrix<D5, D3>::random(-10, 10);
+	auto mt = algebra::matrix<D3, D5>::random(-10, 10);
+	auto v = algebra::vector<D5>::random(-10, 10);
+
+	{
+		test::verbose("Diagonal matrix");
+
+		algebra::diagonal_matrix<D5> d{ 1, 2, 3, 4, 5 };
+
+		const auto& cd = d;
+		test::assert(cd(1, 1) == 2 && cd(1, 2) == 0, "Test Failed: diagonal matrix random access");
+		test::check_exception<std::invalid_argument>([&d]() { d(1, 2) = 1.0; }, "Test Failed: diagonal matrix allows write outside of diagonal");
+
+		test::assert(d * m == d.dense() * m, "Test Failed: diagonal * matrix");
+		test::assert(mt * d == mt * d.dense(), "Test Failed: matrix * diagonal");
+		test::assert(d * v == d.dense() * v, "Test Failed: diagonal * vector");
+		test::assert((d * d).dense() == d.dense() * d.dense(), "Test Failed: diagonal * diagonal");
+	}
+
+	{
+		test::verbose("Triangular matrix");
+
+		algebra::upper_triangular_matrix<D5> u(dense);
+		algebra::lower_triangular_matrix<D5> l(dense);
+
+		const auto& cu = u;
+		const auto& cl = l;
+		test::assert(cu(0, 4) == dense(0, 4) && cu(4, 0) == 0, "Test Failed: upper triangular matrix random access");
+		test::assert(cl(4, 0) == dense(4, 0) && cl(0, 4) == 0, "Test Failed: lower triangular matrix random access");
+		test::assert(u.dense() + l.dense() - algebra::upper_triangular_matrix<D5>(l.dense()).dense() == dense, "Test Failed: triangles do not match the dense matrix");
+
+		test::assert(u * v == u.dense() * v, "Test Failed: upper triangular * vector");
+		test::assert(l * v == l.dense() * v, "Test Failed: lower triangular * vector");
+		test::assert(u * m == u.dense() * m, "Test Failed: upper triangular * matrix");
+		test::assert(l * m == l.dense() * m, "Test Failed: lower triangular * matrix");
+		test::assert(mt * u == mt * u.dense(), "Test Failed: matrix * upper triangular");
+		test::assert(mt * l == mt * l.dense(), "Test Failed: matrix * lower triangular");
+
+		for (size_t i = 0; i < D5::rank; ++i)
+		{
+			u(i, i) += 50.0;
+			l(i, i) += 50.0;
+		}
+
+		algebra::vector<D5> x;
+		test::assert(algebra::solve(u, v, x) && u * x == v, "Test Failed: upper triangular solve");
+		test::assert(algebra::solve(l, v, x) && l * x == v, "Test Failed: lower triangular solve");
+
+		algebra::matrix<D5, D3> X;
+		test::assert(algebra::solve(u, m, X) && u * X == m, "Test Failed: upper triangular solve with multiple right hand sides");
+		test::assert(algebra::solve(l, m, X) && l * X == m, "Test Failed: lower triangular solve with multiple right hand sides");
+
+		test::assert(false == algebra::solve(algebra::upper_triangular_matrix<D5>(), v, x), "Test Failed: singular triangular matrix is solved");
+	}
+
+	{
+		test::verbose("Symmetric matrix");
+
+		algebra::symmetric_matrix<D5> s(dense);
+
+		test::assert(s(1, 3) == dense(1, 3) && s(3, 1) == dense(1, 3), "Test Failed: symmetric matrix random access");
+		test::assert(s.dense() == s.dense().transpose(), "Test Failed: symmetric matrix is not symmetric");
+
+		test::assert(s * v == s.dense() * v, "Test Failed: symmetric * vector");
+		test::assert(s * m == s.dense() * m, "Test Failed: symmetric * matrix");
+		test::assert(mt * s == mt * s.dense(), "Test Failed: matrix * symmetric");
+
+		test::assert(algebra::syrk(m).dense() == m * m.transpose(), "Test Failed: symmetric rank-k update");
+
+		auto expected = s.dense() * 0.5 + (mt.transpose() * mt) * 2.0;
+		s.rank_update_transposed(mt, 2.0, 0.5);
+		test::assert(s.dense() == expected, "Test Failed: transposed symmetric rank-k update");
+	}
+
+	{
+		test::verbose("Band matrix");
+
+		algebra::banded_matrix<D5, 1, 2> b(dense);
+
+		const auto& cb = b;
+		test::assert(cb(0, 2) == dense(0, 2) && cb(0, 3) == 0 && cb(2, 1) == dense(2, 1) && cb(2, 0) == 0, "Test Failed: band matrix random access");
+		test::check_exception<std::invalid_argument>([&b]() { b(0, 3) = 1.0; }, "Test Failed: band matrix allows write outside of band");
+
+		test::assert(b * v == b.dense() * v, "Test Failed: band * vector");
+		test::assert(b * m == b.dense() * m, "Test Failed: band * matrix");
+		test::assert(mt * b == mt * b.dense(), "Test Failed: matrix * band");
+	}
+
+	{
+		test::verbose("Tridiagonal matrix");
+
+		algebra::tridiagonal_matrix<D5> t;
+		for (size_t i = 0; i < D5::rank; ++i)
+		{
+			t(i, i) = 4.0;
+			if (i > 0)
+			{
+				t(i, i - 1) = -1.0;
+				t(i - 1, i) = -2.0;
+			}
+		}
+
+		algebra::vector<D5> x;
+		test::assert(algebra::solve(t, v, x), "Test Failed: tridiagonal solution not found");
+		test::assert(t * x == v, "Test Failed: tridiagonal solution is incorrect");
+		test::assert(t.dense() * x == v, "Test Failed: tridiagonal solution does not match dense matrix");
+	}
+
+	{
+		test::verbose("Tridiagonal matrix of a single value");
+
+		algebra::tridiagonal_matrix<D1> t;
+		t(0, 0) = 4.0;
+
+		algebra::vector<D1> b{ 2.0 };
+		algebra::vector<D1> x;
+		test::assert(algebra::solve(t, b, x), "Test Failed: tridiagonal solution not found");
+		test::assert(x == algebra::vector<D1>{ 0.5 }, "Test Failed: tridiagonal solution is incorrect");
+		test::assert(t.dense()(0, 0) == 4.0, "Test Failed: dense matrix is incorrect");
+	}
+
+	sc.pass();
+}
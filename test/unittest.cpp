@@ -10,10 +10,19 @@ void run_tests()
 	try
 	{
 		test_expressions();
+		test_expression_cache();
+		test_compiled_expressions();
+		test_expression_simplify();
+		test_expression_chains();
+		test_parallel_expressions();
+		test_expression_gradient();
+		test_expression_arena();
+		test_static_expressions();
 
 		test_vector_expressions();
 		test_vector();
 		test_matrices();
+		test_structured_matrices();
 
 		test_view();
 
@@ -25,8 +34,20 @@ void run_tests()
 		test_vector_iterators();
 
 		test_solve();
+		test_solve_refined();
+		test_least_squares();
+		test_recursive_least_squares();
+		test_truncated_svd();
 
 		test_neural_network();
+		test_reentrant_inference();
+		test_activation_functions();
+		test_neural_network_batch();
+		test_neural_network_parameters();
+		test_data_parallel_training();
+		test_hogwild_training();
+		test_optimizers();
+		test_classification_network();
 		test_composite_networks();
 
 		test_projection();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "declaration.h"
+#include "matrix.h"
 
 struct D1 : public algebra::dimension<1> {};
 struct D2 : public algebra::dimension<2> {};
@@ -170,11 +171,60 @@ struct scenario
 	}
 };
 
+// Largest absolute difference between the elements of two vectors or
+// matrices, used by _approximately_equals.
+template <class D>
+double _max_difference(const algebra::vector<D>& v1, const algebra::vector<D>& v2)
+{
+	double difference = 0.0;
+	for (size_t i = 0; i < D::rank; ++i)
+	{
+		difference = std::max(difference, std::abs(v1(i) - v2(i)));
+	}
+
+	return difference;
+}
+
+template <class M, class N>
+double _max_difference(const algebra::matrix<M, N>& m1, const algebra::matrix<M, N>& m2)
+{
+	double difference = 0.0;
+	for (size_t row = 0; row < M::rank; ++row)
+	{
+		for (size_t col = 0; col < N::rank; ++col)
+		{
+			difference = std::max(difference, std::abs(m1(row, col) - m2(row, col)));
+		}
+	}
+
+	return difference;
+}
+
+// Utility function to compare computed values up to an absolute error.
+//
+// Sample usage:
+//		test::assert(_approximately_equals(x, expected, 1.0e-6), "Solution is incorrect");
+//
+template <class T>
+bool _approximately_equals(const T& value, const T& expected, const double error)
+{
+	return _max_difference(value, expected) <= error;
+}
+
 void test_expressions();
+void test_expression_cache();
+void test_compiled_expressions();
+void test_expression_simplify();
+void test_expression_chains();
+void test_parallel_expressions();
+void test_expression_gradient();
+void test_expression_arena();
+void test_static_expressions();
 
 void test_vector();
 void test_vector_expressions();
 void test_matrices();
+void test_structured_matrices();
 
 void test_view();
 
@@ -186,8 +236,20 @@ void test_matrix_view_column_iterators();
 void test_vector_iterators();
 
 void test_solve();
+void test_solve_refined();
+void test_least_squares();
+void test_recursive_least_squares();
+void test_truncated_svd();
 
 void test_neural_network();
+void test_reentrant_inference();
+void test_activation_functions();
+void test_neural_network_batch();
+void test_neural_network_parameters();
+void test_data_parallel_training();
+void test_hogwild_training();
+void test_optimizers();
+void test_classification_network();
 void test_composite_networks();
 
 void test_projection();